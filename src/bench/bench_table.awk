@@ -0,0 +1,33 @@
+# Join bench_<variant>.txt files into one table with speedup against the
+# first variant and the geometric mean speedup of every variant.
+# Input lines: <name> <value> ns/op
+FNR == 1 { file++ }
+{
+  if (file == 1) names[++count] = $1
+  value[$1, file] = $2
+}
+END {
+  split(variants, header, " ")
+  printf "%-16s", "ns/op"
+  for (f = 1; f <= file; f++) printf " %14s", header[f]
+  printf "\n"
+  for (n = 1; n <= count; n++) {
+    printf "%-16s", names[n]
+    for (f = 1; f <= file; f++) {
+      v = value[names[n], f]
+      base = value[names[n], 1]
+      if (v > 0 && base > 0) {
+        printf " %7.1f x%5.2f", v, base / v
+        logs[f] += log(base / v)
+        runs[f]++
+      } else {
+        printf " %14s", "-"
+      }
+    }
+    printf "\n"
+  }
+  printf "%-16s", "geomean"
+  for (f = 1; f <= file; f++)
+    printf " %14s", runs[f] ? sprintf("x%5.2f", exp(logs[f] / runs[f])) : "-"
+  printf "\n"
+}
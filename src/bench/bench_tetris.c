@@ -0,0 +1,497 @@
+#define _DEFAULT_SOURCE
+
+#include "bench_tetris.h"
+
+static volatile int sink;
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--train") == 0) {
+    train_workload(TRAIN_GAMES);
+    return 0;
+  }
+  if (argc > 1 && strcmp(argv[1], "--render") == 0) {
+    bench_render();
+    return 0;
+  }
+  bench_collision();
+  bench_leaving_field();
+  bench_rotate_figure();
+  bench_remove_lines();
+  bench_shift_lines();
+  bench_board_features();
+  bench_pieces();
+  bench_print_field();
+  bench_render();
+  bench_sessions();
+  bench_perft();
+  bench_rollout();
+  bench_batch();
+  bench_host();
+  train_workload(TRAIN_GAMES / 4);
+  return 0;
+}
+
+/**
+ * Print the average cost of one benchmark iteration.
+ * @param name Benchmark name.
+ * @param start Benchmark start time in microseconds.
+ * @param iterations Number of measured iterations.
+ */
+void bench_report(const char *name, long long start, long iterations) {
+  double ns = (double)(get_time_us() - start) * 1000.0 / iterations;
+  printf("%-16s %10.2f ns/op\n", name, ns);
+}
+
+/**
+ * Return a monotonic clock reading in nanoseconds.
+ */
+long long bench_clock_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Fill the lower half of the game field with a ragged mid-game stack and
+ * place a T figure above it.
+ * @param game Main game structure.
+ */
+void bench_board(GameInfo_t *game) {
+  srand(BENCH_SEED);
+  reset_field();
+  for (int i = HEIGHT / 2; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      if (rand() % 4 != 0) game->field[i][j] = BLUE_P;
+    }
+  }
+  reset_figure(&game->current);
+  do {
+    generate_figure(&game->current);
+  } while (game->current.type != 'T');
+  game->current.x = 3;
+  game->current.y = 4;
+  board_rebuild(&game->board, game->field);
+}
+
+void bench_collision() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    game->current.x = i % (WIDTH - 2);
+    sink += collision();
+  }
+  bench_report("collision", start, KERNEL_ITERS);
+}
+
+void bench_leaving_field() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    game->current.x = i % (WIDTH + 2) - 1;
+    sink += leaving_field();
+  }
+  bench_report("leaving_field", start, KERNEL_ITERS);
+}
+
+void bench_rotate_figure() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    rotate_figure();
+    sink += game->current.x;
+  }
+  bench_report("rotate_figure", start, KERNEL_ITERS);
+}
+
+/**
+ * Measure clearing four full lines out of a mid-game stack, the field is
+ * restored from a copy before every iteration.
+ */
+void bench_remove_lines() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  for (int i = HEIGHT - 4; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) game->field[i][j] = RED_P;
+  }
+  board_rebuild(&game->board, game->field);
+  int field[HEIGHT][WIDTH];
+  Board_t board = game->board;
+  memcpy(field, game->field, sizeof(field));
+  long long start = get_time_us();
+  for (long i = 0; i < LINES_ITERS; i++) {
+    int lines = 0;
+    memcpy(game->field, field, sizeof(field));
+    game->board = board;
+    while (remove_lines(&lines))
+      ;
+    sink += lines;
+  }
+  bench_report("remove_lines", start, LINES_ITERS);
+}
+
+/**
+ * Measure keeping the board features up to date as a T figure is set on a
+ * mid-game stack against recomputing them from the whole field.
+ */
+void bench_board_features() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  Board_t board = game->board;
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    game->board = board;
+    board_place(&game->board, 0x00E2, i % (WIDTH - 2), 4);
+    sink += game->board.totals.holes;
+  }
+  bench_report("board_place", start, KERNEL_ITERS);
+  start = get_time_us();
+  for (long i = 0; i < LINES_ITERS; i++) {
+    board_rebuild(&game->board, game->field);
+    sink += game->board.totals.holes;
+  }
+  bench_report("board_rebuild", start, LINES_ITERS);
+}
+
+/**
+ * Measure making and rotating figures of a custom pentomino set against the
+ * built-in tetrominoes, both go through the same compiled tables.
+ */
+void bench_pieces() {
+  GameInfo_t *game = updateCurrentState();
+  PieceSet_t *set = malloc(sizeof(*set));
+  if (set == NULL ||
+      !pieces_compile(set, PIECES_MAGIC
+                      "\npiece T orange\n###\n.#.\n.#.\n"
+                      "piece F green\n.##\n##.\n.#.\n"
+                      "piece W violet\n#..\n##.\n.##\n")) {
+    free(set);
+    return;
+  }
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    make_figure(&game->next, (int)(i % FIGURE_KINDS));
+    sink += game->next.type;
+  }
+  bench_report("make_figure", start, KERNEL_ITERS);
+  pieces_use(set);
+  start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    make_figure(&game->next, (int)(i % set->count));
+    sink += game->next.type;
+  }
+  bench_report("make_custom", start, KERNEL_ITERS);
+  bench_board(game);
+  start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    rotate_figure();
+    sink += game->current.x;
+  }
+  bench_report("rotate_custom", start, KERNEL_ITERS);
+  pieces_use(NULL);
+  free(set);
+}
+
+void bench_shift_lines() {
+  GameInfo_t *game = updateCurrentState();
+  bench_board(game);
+  long long start = get_time_us();
+  for (long i = 0; i < KERNEL_ITERS; i++) {
+    shift_lines(HEIGHT - 1);
+    sink += game->field[HEIGHT - 1][0];
+  }
+  bench_report("shift_lines", start, KERNEL_ITERS);
+}
+
+/**
+ * Measure print_field() against an ncurses screen written to /dev/null.
+ */
+void bench_print_field() {
+  GameInfo_t *game = updateCurrentState();
+  FILE *out = fopen("/dev/null", "w");
+  FILE *in = fopen("/dev/null", "r");
+  SCREEN *screen = newterm("xterm-256color", out, in);
+  if (screen == NULL) {
+    printf("%-16s %10s\n", "print_field", "skipped");
+  } else {
+    init_colors();
+    bench_board(game);
+    long long start = get_time_us();
+    for (long i = 0; i < PRINT_ITERS; i++) {
+      erase();
+      print_field(stdscr, game);
+    }
+    bench_report("print_field", start, PRINT_ITERS);
+    endwin();
+    delscreen(screen);
+  }
+  fclose(in);
+  fclose(out);
+}
+
+/**
+ * Keep a copy of a game in a ring of recorded frames.
+ * @param frames Recorded frames of one state.
+ * @param count Number of frames recorded so far.
+ * @param game Game to record.
+ */
+void render_keep(GameInfo_t *frames, int *count, const GameInfo_t *game) {
+  frames[*count % RENDER_FRAMES] = *game;
+  (*count)++;
+}
+
+/**
+ * Record a corpus of frames for every screen state from seeded headless games
+ * with the random input of the training workload: the game before start, a
+ * falling figure every RENDER_EVERY ticks, the same frame paused and the
+ * final game over screen of RENDER_FRAMES games.
+ * @param frames Frames by state: START, MOVING, PAUSE and GAMEOVER.
+ */
+void render_record(GameInfo_t frames[RENDER_STATES][RENDER_FRAMES]) {
+  UserAction_t actions[] = {Left, Right, Action, -1, -1, -1, -1, Down};
+  int count[RENDER_STATES] = {0};
+  GameInfo_t game = {0};
+  GameInfo_t *prev = bind_game(&game);
+  srand(BENCH_SEED);
+  game.headless = 1;
+  for (int i = 0; i < RENDER_FRAMES; i++) {
+    seed_game(&game, BENCH_SEED + i);
+    stats_init(&game);
+    render_keep(frames[0], &count[0], &game);
+    game_input(&game, Start);
+    while (game.state != GAMEOVER) {
+      game_input(&game, actions[rand() % 8]);
+      game_tick(&game);
+      if (game.state == MOVING && game.ticks % RENDER_EVERY == 0) {
+        GameInfo_t paused = game;
+        paused.state = PAUSE;
+        paused.pause = 1;
+        render_keep(frames[1], &count[1], &game);
+        render_keep(frames[2], &count[2], &paused);
+      }
+    }
+    render_keep(frames[3], &count[3], &game);
+  }
+  bind_game(prev);
+}
+
+/**
+ * Render the recorded frames of one state and report the time per frame,
+ * frames per second, bytes sent to the terminal per frame and the share of
+ * the time spent in doupdate().
+ * @param name Benchmark name.
+ * @param frames Recorded frames of the state.
+ * @param out Terminal output file, emptied before the run.
+ */
+void render_state(const char *name, const GameInfo_t *frames, FILE *out) {
+  struct stat written;
+  long long compose = 0;
+  long long update = 0;
+  fflush(out);
+  if (ftruncate(fileno(out), 0) == 0) lseek(fileno(out), 0, SEEK_SET);
+  for (long i = 0; i < RENDER_ITERS; i++) {
+    long long start = bench_clock_ns();
+    compose_game_screen(&frames[i % RENDER_FRAMES]);
+    long long composed = bench_clock_ns();
+    doupdate();
+    update += bench_clock_ns() - composed;
+    compose += composed - start;
+  }
+  fflush(out);
+  fstat(fileno(out), &written);
+  double ns = (double)(compose + update) / RENDER_ITERS;
+  printf("%-16s %10.2f ns/op %10.0f fps %8.1f B/frame %5.1f%% doupdate\n",
+         name, ns, 1e9 / ns, (double)written.st_size / RENDER_ITERS,
+         100.0 * update / (compose + update));
+}
+
+/**
+ * Measure print_game_screen() on a virtual terminal of RENDER_ROWS x
+ * RENDER_COLS written to a temporary file, for a recorded corpus of frames of
+ * every screen state.
+ */
+void bench_render() {
+  static GameInfo_t frames[RENDER_STATES][RENDER_FRAMES];
+  const char *names[RENDER_STATES] = {"render_start", "render_moving",
+                                      "render_pause", "render_gameover"};
+  FILE *out = tmpfile();
+  FILE *in = fopen("/dev/null", "r");
+  SCREEN *screen =
+      out != NULL && in != NULL ? newterm("xterm-256color", out, in) : NULL;
+  if (screen == NULL) {
+    printf("%-16s %10s\n", "render", "skipped");
+  } else {
+    render_record(frames);
+    resizeterm(RENDER_ROWS, RENDER_COLS);
+    curs_set(0);
+    init_colors();
+    init_start_screen_figures();
+    layers_init();
+    for (int i = 0; i < RENDER_STATES; i++)
+      render_state(names[i], frames[i], out);
+    layers_free();
+    endwin();
+    delscreen(screen);
+  }
+  if (in != NULL) fclose(in);
+  if (out != NULL) fclose(out);
+}
+
+/**
+ * Measure create, reset, step and destroy of pooled game sessions.
+ */
+void bench_sessions() {
+  SessionPool pool;
+  Session_t **sessions = malloc(SESSION_COUNT * sizeof(*sessions));
+  pool_init(&pool);
+  long long start = get_time_us();
+  for (long i = 0; i < SESSION_COUNT; i++)
+    sessions[i] = session_create(&pool, i + 1);
+  bench_report("session_create", start, SESSION_COUNT);
+  start = get_time_us();
+  for (long i = 0; i < SESSION_COUNT; i++)
+    session_reset(&pool, sessions[i], i + 1);
+  bench_report("session_reset", start, SESSION_COUNT);
+  start = get_time_us();
+  for (long i = 0; i < SESSION_COUNT; i++) session_step(sessions[i], Start);
+  bench_report("session_step", start, SESSION_COUNT);
+  start = get_time_us();
+  for (long i = 0; i < SESSION_COUNT; i++) session_destroy(&pool, sessions[i]);
+  bench_report("session_destroy", start, SESSION_COUNT);
+  pool_free(&pool);
+  free(sessions);
+}
+
+/**
+ * Measure placement generation: perft from an empty seeded board, reported
+ * per leaf position.
+ */
+void bench_perft() {
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, BENCH_SEED);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  spawn_figure();
+  bind_game(prev);
+  long long start = get_time_us();
+  long long nodes = perft(&game, PERFT_DEPTH);
+  bench_report("perft", start, nodes);
+}
+
+/**
+ * Measure Monte Carlo evaluation of the placements of a T figure on the
+ * mid-game stack on all cores, reported per playout.
+ */
+void bench_rollout() {
+  RolloutResult *result = malloc(sizeof(*result));
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, BENCH_SEED);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bench_board(&game);
+  bind_game(prev);
+  if (result != NULL) {
+    long long start = get_time_us();
+    rollout_evaluate(&game, BENCH_SEED, versus_threads(), LLONG_MAX / 2,
+                     ROLLOUT_PLAYOUTS, result);
+    bench_report("rollout", start, result->playouts);
+  }
+  free(result);
+}
+
+/**
+ * Measure the lockstep batch engine on the random input mix of the training
+ * workload, reported per game tick to compare with the scalar game_tick.
+ */
+void bench_batch() {
+  UserAction_t actions[] = {Left, Right, Action, -1, -1, -1, -1, Down};
+  unsigned int *seeds = malloc(BATCH_LANES * sizeof(*seeds));
+  signed char *input = malloc((size_t)BATCH_LANES * BATCH_STEPS);
+  Batch_t batch;
+  srand(BENCH_SEED);
+  for (int lane = 0; lane < BATCH_LANES; lane++) seeds[lane] = rand();
+  for (long i = 0; i < (long)BATCH_LANES * BATCH_STEPS; i++)
+    input[i] = actions[rand() % 8];
+  for (int lane = 0; lane < BATCH_LANES; lane++) input[lane] = Start;
+  if (batch_init(&batch, BATCH_LANES, seeds)) {
+    long long start = get_time_us();
+    for (int i = 0; i < BATCH_STEPS; i++) {
+      signed char *step = input + (long)i * BATCH_LANES;
+      for (int lane = 0; lane < BATCH_LANES; lane++) {
+        if (i > 0 && batch.state[lane] == GAMEOVER) step[lane] = Start;
+      }
+      batch_step(&batch, step);
+    }
+    bench_report("batch_tick", start, (long)BATCH_LANES * BATCH_STEPS);
+    batch_free(&batch);
+  }
+  free(input);
+  free(seeds);
+}
+
+/**
+ * Measure stepping many started sessions of which HOST_PAUSED percent are
+ * paused: polling every session on every tick against the timer wheel host,
+ * reported per session tick.
+ */
+void bench_host() {
+  SessionPool pool;
+  SessionHost_t host;
+  Session_t **polled = malloc(HOST_SESSIONS * sizeof(*polled));
+  pool_init(&pool);
+  if (host_init(&host, HOST_SESSIONS)) {
+    for (int i = 0; i < HOST_SESSIONS; i++) {
+      polled[i] = session_create(&pool, i + 1);
+      session_step(polled[i], Start);
+      if (i % 100 < HOST_PAUSED) session_step(polled[i], Pause);
+    }
+    long long start = get_time_us();
+    for (int tick = 0; tick < HOST_TICKS; tick++) {
+      for (int i = 0; i < HOST_SESSIONS; i++) session_step(polled[i], -1);
+    }
+    bench_report("host_poll", start, (long)HOST_SESSIONS * HOST_TICKS);
+    for (int i = 0; i < HOST_SESSIONS; i++) {
+      session_reset(&pool, polled[i], i + 1);
+      session_step(polled[i], Start);
+      if (i % 100 < HOST_PAUSED) session_step(polled[i], Pause);
+      host_attach(&host, polled[i]);
+    }
+    start = get_time_us();
+    for (int tick = 0; tick < HOST_TICKS; tick++) host_advance(&host);
+    bench_report("host_wheel", start, (long)HOST_SESSIONS * HOST_TICKS);
+    host_free(&host);
+  }
+  pool_free(&pool);
+  free(polled);
+}
+
+/**
+ * Headless game workload used to train PGO builds: plays seeded games with
+ * random input on a virtual clock until each one is over.
+ * @param games Number of games to play.
+ */
+void train_workload(int games) {
+  GameInfo_t *game = updateCurrentState();
+  UserAction_t actions[] = {Left, Right, Action, -1, -1, -1, -1, Down};
+  long long ticks = 0;
+  srand(BENCH_SEED);
+  game->headless = 1;
+  long long start = get_time_us();
+  for (int i = 0; i < games; i++) {
+    reset_figure(&game->next);
+    stats_init(game);
+    game_input(game, Start);
+    while (game->state != GAMEOVER) {
+      game_input(game, actions[rand() % 8]);
+      game_tick(game);
+    }
+    ticks += game->ticks;
+  }
+  double seconds = (double)(get_time_us() - start) / 1000000.0;
+  printf("%-16s %10.2f ns/op\n", "game_tick", seconds * 1e9 / ticks);
+  game->headless = 0;
+}
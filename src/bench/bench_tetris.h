@@ -0,0 +1,57 @@
+#ifndef TETRIS_BENCH_H
+#define TETRIS_BENCH_H
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../brick_game/tetris/backend/tetris_movegen.h"
+#include "../brick_game/tetris/backend/tetris_session.h"
+#include "../brick_game/tetris/tetris.h"
+
+// iterations per benchmark
+#define KERNEL_ITERS 5000000L
+#define LINES_ITERS 1000000L
+#define PRINT_ITERS 200000L
+#define RENDER_ITERS 20000L
+#define RENDER_STATES 4
+#define RENDER_FRAMES 32
+#define RENDER_EVERY 97
+#define RENDER_ROWS 24
+#define RENDER_COLS 80
+#define SESSION_COUNT 200000L
+#define TRAIN_GAMES 200
+#define PERFT_DEPTH 3
+#define BATCH_LANES 4096
+#define BATCH_STEPS 2000
+#define HOST_SESSIONS 4096
+#define HOST_TICKS 300
+#define HOST_PAUSED 90
+#define BENCH_SEED 21
+
+void bench_report(const char *name, long long start, long iterations);
+long long bench_clock_ns();
+void bench_board(GameInfo_t *game);
+void bench_collision();
+void bench_leaving_field();
+void bench_rotate_figure();
+void bench_remove_lines();
+void bench_shift_lines();
+void bench_board_features();
+void bench_pieces();
+void bench_print_field();
+void render_keep(GameInfo_t *frames, int *count, const GameInfo_t *game);
+void render_record(GameInfo_t frames[RENDER_STATES][RENDER_FRAMES]);
+void render_state(const char *name, const GameInfo_t *frames, FILE *out);
+void bench_render();
+void bench_sessions();
+void bench_perft();
+void bench_rollout();
+void bench_batch();
+void bench_host();
+void train_workload(int games);
+
+#endif
@@ -1,19 +1,58 @@
 #include "tetris_backend.h"
 
+#include "tetris_board.h"
+#include "tetris_finesse.h"
+#include "tetris_highscore.h"
+#include "tetris_leaderboard.h"
+#include "tetris_metrics.h"
+#include "tetris_pieces.h"
+#include "tetris_rewind.h"
+#include "tetris_score.h"
+
+// gravity per level in 1/G_UNIT cells per tick: levels 1-10 keep the classic
+// 820..100 ms per row, higher levels speed up to 20G (instant drop)
+static const int gravity_table[LEVEL_MAX] = {
+    GRAVITY_MS(820), GRAVITY_MS(740), GRAVITY_MS(660), GRAVITY_MS(580),
+    GRAVITY_MS(500), GRAVITY_MS(420), GRAVITY_MS(340), GRAVITY_MS(260),
+    GRAVITY_MS(180), GRAVITY_MS(100), GRAVITY_MS(70),  GRAVITY_MS(50),
+    G_UNIT / 2,      G_UNIT,          2 * G_UNIT,      3 * G_UNIT,
+    5 * G_UNIT,      10 * G_UNIT,     15 * G_UNIT,     20 * G_UNIT};
+
+// game bound to the calling thread, see bind_game()
+static _Thread_local GameInfo_t *bound_game = NULL;
+
 /**
- * Init game start values and clear game field.
+ * Init game start values and clear game field. Headless games are driven by
+ * the host through advance_timer() and never touch the high score file. Only
+ * games with the metrics flag set count into the aggregate metrics, so
+ * re-simulations of recordings are not counted again.
  * @param game Main game structure.
  */
 void stats_init(GameInfo_t *game) {
   reset_field();
   generate_figure(&game->next);
   game->score = 0;
-  game->high_score = load_high_score();
+  game->high_score = game->headless ? 0 : load_high_score();
   game->level = LEVEL_MIN;
-  game->speed = SPEED_MIN;
+  game->gravity = level_gravity(game->level);
+  game->speed = GRAVITY_SPEED(game->gravity);
   game->pause = 0;
-  game->timer = get_time();
+  game->timer = get_time_us();
+  game->lag = 0;
+  game->ticks = 0;
+  game->fall = 0;
+  game->lock = 0;
+  game->lines = 0;
+  game->cleared = 0;
+  game->garbage = 0;
+  game->sent = 0;
+  game->pieces = 0;
+  game->spun = 0;
+  game->combo = 0;
+  game->b2b = 0;
   game->state = START;
+  if (game->rewind != NULL) rewind_reset(game->rewind);
+  if (game->finesse != NULL) finesse_reset(game->finesse);
 }
 
 /**
@@ -105,6 +144,10 @@ void start_state_actions(GameInfo_t *game, UserAction_t action) {
   switch (action) {
     case Start:
       game->state = SPAWN;
+      if (!game->headless) game->timer = game_now(game);
+      game->lag = 0;
+      if (game->metrics) metrics_game_started();
+      if (game->rewind != NULL) rewind_push(game->rewind, game);
       break;
     case Terminate:
       game->state = EXIT_STATE;
@@ -121,20 +164,26 @@ void start_state_actions(GameInfo_t *game, UserAction_t action) {
  */
 void spawn_state_actions(GameInfo_t *game) {
   spawn_figure();
+  game->pieces++;
+  game->fall = 0;
+  game->lock = 0;
   if (figure_overlay()) {
     while (figure_overlay()) {
       game->current.y--;
     }
     game->state = GAMEOVER;
+    if (game->metrics) metrics_game_ended(game->level);
+    if (!game->headless) flush_high_score();
   } else
     game->state = MOVING;
 }
 
 /**
- * Process user action in MOVING game state and switch game state to the
- * next one.
+ * Process user action in MOVING game state, then run every whole fixed tick
+ * accumulated since the last call and switch game state to the next one.
  */
 void moving_state_actions(GameInfo_t *game, UserAction_t action) {
+  if (game->finesse != NULL) finesse_input(game->finesse, game, action);
   switch (action) {
     case Left:
       moving_left();
@@ -160,30 +209,51 @@ void moving_state_actions(GameInfo_t *game, UserAction_t action) {
     default:
       break;
   }
-  if ((get_time() - game->timer) >= game->speed) {
-    game->timer = get_time();
-    game->state = SHIFTING;
+  if (!game->headless) advance_timer(game, game_now(game));
+  while (game->state == MOVING && game->lag >= TICK_US) {
+    game->lag -= TICK_US;
+    gravity_tick(game);
   }
 }
 
 /**
- * Shifting Tetramino figure down, check down collision and switch game state to
- * the next state.
+ * Shift Tetramino figure down by every whole row of accumulated gravity (at
+ * least one), so high gravity resolves several rows in one step. A figure
+ * that cannot shift at all is attached, otherwise the game returns to MOVING.
  */
 void shifting_state_actions(GameInfo_t *game) {
-  moving_down();
-  game->state = ((collision() & 0b100) == 4) ? ATTACHING : MOVING;
+  int rows = game->fall / G_UNIT;
+  int moved = 0;
+  game->fall %= G_UNIT;
+  if (rows < 1) rows = 1;
+  for (; rows > 0 && (collision() & 0b100) != 4; rows--, moved++) {
+    moving_down();
+  }
+  if (moved) game->lock = 0;
+  game->state = moved ? MOVING : ATTACHING;
 }
 
 /**
- * Set current figure on the game field, calculate the score, level, and switch
- * game state to the SPAWN state.
+ * Set current figure on the game field, calculate the score, level, cancel
+ * pending garbage rows with the rows the cleared lines send, raise the rest
+ * and switch game state to the SPAWN state. Rows left to send are added to
+ * the sent counter, the counters are clamped to COUNTER_MAX.
  */
 void attaching_state_actions(GameInfo_t *game) {
+  if (game->finesse != NULL) finesse_lock(game->finesse, game);
   set_figure_on_field();
+  if (game->metrics) metrics_piece(game->current.type);
   calculate_score();
   set_level();
+  int rows = garbage_rows(game->cleared);
+  int cancel = rows < game->garbage ? rows : game->garbage;
+  game->garbage -= cancel;
+  game->sent += rows - cancel;
+  if (game->sent > COUNTER_MAX) game->sent = COUNTER_MAX;
+  if (game->combo > COUNTER_MAX) game->combo = COUNTER_MAX;
+  if (game->garbage > 0) raise_garbage();
   game->state = SPAWN;
+  if (game->rewind != NULL) rewind_push(game->rewind, game);
 }
 
 /**
@@ -196,6 +266,8 @@ void gameover_state_actions(GameInfo_t *game, UserAction_t action) {
       reset_figure(&game->next);
       stats_init(game);
       game->state = SPAWN;
+      if (game->metrics) metrics_game_started();
+      if (game->rewind != NULL) rewind_push(game->rewind, game);
       break;
     case Terminate:
       game->state = EXIT_STATE;
@@ -214,7 +286,13 @@ void pause_state_actions(GameInfo_t *game, UserAction_t action) {
     case Pause:
       game->pause = 0;
       game->state = MOVING;
-      game->timer = get_time();
+      if (!game->headless) game->timer = game_now(game);
+      break;
+    case Left:
+      if (game->rewind != NULL) rewind_back(game->rewind, game);
+      break;
+    case Right:
+      if (game->rewind != NULL) rewind_forward(game->rewind, game);
       break;
     case Terminate:
       game->state = EXIT_STATE;
@@ -225,59 +303,172 @@ void pause_state_actions(GameInfo_t *game, UserAction_t action) {
 }
 
 /**
- * Return a pointer to current game state.
+ * Return a pointer to current game state: the game bound to the calling
+ * thread, or the default game if none is bound.
  */
 GameInfo_t *updateCurrentState() {
   static GameInfo_t game = {0};
-  return &game;
+  return bound_game ? bound_game : &game;
+}
+
+/**
+ * Make the given game current for the calling thread, so several games can be
+ * stepped in one process.
+ * @param game Game to bind, NULL - return to the default game.
+ * @return Previously bound game.
+ */
+GameInfo_t *bind_game(GameInfo_t *game) {
+  GameInfo_t *prev = bound_game;
+  bound_game = game;
+  return prev;
+}
+
+/**
+ * Deliver a user action to a headless game and run the following transient
+ * states (SPAWN, SHIFTING, ATTACHING) until the game waits for input again.
+ * @param game Main game structure.
+ * @param action The user action to be processed.
+ */
+void game_input(GameInfo_t *game, UserAction_t action) {
+  GameInfo_t *prev = bind_game(game);
+  userInput(action, 0);
+  game_settle(game);
+  bind_game(prev);
+}
+
+/**
+ * Advance a headless game by one fixed tick of virtual time.
+ * @param game Main game structure.
+ */
+void game_tick(GameInfo_t *game) {
+  GameInfo_t *prev = bind_game(game);
+  game_settle(game);
+  if (game->state == MOVING) {
+    advance_timer(game, game->timer + TICK_US);
+    userInput(-1, 0);
+    game_settle(game);
+  }
+  bind_game(prev);
+}
+
+/**
+ * Run transient game states until the game waits for input. The game must be
+ * bound to the calling thread.
+ * @param game Main game structure.
+ */
+void game_settle(GameInfo_t *game) {
+  while (game->state == SPAWN || game->state == SHIFTING ||
+         game->state == ATTACHING)
+    userInput(-1, 0);
+}
+
+/**
+ * Return the time of the action being processed: its timestamp if it has one,
+ * otherwise the current time.
+ * @param game Main game structure.
+ */
+long long game_now(GameInfo_t *game) {
+  return game->input_time ? game->input_time : get_time_us();
+}
+
+/**
+ * Run the fixed ticks of a live game up to the given time and the transient
+ * states they lead to. A timestamped action delivered with userInput() right
+ * after this call takes effect at its own time instead of the current one.
+ * @param game Main game structure.
+ * @param now Time in microseconds, 0 - current time.
+ */
+void game_advance(GameInfo_t *game, long long now) {
+  GameInfo_t *prev = bind_game(game);
+  game->input_time = now;
+  game_settle(game);
+  while (game->state == MOVING) {
+    userInput(-1, 0);
+    if (game->state == MOVING) break;
+    game_settle(game);
+  }
+  bind_game(prev);
 }
 
 /**
- * Generate a random Tetramino figure for the Tetris game.
+ * Return how long a live game can wait for input before game_advance() has
+ * work to do.
+ * @param game Main game structure.
+ * @return Microseconds to the next tick, 0 - due now, -1 - nothing is due
+ * until the next action.
+ */
+long long game_due(const GameInfo_t *game) {
+  long long due = 0;
+  if (game->state == MOVING) {
+    due = TICK_US - game->lag - (get_time_us() - game->timer);
+    if (due < 0) due = 0;
+  } else if (game->state == START || game->state == PAUSE ||
+             game->state == GAMEOVER) {
+    due = -1;
+  }
+  return due;
+}
+
+/**
+ * Seed the figure generator of the game, equal seeds give equal figure
+ * sequences.
+ * @param game Main game structure.
+ * @param seed Generator seed.
+ */
+void seed_game(GameInfo_t *game, unsigned int seed) {
+  game->rng = seed ? seed : 1;
+}
+
+/**
+ * Return the next value of a xorshift32 generator.
+ * @param state Generator state, must not be 0.
+ */
+unsigned int next_random(unsigned int *state) {
+  unsigned int x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/**
+ * Generate a random Tetramino figure for the Tetris game. Figures are drawn
+ * from the generator of the current game.
  * @param figure Pointer to the Tetramino struct to be filled with the generated
  * figure.
  */
 void generate_figure(Tetramino *figure) {
-  int number = rand() % 7;
+  int count = pieces_active()->count;
+  make_figure(figure, (int)(game_random(updateCurrentState()) % count));
+}
+
+/**
+ * Return the next value of the game generator, an unseeded game is seeded
+ * from rand().
+ * @param game Main game structure.
+ */
+unsigned int game_random(GameInfo_t *game) {
+  if (game->rng == 0) seed_game(game, rand());
+  return next_random(&game->rng);
+}
+
+/**
+ * Fill the Tetramino figure with the given kind of figure of the active piece
+ * set in spawn orientation.
+ * @param figure Pointer to the Tetramino struct to be filled.
+ * @param number Figure kind, built-in set 0-6: I, O, L, J, S, T, Z.
+ */
+void make_figure(Tetramino *figure, int number) {
+  const PieceSet_t *set = pieces_active();
   figure->rows = 3;
   figure->cols = 3;
-  if (number == 0) {
-    figure->rows = 2;
-    figure->cols = 4;
-    for (int i = 0; i < 4; i++) figure->view[1][i] = COLOR_RED;
-    figure->type = 'I';
-  }
-  if (number == 1) {
-    figure->rows = 2;
-    figure->cols = 2;
-    for (int i = 1; i < 3; i++) figure->view[0][i] = COLOR_YELLOW_;
-    for (int i = 1; i < 3; i++) figure->view[1][i] = COLOR_YELLOW_;
-    figure->type = 'O';
-  }
-  if (number == 2) {
-    figure->view[0][2] = COLOR_BLUE;
-    for (int j = 0; j < 3; j++) figure->view[1][j] = COLOR_BLUE;
-    figure->type = 'L';
-  }
-  if (number == 3) {
-    figure->view[0][0] = COLOR_GREEN;
-    for (int j = 0; j < 3; j++) figure->view[1][j] = COLOR_GREEN;
-    figure->type = 'J';
-  }
-  if (number == 4) {
-    for (int i = 1; i < 3; i++) figure->view[0][i] = COLOR_CYAN;
-    for (int i = 0; i < 2; i++) figure->view[1][i] = COLOR_CYAN;
-    figure->type = 'S';
-  }
-  if (number == 5) {
-    figure->view[0][1] = COLOR_ORANGE;
-    for (int i = 0; i < 3; i++) figure->view[1][i] = COLOR_ORANGE;
-    figure->type = 'T';
-  }
-  if (number == 6) {
-    for (int i = 0; i < 2; i++) figure->view[0][i] = COLOR_VIOLET;
-    for (int i = 1; i < 3; i++) figure->view[1][i] = COLOR_VIOLET;
-    figure->type = 'Z';
+  if (number >= 0 && number < set->count) {
+    const Tetramino *spawn = &set->pieces[number].spawn;
+    memcpy(figure->view, spawn->view, sizeof(figure->view));
+    figure->type = spawn->type;
+    figure->rows = spawn->rows;
+    figure->cols = spawn->cols;
   }
 }
 
@@ -286,8 +477,10 @@ void generate_figure(Tetramino *figure) {
  */
 void moving_left() {
   GameInfo_t *game = updateCurrentState();
+  int x = game->current.x;
   if ((collision() & 0b010) != 2) game->current.x--;
   if (leaving_field()) game->current.x++;
+  if (game->current.x != x) game->spun = 0;
 }
 
 /**
@@ -295,8 +488,10 @@ void moving_left() {
  */
 void moving_right() {
   GameInfo_t *game = updateCurrentState();
+  int x = game->current.x;
   if ((collision() & 0b001) != 1) game->current.x++;
   if (leaving_field()) game->current.x--;
+  if (game->current.x != x) game->spun = 0;
 }
 
 /**
@@ -304,59 +499,127 @@ void moving_right() {
  */
 void moving_down() {
   GameInfo_t *game = updateCurrentState();
-  if (!leaving_field() && (collision() & 0b100) != 4) game->current.y++;
+  if (!leaving_field() && (collision() & 0b100) != 4) {
+    game->current.y++;
+    game->spun = 0;
+  }
 }
 
 /**
- * Return the current time in milliseconds since the Unix epoch.
- * @return The current time in milliseconds since the Unix epoch.
+ * Return the current time in microseconds since the Unix epoch.
+ * @return The current time in microseconds since the Unix epoch.
  */
-long long int get_time() {
+long long int get_time_us() {
   struct timeval now;
   gettimeofday(&now, NULL);
-  return (long long)now.tv_sec * 1000 + now.tv_usec / 1000;
+  return (long long)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/**
+ * Add the time elapsed since the last call to the tick accumulator. Time
+ * shorter than one tick is carried over instead of being dropped, large gaps
+ * are clamped to LAG_MAX. A time not after the timer, such as a stale key
+ * event, is ignored so the timer never moves backwards.
+ * @param game Main game structure.
+ * @param now Current time in microseconds.
+ */
+void advance_timer(GameInfo_t *game, long long now) {
+  if (now > game->timer) {
+    game->lag += now - game->timer;
+    game->timer = now;
+    if (game->lag > LAG_MAX) game->lag = LAG_MAX;
+  }
+}
+
+/**
+ * Run one fixed simulation tick. Fractional gravity is accumulated while the
+ * figure falls and the lock delay is counted while it rests on the stack. The
+ * game switches to SHIFTING once a whole row is pending or the lock delay has
+ * expired.
+ * @param game Main game structure.
+ */
+void gravity_tick(GameInfo_t *game) {
+  game->ticks++;
+  if ((collision() & 0b100) == 4) {
+    game->fall = 0;
+    if (++game->lock >= LOCK_DELAY) game->state = SHIFTING;
+  } else {
+    game->fall += game->gravity;
+    if (game->fall >= G_UNIT) game->state = SHIFTING;
+  }
 }
 
 /**
- * Rotate current Tetramino figure.
+ * Return gravity for the given level.
+ * @param level Game level, clamped to [LEVEL_MIN, LEVEL_MAX].
+ * @return Gravity in 1/G_UNIT cells per tick.
+ */
+int level_gravity(int level) {
+  if (level < LEVEL_MIN) level = LEVEL_MIN;
+  if (level > LEVEL_MAX) level = LEVEL_MAX;
+  return gravity_table[level - 1];
+}
+
+/**
+ * Rotate current Tetramino figure to the next view of its piece, a view the
+ * piece table does not know turns in its rows x cols box. A turn that would
+ * lift cells above the field is not done. A rotation that is kept marks the
+ * figure as spun until it moves again.
  */
 void rotate_figure() {
   GameInfo_t *game = updateCurrentState();
-  int temp_view[4][4] = {0};
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      temp_view[i][j] = game->current.view[i][j];
+  Tetramino *figure = &game->current;
+  const Piece_t *piece = pieces_find(pieces_active(), figure->type);
+  int x = figure->x;
+  int rows = figure->rows;
+  int cols = figure->cols;
+  int color = 0;
+  unsigned int mask = 0;
+  int temp_view[FIGURE_SIZE][FIGURE_SIZE];
+  memcpy(temp_view, figure->view, sizeof(temp_view));
+  for (int i = 0; i < FIGURE_CELLS; i++) {
+    if (figure->view[i / FIGURE_SIZE][i % FIGURE_SIZE] != 0) {
+      mask |= 1u << i;
+      color = figure->view[i / FIGURE_SIZE][i % FIGURE_SIZE];
     }
   }
-  if (game->current.type != 'O' && game->current.type != 'I') {
-    for (int i = 0; i < game->current.rows; i++) {
-      for (int j = 0; j < game->current.cols; j++)
-        game->current.view[i][j] = temp_view[game->current.cols - 1 - j][i];
-    }
+  int view = piece != NULL ? pieces_view(piece, mask) : -1;
+  unsigned int turned = mask;
+  if (view >= 0) {
+    const PieceView *next = &piece->views[piece->views[view].next];
+    turned = next->mask;
+    figure->rows = next->rows;
+    figure->cols = next->cols;
+  } else if (piece == NULL || piece->turns) {
+    turned = pieces_turn(mask, rows, cols);
   }
-  if (game->current.type == 'I' && game->current.y >= 0) {
-    for (int i = 0; i < 4; i++) {
-      int temp = game->current.view[1][i];
-      game->current.view[1][i] = game->current.view[i][1];
-      game->current.view[i][1] = temp;
-    }
-    int cols_temp = game->current.cols;
-    game->current.cols = game->current.rows;
-    game->current.rows = cols_temp;
+  if (turned != 0 && figure->y + __builtin_ctz(turned) / FIGURE_SIZE >= 0) {
+    for (int i = 0; i < FIGURE_CELLS; i++)
+      figure->view[i / FIGURE_SIZE][i % FIGURE_SIZE] =
+          turned >> i & 1 ? color : 0;
+  } else {
+    figure->rows = rows;
+    figure->cols = cols;
   }
 
-  if (leaving_field() == 1)
-    if ((collision() & 0b001) != 1) game->current.x++;
+  int kick_left = piece != NULL ? piece->kick_left : 1;
+  int kick_right = piece != NULL ? piece->kick_right : 1;
+  if (leaving_field() == 1) {
+    for (int i = 0; i < kick_left; i++)
+      if ((collision() & 0b001) != 1) figure->x++;
+  }
   if (leaving_field() == 2) {
-    if ((collision() & 0b010) != 2) game->current.x--;
-    if (game->current.type == 'I')
-      if ((collision() & 0b010) != 2) game->current.x--;
+    for (int i = 0; i < kick_right; i++)
+      if ((collision() & 0b010) != 2) figure->x--;
   }
 
   if (figure_overlay() || leaving_field()) {
-    for (int i = 0; i < 4; i++) {
-      for (int j = 0; j < 4; j++) game->current.view[i][j] = temp_view[i][j];
-    }
+    memcpy(figure->view, temp_view, sizeof(temp_view));
+    figure->rows = rows;
+    figure->cols = cols;
+    if (figure->x != x) game->spun = 0;
+  } else {
+    game->spun = 1;
   }
 }
 
@@ -371,8 +634,8 @@ int leaving_field() {
   int leave = 0;
   int x = game->current.x;
   int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
+  for (int i = 0; i < FIGURE_SIZE; i++, y++) {
+    for (int j = 0; j < FIGURE_SIZE; j++, x++) {
       if (game->current.view[i][j] != 0 && (x < 0))
         leave = 1;
       else if (game->current.view[i][j] != 0 && (x > WIDTH - 1))
@@ -386,19 +649,39 @@ int leaving_field() {
 }
 
 /**
- * Set current figure on the game field.
+ * Abort when the board features drift from the field, compiled in with
+ * -DBOARD_CHECK (make test VARIANT=check).
+ */
+static void board_check(const GameInfo_t *game) {
+#ifdef BOARD_CHECK
+  if (!board_verify(&game->board, game->field)) {
+    fprintf(stderr, "board features out of sync with the field\n");
+    abort();
+  }
+#else
+  (void)game;
+#endif
+}
+
+/**
+ * Set current figure on the game field and add it to the board features.
  */
 void set_figure_on_field() {
   GameInfo_t *game = updateCurrentState();
+  unsigned int mask = 0;
   int x = game->current.x;
   int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0)
+  for (int i = 0; i < FIGURE_SIZE; i++, y++) {
+    for (int j = 0; j < FIGURE_SIZE; j++, x++) {
+      if (game->current.view[i][j] != 0) {
         game->field[y][x] = game->current.view[i][j];
+        mask |= 1u << (i * FIGURE_SIZE + j);
+      }
     }
     x = game->current.x;
   }
+  board_place(board_sync(game), mask, game->current.x, game->current.y);
+  board_check(game);
 }
 
 /**
@@ -411,6 +694,8 @@ void reset_field() {
       game->field[i][j] = 0;
     }
   }
+  board_clear(&game->board);
+  game->board_stale = 0;
 }
 
 /**
@@ -418,8 +703,8 @@ void reset_field() {
  * @param figure The Tetramino figure to reset.
  */
 void reset_figure(Tetramino *figure) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
       figure->view[i][j] = 0;
     }
   }
@@ -433,8 +718,10 @@ void spawn_figure() {
   reset_figure(&game->current);
   game->current = game->next;
 
+  const Piece_t *piece = pieces_find(pieces_active(), game->current.type);
   game->current.x = WIDTH / 2 - 2;
-  game->current.y = game->current.type == 'I' ? -1 : 0;
+  game->current.y = piece != NULL ? piece->spawn.y : 0;
+  game->spun = 0;
 
   reset_figure(&game->next);
   generate_figure(&game->next);
@@ -476,39 +763,60 @@ void shift_lines(int line) {
       game->field[i][j] = game->field[i - 1][j];
     }
   }
+  board_remove_row(board_sync(game), line);
+  board_check(game);
+}
+
+/**
+ * Push the stack up by the pending garbage rows and fill the bottom rows with
+ * garbage, leaving a hole in one random column.
+ */
+void raise_garbage() {
+  GameInfo_t *game = updateCurrentState();
+  int rows = game->garbage > HEIGHT ? HEIGHT : game->garbage;
+  int hole = game_random(game) % WIDTH;
+  for (int i = 0; i < HEIGHT - rows; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      game->field[i][j] = game->field[i + rows][j];
+    }
+  }
+  for (int i = HEIGHT - rows; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      game->field[i][j] = j == hole ? 0 : COLOR_GARBAGE;
+    }
+  }
+  game->garbage = 0;
+  board_rebuild(&game->board, game->field);
+  game->board_stale = 0;
 }
 
 /**
- * Calculate game score and update high score for the current game state.
+ * Calculate game score and update high score for the current game state. The
+ * number of removed lines is kept in the cleared and lines counters, spins,
+ * combos and back-to-back clears are scored by score_lock(). Games with a
+ * custom piece set do not save their high score.
  */
 void calculate_score() {
   GameInfo_t *game = updateCurrentState();
   int lines = 0;
+  int spin = figure_spin();
   while (remove_lines(&lines))
     ;
-  switch (lines) {
-    case 1:
-      game->score += 100;
-      break;
-    case 2:
-      game->score += 300;
-      break;
-    case 3:
-      game->score += 700;
-      break;
-    case 4:
-      game->score += 1500;
-      break;
-  }
-  if (game->score > game->high_score) {
+  game->cleared = lines;
+  game->lines += lines;
+  if (game->metrics) metrics_clear(lines);
+  game->score += score_lock(lines, spin, &game->combo, &game->b2b);
+  if (game->score > game->high_score && !rewind_used(game)) {
     game->high_score = game->score;
-    save_high_score(game->high_score);
+    if (!game->headless && pieces_active() == pieces_builtin())
+      save_high_score(game->high_score);
   }
 }
 
 /**
  * Check for collisions between current figure and game field in three
- * directions: down, left, and right.
+ * directions: down, left, and right. Walls and the floor collide, cells above
+ * the field do not.
  *
  * @return integer, whose first three bits contain information about collision.
  *         A bit mask on returned value indicating the type of collision
@@ -520,14 +828,13 @@ int collision() {
   int collision = 0;
   int x = game->current.x;
   int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0 &&
-          (game->field[y + 1][x] != 0 || y == HEIGHT - 1))
+  for (int i = 0; i < FIGURE_SIZE; i++, y++) {
+    for (int j = 0; j < FIGURE_SIZE; j++, x++) {
+      if (game->current.view[i][j] != 0 && field_blocked(game, y + 1, x))
         collision |= (1 << 2);
-      if (game->current.view[i][j] != 0 && game->field[y][x - 1] != 0)
+      if (game->current.view[i][j] != 0 && field_blocked(game, y, x - 1))
         collision |= (1 << 1);
-      if (game->current.view[i][j] != 0 && game->field[y][x + 1] != 0)
+      if (game->current.view[i][j] != 0 && field_blocked(game, y, x + 1))
         collision |= 1;
     }
     x = game->current.x;
@@ -536,7 +843,21 @@ int collision() {
 }
 
 /**
- * Check if the current figure overlaps with any blocks in game field.
+ * Check if a field cell blocks a figure. Walls and the floor block, cells
+ * above the field are free.
+ * @param game Main game structure.
+ * @param y Field row.
+ * @param x Field column.
+ * @return 1 - the cell is filled or off the field, 0 - the cell is free.
+ */
+int field_blocked(const GameInfo_t *game, int y, int x) {
+  return x < 0 || x >= WIDTH || y >= HEIGHT ||
+         (y >= 0 && game->field[y][x] != 0);
+}
+
+/**
+ * Check if the current figure overlaps with any blocks in game field. Cells
+ * off the sides or below the field overlap, cells above the field never do.
  * @return 1 - current figure overlaps with game field, 0 - figure does not
  * overlap game field.
  */
@@ -545,9 +866,10 @@ int figure_overlay() {
   int overlay = 0;
   int x = game->current.x;
   int y = game->current.y;
-  for (int i = 0; i < 4; i++, y++) {
-    for (int j = 0; j < 4; j++, x++) {
-      if (game->current.view[i][j] != 0 && game->field[y][x] != 0) overlay = 1;
+  for (int i = 0; i < FIGURE_SIZE; i++, y++) {
+    for (int j = 0; j < FIGURE_SIZE; j++, x++) {
+      if (game->current.view[i][j] != 0 && field_blocked(game, y, x))
+        overlay = 1;
     }
     x = game->current.x;
   }
@@ -555,33 +877,141 @@ int figure_overlay() {
 }
 
 /**
- * Update current game level and speed based on the player's score.
+ * Check if the current figure is a T spun into place: it was rotated since it
+ * last moved and three corners of its 3x3 box are occupied. Walls and the
+ * floor count as occupied, cells above the field as free.
+ * @return SPIN_NONE, SPIN_MINI or SPIN_FULL.
+ */
+int figure_spin() {
+  GameInfo_t *game = updateCurrentState();
+  int res = SPIN_NONE;
+  if (game->current.type == 'T' && game->spun) {
+    unsigned int mask = 0;
+    unsigned int corners = 0;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        int y = game->current.y + i;
+        int x = game->current.x + j;
+        if (game->current.view[i][j] != 0)
+          mask |= 1u << (i * FIGURE_SIZE + j);
+        if (i != 1 && j != 1 &&
+            (x < 0 || x >= WIDTH || y >= HEIGHT ||
+             (y >= 0 && game->field[y][x] != 0)))
+          corners |= 1u << (i / 2 * 2 + j / 2);
+      }
+    }
+    res = spin_kind(mask, corners);
+  }
+  return res;
+}
+
+/**
+ * Update current game level, gravity and speed based on the player's score.
  */
 void set_level() {
   GameInfo_t *game = updateCurrentState();
   game->level = (game->score / 600) + 1;
   if (game->level > LEVEL_MAX) game->level = LEVEL_MAX;
-  game->speed = SPEED_MIN - (game->level * 80);
+  game->gravity = level_gravity(game->level);
+  game->speed = GRAVITY_SPEED(game->gravity);
+}
+
+/**
+ * Return the directory game data is kept in: TETRIS_DATA_DIR or DATA_DIR.
+ */
+const char *data_dir() {
+  const char *dir = getenv("TETRIS_DATA_DIR");
+  return dir != NULL && dir[0] != '\0' ? dir : DATA_DIR;
+}
+
+/**
+ * Build the path of a file in the data directory.
+ * @param path Buffer for the path.
+ * @param size Buffer size.
+ * @param name File name.
+ */
+void data_path(char *path, size_t size, const char *name) {
+  snprintf(path, size, "%s/%s", data_dir(), name);
 }
 
 /**
- * Save the given high score to a file.
+ * Save the given high score. It is offered to the store shared by every
+ * process of the data directory and reaches the file on flush_high_score(),
+ * the file is written directly only if the store cannot be opened.
  * @param high_score The high score to be saved.
  */
 void save_high_score(int high_score) {
-  FILE *file = fopen("install/high_score.txt", "w");
-  fprintf(file, "%d", high_score);
-  fclose(file);
+  HighScore_t *store = highscore_store();
+  if (store != NULL) {
+    highscore_offer(store, high_score);
+  } else {
+    char path[512];
+    data_path(path, sizeof(path), HIGH_SCORE_FILE);
+    FILE *file = fopen(path, "w");
+    if (file != NULL) {
+      fprintf(file, "%d", high_score);
+      fclose(file);
+    }
+  }
 }
 
 /**
- * Load the high score from a file.
- * @return The high score value read from the file.
+ * Write a record raised since the last flush to the high score file. It is
+ * called when a game ends or the loop exits, not on every lock.
+ */
+void flush_high_score() {
+  HighScore_t *store = highscore_store();
+  if (store != NULL) highscore_flush(store);
+}
+
+/**
+ * Load the high score: the value of the shared store, or the best of the high
+ * score file and the leaderboard if the store cannot be opened.
+ * @return The high score value.
  */
 int load_high_score() {
+  HighScore_t *store = highscore_store();
   int high_score = 0;
-  FILE *file = fopen("install/high_score.txt", "r");
-  fscanf(file, "%d", &high_score);
-  fclose(file);
+  if (store != NULL) {
+    high_score = highscore_get(store);
+  } else {
+    char path[512];
+    Leaderboard_t board;
+    data_path(path, sizeof(path), HIGH_SCORE_FILE);
+    high_score = read_high_score(path);
+    if (leaderboard_open(&board, data_dir())) {
+      int best = leaderboard_best(&board);
+      if (best > high_score) high_score = best;
+      leaderboard_close(&board);
+    }
+  }
   return high_score;
-}
\ No newline at end of file
+}
+
+/**
+ * Read a high score file.
+ * @param path File path.
+ * @return The score, 0 - no file or no number in it.
+ */
+int read_high_score(const char *path) {
+  int high_score = 0;
+  FILE *file = fopen(path, "r");
+  if (file != NULL) {
+    if (fscanf(file, "%d", &high_score) != 1) high_score = 0;
+    fclose(file);
+  }
+  return high_score;
+}
+
+/**
+ * Pick up a record set by another process. Reading the shared store is a
+ * single atomic load, so it is cheap enough to do every frame.
+ * @param game Main game structure.
+ */
+void refresh_high_score(GameInfo_t *game) {
+  HighScore_t *store = game->headless ? NULL : highscore_store();
+  if (store != NULL) {
+    int best = highscore_get(store);
+    if (best > game->high_score) game->high_score = best;
+  }
+}
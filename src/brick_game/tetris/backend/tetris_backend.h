@@ -11,9 +11,31 @@
 // game parameters
 #define HEIGHT 20
 #define WIDTH 10
-#define LEVEL_MAX 10
+#define LEVEL_MAX 20
 #define LEVEL_MIN 1
-#define SPEED_MIN 900
+
+// figure view box, view masks keep view[i][j] in bit i * FIGURE_SIZE + j
+#define FIGURE_SIZE 5
+#define FIGURE_CELLS (FIGURE_SIZE * FIGURE_SIZE)
+#define FIGURE_ROW ((1u << FIGURE_SIZE) - 1)
+#define FIGURE_COLUMN 0x108421u
+
+// game data files
+#define DATA_DIR "install"
+#define HIGH_SCORE_FILE "high_score.txt"
+
+// fixed timestep simulation
+#define TICK_US 16667
+#define LAG_MAX (TICK_US * 30)
+#define G_UNIT 65536
+#define GRAVITY_MS(ms) ((int)((long long)G_UNIT * TICK_US / ((ms) * 1000LL)))
+// time to fall one row at gravity g in microseconds, whole milliseconds
+// would round 20G down to zero
+#define GRAVITY_SPEED(g) ((int)((long long)G_UNIT * TICK_US / (g)))
+#define LOCK_DELAY 30
+// sent rows, pending garbage and the combo are clamped to fit a Session_t
+// byte
+#define COUNTER_MAX 255
 
 // user input keys
 #define ESCAPE_KEY 'q'
@@ -25,6 +47,7 @@
 #define COLOR_ORANGE 8
 #define COLOR_YELLOW_ 9
 #define COLOR_VIOLET 10
+#define COLOR_GARBAGE COLOR_WHITE
 
 // game states
 typedef enum {
@@ -40,7 +63,7 @@ typedef enum {
 
 // tetramino figure
 typedef struct {
-  int view[4][4];
+  int view[FIGURE_SIZE][FIGURE_SIZE];
   int x;
   int y;
   char type;
@@ -60,9 +83,36 @@ typedef enum {
   Action
 } UserAction_t;
 
+// board features, rows above the stack and empty columns count nothing
+typedef struct {
+  int aggregate_height;
+  int max_height;
+  int holes;
+  int bumpiness;
+  int wells;
+  int row_transitions;
+  int col_transitions;
+} BoardFeatures;
+
+// field occupancy as row masks (bit j - column j) and column masks (bit i -
+// row i) with the features derived from them, kept up to date with the field
+typedef struct {
+  unsigned short rows[HEIGHT];
+  unsigned int cols[WIDTH];
+  unsigned char heights[WIDTH];
+  unsigned char holes[WIDTH];
+  unsigned char wells[WIDTH];
+  unsigned char steps[WIDTH];
+  unsigned char col_transitions[WIDTH];
+  unsigned char row_transitions[HEIGHT];
+  BoardFeatures totals;
+} Board_t;
+
 // main game information
 typedef struct {
   int field[HEIGHT][WIDTH];
+  Board_t board;
+  int board_stale;
   Tetramino next;
   Tetramino current;
   int score;
@@ -72,9 +122,29 @@ typedef struct {
   int pause;
   long long timer;
   GameState_t state;
+  long long lag;
+  long long ticks;
+  int gravity;
+  int fall;
+  int lock;
+  int headless;
+  int metrics;
+  unsigned int rng;
+  int lines;
+  int cleared;
+  int garbage;
+  int sent;
+  int pieces;
+  int spun;
+  int combo;
+  int b2b;
+  long long input_time;
+  struct Rewind *rewind;
+  struct Finesse *finesse;
 } GameInfo_t;
 
 GameInfo_t *updateCurrentState();
+GameInfo_t *bind_game(GameInfo_t *game);
 UserAction_t get_action(int user_input);
 void userInput(UserAction_t action, bool hold);
 
@@ -87,11 +157,24 @@ void gameover_state_actions(GameInfo_t *game, UserAction_t action);
 void pause_state_actions(GameInfo_t *game, UserAction_t action);
 
 void stats_init(GameInfo_t *game);
-long long int get_time();
+long long int get_time_us();
+void advance_timer(GameInfo_t *game, long long now);
+void gravity_tick(GameInfo_t *game);
+int level_gravity(int level);
+void game_input(GameInfo_t *game, UserAction_t action);
+void game_tick(GameInfo_t *game);
+void game_settle(GameInfo_t *game);
+void game_advance(GameInfo_t *game, long long now);
+long long game_due(const GameInfo_t *game);
+long long game_now(GameInfo_t *game);
 void reset_field();
 
 void reset_figure(Tetramino *figure);
 void generate_figure(Tetramino *figure);
+void make_figure(Tetramino *figure, int number);
+void seed_game(GameInfo_t *game, unsigned int seed);
+unsigned int next_random(unsigned int *state);
+unsigned int game_random(GameInfo_t *game);
 void spawn_figure();
 void moving_left();
 void moving_right();
@@ -101,14 +184,22 @@ void set_figure_on_field();
 
 int leaving_field();
 int collision();
+int field_blocked(const GameInfo_t *game, int y, int x);
 int figure_overlay();
+int figure_spin();
 
 int remove_lines(int *lines);
 void shift_lines(int line);
+void raise_garbage();
 
 void calculate_score();
 void set_level();
+const char *data_dir();
+void data_path(char *path, size_t size, const char *name);
 void save_high_score(int high_score);
+void flush_high_score();
 int load_high_score();
+int read_high_score(const char *path);
+void refresh_high_score(GameInfo_t *game);
 
 #endif
\ No newline at end of file
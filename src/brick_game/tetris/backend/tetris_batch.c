@@ -0,0 +1,491 @@
+#include "tetris_batch.h"
+
+/**
+ * Return row i of a figure view shifted to field column x.
+ */
+static inline unsigned int figure_row(unsigned int mask, int i, int x) {
+  unsigned int bits = mask >> (i * FIGURE_SIZE) & FIGURE_ROW;
+  return x >= 0 ? bits << x : bits >> -x;
+}
+
+/**
+ * Check if the figure of a lane rests on the stack or the floor, the bottom
+ * bit of collision().
+ */
+static inline int lane_down(const Batch_t *batch, int lane) {
+  const unsigned short *rows = batch->rows;
+  int count = batch->count;
+  unsigned int mask = batch->mask[lane];
+  int x = batch->x[lane];
+  int y = batch->y[lane];
+  int hit = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    unsigned int bits = figure_row(mask, i, x);
+    int row = y + i;
+    if (bits != 0)
+      hit |= row >= HEIGHT - 1 || (rows[(row + 1) * count + lane] & bits);
+  }
+  return hit;
+}
+
+/**
+ * Check if the figure of a lane overlaps the stack, cells above the field
+ * never overlap.
+ */
+static inline int lane_overlay(const Batch_t *batch, int lane) {
+  unsigned int mask = batch->mask[lane];
+  int x = batch->x[lane];
+  int y = batch->y[lane];
+  int hit = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    unsigned int bits = figure_row(mask, i, x);
+    int row = y + i;
+    if (bits != 0 && row >= 0 && row < HEIGHT)
+      hit |= (batch->rows[row * batch->count + lane] & bits) != 0;
+  }
+  return hit;
+}
+
+/**
+ * Check if the figure of a lane can move one column: every cell stays on the
+ * field and lands on a free cell, cells above the field are free.
+ * @param dir -1 - left, 1 - right.
+ */
+static inline int lane_can_shift(const Batch_t *batch, int lane, int dir) {
+  unsigned int mask = batch->mask[lane];
+  unsigned int wall = dir < 0 ? 1u : 1u << (WIDTH - 1);
+  int x = batch->x[lane];
+  int y = batch->y[lane];
+  int ok = 1;
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    unsigned int bits = figure_row(mask, i, x);
+    if (bits != 0) {
+      unsigned int row =
+          y + i >= 0 ? batch->rows[(y + i) * batch->count + lane] : 0;
+      ok &= !(bits & wall) && !(bits & (dir < 0 ? row << 1 : row >> 1));
+    }
+  }
+  return ok;
+}
+
+/**
+ * Read a cell the way field_blocked() does: the walls and the floor are
+ * filled, cells above the field are free.
+ */
+static int lane_cell(const Batch_t *batch, int lane, int row, int col) {
+  int res = 1;
+  if (col >= 0 && col < WIDTH && row < HEIGHT)
+    res = row >= 0 && (batch->rows[row * batch->count + lane] >> col & 1);
+  return res;
+}
+
+/**
+ * Side collision bits of collision() for a view: 2 - a cell has a neighbour
+ * on the left, 1 - on the right.
+ */
+static int view_sides(const Batch_t *batch, int lane, unsigned int mask,
+                      int x, int y) {
+  int res = 0;
+  for (int bit = 0; bit < FIGURE_CELLS; bit++) {
+    if (mask >> bit & 1) {
+      int row = y + bit / FIGURE_SIZE;
+      int col = x + bit % FIGURE_SIZE;
+      if (lane_cell(batch, lane, row, col - 1)) res |= 2;
+      if (lane_cell(batch, lane, row, col + 1)) res |= 1;
+    }
+  }
+  return res;
+}
+
+/**
+ * leaving_field() for a view: the code of the last cell off the field in
+ * view order, 1 - left, 2 - right, 3 - bottom.
+ */
+static int view_leaving(unsigned int mask, int x, int y) {
+  int leave = 0;
+  for (int bit = 0; bit < FIGURE_CELLS; bit++) {
+    int col = x + bit % FIGURE_SIZE;
+    if (!(mask >> bit & 1))
+      continue;
+    else if (col < 0)
+      leave = 1;
+    else if (col > WIDTH - 1)
+      leave = 2;
+    else if (y + bit / FIGURE_SIZE > HEIGHT - 1)
+      leave = 3;
+  }
+  return leave;
+}
+
+/**
+ * Rotate the figure of a lane exactly as rotate_figure() does: the view turns
+ * into the next view of its piece unless that lifts cells above the field. A
+ * rotation off a wall is kicked back first, a rejected rotation keeps the
+ * kicked position.
+ */
+static void lane_rotate(Batch_t *batch, int lane) {
+  const Piece_t *piece = &batch->set->pieces[batch->kind[lane]];
+  unsigned int old = batch->mask[lane];
+  int view = pieces_view(piece, old);
+  unsigned int mask = view >= 0 ? piece->views[piece->views[view].next].mask
+                                : old;
+  int from = batch->x[lane];
+  int x = from;
+  int y = batch->y[lane];
+  if (y + __builtin_ctz(mask) / FIGURE_SIZE < 0) mask = old;
+  if (view_leaving(mask, x, y) == 1) {
+    for (int i = 0; i < piece->kick_left; i++)
+      if (!(view_sides(batch, lane, mask, x, y) & 1)) x++;
+  }
+  if (view_leaving(mask, x, y) == 2) {
+    for (int i = 0; i < piece->kick_right; i++)
+      if (!(view_sides(batch, lane, mask, x, y) & 2)) x--;
+  }
+  batch->x[lane] = x;
+  batch->mask[lane] = mask;
+  if (view_leaving(mask, x, y) || lane_overlay(batch, lane)) {
+    batch->mask[lane] = old;
+    if (x != from) batch->spun[lane] = 0;
+  } else {
+    batch->spun[lane] = 1;
+  }
+}
+
+/**
+ * Start a new game in a lane the way stats_init() does: empty field, a new
+ * next figure and zero counters.
+ */
+static void lane_reset(Batch_t *batch, int lane) {
+  for (int i = 0; i < HEIGHT; i++) batch->rows[i * batch->count + lane] = 0;
+  batch->next[lane] = next_random(&batch->rng[lane]) % batch->set->count;
+  batch->mask[lane] = 0;
+  batch->kind[lane] = 0;
+  batch->x[lane] = 0;
+  batch->y[lane] = 0;
+  batch->score[lane] = 0;
+  batch->level[lane] = LEVEL_MIN;
+  batch->gravity[lane] = level_gravity(LEVEL_MIN);
+  batch->ticks[lane] = 0;
+  batch->fall[lane] = 0;
+  batch->lock[lane] = 0;
+  batch->lines[lane] = 0;
+  batch->cleared[lane] = 0;
+  batch->pieces[lane] = 0;
+  batch->spun[lane] = 0;
+  batch->combo[lane] = 0;
+  batch->b2b[lane] = 0;
+  batch->state[lane] = START;
+}
+
+/**
+ * Spawn the next figure in every flagged lane, spawn_state_actions(). A
+ * figure that overlaps the stack is lifted above it and ends the game.
+ */
+static void batch_spawn(Batch_t *batch) {
+  for (int lane = 0; lane < batch->count; lane++) {
+    if (batch->flag[lane]) {
+      const Piece_t *piece = &batch->set->pieces[batch->next[lane]];
+      batch->kind[lane] = batch->next[lane];
+      batch->mask[lane] = piece->views[0].mask;
+      batch->x[lane] = piece->spawn.x;
+      batch->y[lane] = piece->spawn.y;
+      batch->next[lane] = next_random(&batch->rng[lane]) % batch->set->count;
+      batch->pieces[lane]++;
+      batch->fall[lane] = 0;
+      batch->lock[lane] = 0;
+      batch->spun[lane] = 0;
+      int over = lane_overlay(batch, lane);
+      while (lane_overlay(batch, lane)) batch->y[lane]--;
+      batch->state[lane] = over ? GAMEOVER : MOVING;
+    }
+  }
+}
+
+/**
+ * figure_spin() for a lane: a T rotated since it last moved with three
+ * corners of its 3x3 box occupied. The corner rows are read with the walls
+ * added as bits on both sides, rows below the field are full.
+ */
+static int lane_spin(const Batch_t *batch, int lane) {
+  int res = SPIN_NONE;
+  if (batch->set->pieces[batch->kind[lane]].type == 'T' && batch->spun[lane]) {
+    unsigned int corners = 0;
+    int x = batch->x[lane];
+    for (int i = 0; i < 2; i++) {
+      int row = batch->y[lane] + i * 2;
+      unsigned int bits = 0;
+      if (row >= HEIGHT)
+        bits = ~0u;
+      else if (row >= 0)
+        bits = batch->rows[row * batch->count + lane];
+      bits = bits << 1 | 1u | 1u << (WIDTH + 1);
+      corners |= (bits >> (x + 1) & 1) << (i * 2);
+      corners |= (bits >> (x + 3) & 1) << (i * 2 + 1);
+    }
+    res = spin_kind(batch->mask[lane], corners);
+  }
+  return res;
+}
+
+/**
+ * Set the figure of every flagged lane on its field and remove full rows,
+ * attaching_state_actions(). Removed rows are replaced by copies of the top
+ * row the way shift_lines() leaves it, a full top row (which never ends in
+ * the scalar engine) is removed like the others.
+ */
+static void batch_attach(Batch_t *batch) {
+  int count = batch->count;
+  unsigned short *rows = batch->rows;
+  for (int lane = 0; lane < count; lane++) {
+    if (batch->flag[lane]) {
+      unsigned int mask = batch->mask[lane];
+      int x = batch->x[lane];
+      int y = batch->y[lane];
+      int spin = lane_spin(batch, lane);
+      for (int i = 0; i < FIGURE_SIZE; i++) {
+        unsigned int bits = figure_row(mask, i, x);
+        if (bits != 0) rows[(y + i) * count + lane] |= bits;
+      }
+      unsigned short top = rows[lane];
+      int to = HEIGHT - 1;
+      for (int from = HEIGHT - 1; from >= 0; from--) {
+        unsigned short row = rows[from * count + lane];
+        rows[to * count + lane] = row;
+        to -= row != BATCH_FULL_ROW;
+      }
+      int lines = to + 1;
+      for (; to >= 0; to--) rows[to * count + lane] = top;
+      batch->cleared[lane] = lines;
+      batch->lines[lane] += lines;
+      int combo = batch->combo[lane];
+      int b2b = batch->b2b[lane];
+      batch->score[lane] += score_lock(lines, spin, &combo, &b2b);
+      batch->combo[lane] = (unsigned char)combo;
+      batch->b2b[lane] = (unsigned char)b2b;
+      int level = batch->score[lane] / 600 + 1;
+      if (level > LEVEL_MAX) level = LEVEL_MAX;
+      batch->level[lane] = level;
+      batch->gravity[lane] = level_gravity(level);
+    }
+  }
+}
+
+/**
+ * Init a batch of games, each one as seed_game() and stats_init() leave a
+ * headless game: waiting in START with its next figure drawn.
+ * @param batch Batch to init.
+ * @param count Number of games.
+ * @param seeds Figure generator seed of every game.
+ * @return 1 - allocated, 0 - out of memory.
+ */
+int batch_init(Batch_t *batch, int count, const unsigned int *seeds) {
+  memset(batch, 0, sizeof(*batch));
+  batch->count = count;
+  batch->set = pieces_active();
+  batch->rows = calloc((size_t)count * HEIGHT, sizeof(*batch->rows));
+  batch->mask = calloc(count, sizeof(*batch->mask));
+  batch->x = calloc(count, sizeof(*batch->x));
+  batch->y = calloc(count, sizeof(*batch->y));
+  batch->kind = calloc(count, sizeof(*batch->kind));
+  batch->next = calloc(count, sizeof(*batch->next));
+  batch->state = calloc(count, sizeof(*batch->state));
+  batch->level = calloc(count, sizeof(*batch->level));
+  batch->cleared = calloc(count, sizeof(*batch->cleared));
+  batch->flag = calloc(count, sizeof(*batch->flag));
+  batch->spun = calloc(count, sizeof(*batch->spun));
+  batch->combo = calloc(count, sizeof(*batch->combo));
+  batch->b2b = calloc(count, sizeof(*batch->b2b));
+  batch->fall = calloc(count, sizeof(*batch->fall));
+  batch->lock = calloc(count, sizeof(*batch->lock));
+  batch->gravity = calloc(count, sizeof(*batch->gravity));
+  batch->score = calloc(count, sizeof(*batch->score));
+  batch->lines = calloc(count, sizeof(*batch->lines));
+  batch->pieces = calloc(count, sizeof(*batch->pieces));
+  batch->rng = calloc(count, sizeof(*batch->rng));
+  batch->ticks = calloc(count, sizeof(*batch->ticks));
+  int res = batch->rows && batch->mask && batch->x && batch->y &&
+            batch->kind && batch->next && batch->state && batch->level &&
+            batch->cleared && batch->flag && batch->spun && batch->combo &&
+            batch->b2b && batch->fall && batch->lock &&
+            batch->gravity && batch->score && batch->lines && batch->pieces &&
+            batch->rng && batch->ticks;
+  for (int lane = 0; res && lane < count; lane++) {
+    batch->rng[lane] = seeds[lane] ? seeds[lane] : 1;
+    lane_reset(batch, lane);
+  }
+  if (!res) batch_free(batch);
+  return res;
+}
+
+/**
+ * Release the arrays of a batch.
+ * @param batch Batch.
+ */
+void batch_free(Batch_t *batch) {
+  free(batch->rows);
+  free(batch->mask);
+  free(batch->x);
+  free(batch->y);
+  free(batch->kind);
+  free(batch->next);
+  free(batch->state);
+  free(batch->level);
+  free(batch->cleared);
+  free(batch->flag);
+  free(batch->spun);
+  free(batch->combo);
+  free(batch->b2b);
+  free(batch->fall);
+  free(batch->lock);
+  free(batch->gravity);
+  free(batch->score);
+  free(batch->lines);
+  free(batch->pieces);
+  free(batch->rng);
+  free(batch->ticks);
+  memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * Deliver one action to every game, game_input() on each of them. The state
+ * machine runs as masks: every lane computes the transition its state and
+ * action select, then each move kernel runs over the lanes it applies to.
+ * @param batch Batch.
+ * @param actions Action of every game, -1 - no action.
+ */
+void batch_input(Batch_t *batch, const signed char *actions) {
+  int count = batch->count;
+  unsigned char *state = batch->state;
+  unsigned char *flag = batch->flag;
+  for (int lane = 0; lane < count; lane++) {
+    int action = actions[lane];
+    int moving = state[lane] == MOVING;
+    int paused = state[lane] == PAUSE;
+    int waiting = state[lane] == START || state[lane] == GAMEOVER;
+    int live = moving || paused || waiting;
+    int next = state[lane];
+    if (live && action == Terminate) next = EXIT_STATE;
+    if (moving && action == Pause) next = PAUSE;
+    if (paused && action == Pause) next = MOVING;
+    flag[lane] = waiting && action == Start;
+    int moved = 0;
+    if (moving && action == Left && lane_can_shift(batch, lane, -1)) {
+      batch->x[lane]--;
+      moved = 1;
+    }
+    if (moving && action == Right && lane_can_shift(batch, lane, 1)) {
+      batch->x[lane]++;
+      moved = 1;
+    }
+    if (moving && action == Down) {
+      for (; !lane_down(batch, lane); moved = 1) batch->y[lane]++;
+    }
+    if (moved) batch->spun[lane] = 0;
+    if (moving && action == Action) lane_rotate(batch, lane);
+    state[lane] = next;
+  }
+  for (int lane = 0; lane < count; lane++) {
+    if (flag[lane] && state[lane] == GAMEOVER) lane_reset(batch, lane);
+  }
+  batch_spawn(batch);
+}
+
+/**
+ * Advance every falling game by one fixed tick, game_tick() on each of them.
+ * Gravity and the lock delay are updated for all lanes at once, then the
+ * lanes due to shift fall by their whole rows in lockstep, and the lanes that
+ * could not fall attach their figure, clear lines and spawn the next one.
+ * @param batch Batch.
+ */
+void batch_tick(Batch_t *batch) {
+  int count = batch->count;
+  unsigned char *flag = batch->flag;
+  int *fall = batch->fall;
+  int *lock = batch->lock;
+  for (int lane = 0; lane < count; lane++) {
+    int moving = batch->state[lane] == MOVING;
+    int down = moving && lane_down(batch, lane);
+    int falling = moving && !down;
+    batch->ticks[lane] += moving;
+    lock[lane] += down;
+    fall[lane] = down ? 0 : fall[lane] + (falling ? batch->gravity[lane] : 0);
+    flag[lane] = (down && lock[lane] >= LOCK_DELAY) ||
+                 (falling && fall[lane] >= G_UNIT);
+  }
+  for (int lane = 0; lane < count; lane++) {
+    if (flag[lane]) {
+      int rows = fall[lane] / G_UNIT;
+      int moved = 0;
+      fall[lane] %= G_UNIT;
+      if (rows < 1) rows = 1;
+      for (; rows > 0 && !lane_down(batch, lane); rows--, moved++)
+        batch->y[lane]++;
+      if (moved) {
+        lock[lane] = 0;
+        batch->spun[lane] = 0;
+      }
+      flag[lane] = !moved;
+    }
+  }
+  batch_attach(batch);
+  batch_spawn(batch);
+}
+
+/**
+ * Deliver one action to every game and advance them by one tick, the batch
+ * counterpart of session_step().
+ * @param batch Batch.
+ * @param actions Action of every game, -1 - no action.
+ */
+void batch_step(Batch_t *batch, const signed char *actions) {
+  batch_input(batch, actions);
+  batch_tick(batch);
+}
+
+/**
+ * Copy one game of a batch to a game structure. The field keeps cell
+ * occupancy only, set cells are drawn in the garbage color.
+ * @param batch Batch.
+ * @param lane Game number.
+ * @param game Game structure to fill.
+ */
+void batch_get(const Batch_t *batch, int lane, GameInfo_t *game) {
+  PackedFigure current = {0};
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++)
+      game->field[i][j] = batch->rows[i * batch->count + lane] >> j & 1
+                              ? COLOR_GARBAGE
+                              : 0;
+  }
+  reset_figure(&game->next);
+  make_figure(&game->next, batch->next[lane]);
+  reset_figure(&game->current);
+  make_figure(&game->current, batch->kind[lane]);
+  pack_figure(&game->current, &current);
+  const Piece_t *piece = &batch->set->pieces[batch->kind[lane]];
+  int view = pieces_view(piece, batch->mask[lane]);
+  if (view >= 0) {
+    current.rows = piece->views[view].rows;
+    current.cols = piece->views[view].cols;
+  }
+  current.mask = batch->mask[lane];
+  current.x = batch->x[lane];
+  current.y = batch->y[lane];
+  unpack_figure(&current, &game->current);
+  game->state = batch->state[lane];
+  game->score = batch->score[lane];
+  game->level = batch->level[lane];
+  game->gravity = batch->gravity[lane];
+  game->speed = GRAVITY_SPEED(game->gravity);
+  game->ticks = batch->ticks[lane];
+  game->fall = batch->fall[lane];
+  game->lock = batch->lock[lane];
+  game->rng = batch->rng[lane];
+  game->lines = batch->lines[lane];
+  game->cleared = batch->cleared[lane];
+  game->pieces = batch->pieces[lane];
+  game->spun = batch->spun[lane];
+  game->combo = batch->combo[lane];
+  game->b2b = batch->b2b[lane];
+  board_rebuild(&game->board, game->field);
+}
@@ -0,0 +1,50 @@
+#ifndef TETRIS_BATCH_H
+#define TETRIS_BATCH_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris_score.h"
+#include "tetris_session.h"
+
+// batch engine parameters
+#define BATCH_FULL_ROW ((1u << WIDTH) - 1)
+
+// headless games stepped in lockstep, laid out as structure of arrays: every
+// array holds one value per game (lane), board rows are row masks stored row
+// by row over the lanes, rows[row * count + lane]. Figures come from the
+// piece set active when the batch is made.
+typedef struct {
+  int count;
+  const PieceSet_t *set;
+  unsigned short *rows;
+  unsigned int *mask;
+  signed char *x;
+  signed char *y;
+  unsigned char *kind;
+  unsigned char *next;
+  unsigned char *state;
+  unsigned char *level;
+  unsigned char *cleared;
+  unsigned char *flag;
+  unsigned char *spun;
+  unsigned char *combo;
+  unsigned char *b2b;
+  int *fall;
+  int *lock;
+  int *gravity;
+  int *score;
+  int *lines;
+  int *pieces;
+  unsigned int *rng;
+  long long *ticks;
+} Batch_t;
+
+int batch_init(Batch_t *batch, int count, const unsigned int *seeds);
+void batch_free(Batch_t *batch);
+void batch_input(Batch_t *batch, const signed char *actions);
+void batch_tick(Batch_t *batch);
+void batch_step(Batch_t *batch, const signed char *actions);
+void batch_get(const Batch_t *batch, int lane, GameInfo_t *game);
+
+#endif
@@ -0,0 +1,224 @@
+#include "tetris_board.h"
+
+/**
+ * Count filled/empty changes along a row, walls count as filled.
+ */
+static int count_row_transitions(unsigned int row) {
+  unsigned int ext = row << 1 | 1u | 1u << (WIDTH + 1);
+  unsigned int changes = (ext ^ ext >> 1) & ((1u << (WIDTH + 1)) - 1);
+  return row ? __builtin_popcount(changes) : 0;
+}
+
+/**
+ * Count filled/empty changes down a column, the floor counts as filled.
+ */
+static int count_col_transitions(unsigned int col) {
+  unsigned int ext = col | 1u << HEIGHT;
+  unsigned int changes = (ext ^ ext >> 1) & ((1u << HEIGHT) - 1);
+  return col ? __builtin_popcount(changes) : 0;
+}
+
+/**
+ * Update the row transitions of a row from its mask.
+ */
+static void board_row(Board_t *board, int i) {
+  int transitions = count_row_transitions(board->rows[i]);
+  board->totals.row_transitions += transitions - board->row_transitions[i];
+  board->row_transitions[i] = (unsigned char)transitions;
+}
+
+/**
+ * Update the height, holes and transitions of a column from its mask: the
+ * top cell is the lowest set bit, holes are the empty cells below it.
+ */
+static void board_column(Board_t *board, int j) {
+  BoardFeatures *totals = &board->totals;
+  unsigned int col = board->cols[j];
+  int height = col ? HEIGHT - __builtin_ctz(col) : 0;
+  int holes = height - __builtin_popcount(col);
+  int transitions = count_col_transitions(col);
+  totals->aggregate_height += height - board->heights[j];
+  totals->holes += holes - board->holes[j];
+  totals->col_transitions += transitions - board->col_transitions[j];
+  board->heights[j] = (unsigned char)height;
+  board->holes[j] = (unsigned char)holes;
+  board->col_transitions[j] = (unsigned char)transitions;
+}
+
+/**
+ * Update the surface features of columns from..to once their heights are
+ * known: the step to the right neighbour (bumpiness), the well depth below
+ * the lower neighbour (walls are as high as the field) and the top height.
+ */
+static void board_surface(Board_t *board, int from, int to) {
+  BoardFeatures *totals = &board->totals;
+  const unsigned char *heights = board->heights;
+  for (int j = from; j <= to; j++) {
+    int left = j > 0 ? heights[j - 1] : HEIGHT;
+    int right = j < WIDTH - 1 ? heights[j + 1] : HEIGHT;
+    int well = (left < right ? left : right) - heights[j];
+    int step = j < WIDTH - 1 ? abs(heights[j] - heights[j + 1]) : 0;
+    if (well < 0) well = 0;
+    totals->wells += well - board->wells[j];
+    totals->bumpiness += step - board->steps[j];
+    board->wells[j] = (unsigned char)well;
+    board->steps[j] = (unsigned char)step;
+  }
+  totals->max_height = 0;
+  for (int j = 0; j < WIDTH; j++) {
+    if (heights[j] > totals->max_height) totals->max_height = heights[j];
+  }
+}
+
+/**
+ * Reset the board to an empty field, all features are zero.
+ * @param board Board.
+ */
+void board_clear(Board_t *board) { memset(board, 0, sizeof(*board)); }
+
+/**
+ * Recompute the board from scratch, used where the field is replaced as a
+ * whole (restored, loaded, garbage raised).
+ * @param board Board.
+ * @param field Game field.
+ */
+void board_rebuild(Board_t *board, const int field[HEIGHT][WIDTH]) {
+  board_clear(board);
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      if (field[i][j] != 0) {
+        board->rows[i] |= (unsigned short)(1u << j);
+        board->cols[j] |= 1u << i;
+      }
+    }
+  }
+  for (int i = 0; i < HEIGHT; i++) board_row(board, i);
+  for (int j = 0; j < WIDTH; j++) board_column(board, j);
+  board_surface(board, 0, WIDTH - 1);
+}
+
+/**
+ * Add the cells of a figure set on the field. Only the rows and columns the
+ * figure covers are recounted, the surface next to them is updated.
+ * @param board Board.
+ * @param mask Figure view, bit i * FIGURE_SIZE + j is view[i][j].
+ * @param x Figure column.
+ * @param y Figure row.
+ */
+void board_place(Board_t *board, unsigned int mask, int x, int y) {
+  unsigned int touched = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    int row = y + i;
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      int col = x + j;
+      if (mask >> (i * FIGURE_SIZE + j) & 1 && row >= 0 && row < HEIGHT &&
+          col >= 0 && col < WIDTH) {
+        board->rows[row] |= (unsigned short)(1u << col);
+        board->cols[col] |= 1u << row;
+        touched |= 1u << j;
+      }
+    }
+    if (mask >> (i * FIGURE_SIZE) & FIGURE_ROW && row >= 0 && row < HEIGHT)
+      board_row(board, row);
+  }
+  for (int j = 0; j < FIGURE_SIZE; j++) {
+    if (touched >> j & 1) board_column(board, x + j);
+  }
+  int from = x - 1 > 0 ? x - 1 : 0;
+  int to = x + FIGURE_SIZE < WIDTH - 1 ? x + FIGURE_SIZE : WIDTH - 1;
+  board_surface(board, from, to);
+}
+
+/**
+ * Remove a line the way shift_lines() does: the rows above move down by one
+ * and the top row stays as it was. Row data moves as a block and every
+ * column mask is shifted with two masks, no cell is read.
+ * @param board Board.
+ * @param line Removed line, line 0 is left as is like shift_lines() does.
+ */
+void board_remove_row(Board_t *board, int line) {
+  if (line > 0) {
+    board->totals.row_transitions +=
+        board->row_transitions[0] - board->row_transitions[line];
+    memmove(&board->rows[1], &board->rows[0], line * sizeof(board->rows[0]));
+    memmove(&board->row_transitions[1], &board->row_transitions[0],
+            line * sizeof(board->row_transitions[0]));
+    unsigned int above = (1u << line) - 1;
+    for (int j = 0; j < WIDTH; j++) {
+      unsigned int col = board->cols[j];
+      board->cols[j] = (col & ~(above | 1u << line)) | (col & above) << 1 |
+                       (col & 1u);
+      board_column(board, j);
+    }
+    board_surface(board, 0, WIDTH - 1);
+  }
+}
+
+/**
+ * Check the board against features counted cell by cell from the field.
+ * @param board Board.
+ * @param field Game field.
+ * @return 1 - the board matches the field, 0 - it is stale.
+ */
+int board_verify(const Board_t *board, const int field[HEIGHT][WIDTH]) {
+  BoardFeatures expected = {0};
+  int heights[WIDTH] = {0};
+  int res = 1;
+  for (int i = 0; i < HEIGHT; i++) {
+    int filled = 0;
+    int transitions = 0;
+    unsigned int row = 0;
+    for (int j = 0; j <= WIDTH; j++) {
+      int cell = j < WIDTH ? field[i][j] != 0 : 1;
+      int prev = j > 0 ? field[i][j - 1] != 0 : 1;
+      transitions += cell != prev;
+      if (j < WIDTH && cell) row |= 1u << j;
+      filled |= j < WIDTH && cell;
+    }
+    res &= board->rows[i] == row;
+    expected.row_transitions += filled ? transitions : 0;
+  }
+  for (int j = 0; j < WIDTH; j++) {
+    int top = HEIGHT;
+    int transitions = 0;
+    for (int i = 0; i < HEIGHT; i++) {
+      int cell = field[i][j] != 0;
+      int below = i < HEIGHT - 1 ? field[i + 1][j] != 0 : 1;
+      if (cell && top == HEIGHT) top = i;
+      if (!cell && top != HEIGHT) expected.holes++;
+      transitions += cell != below;
+    }
+    heights[j] = HEIGHT - top;
+    expected.aggregate_height += heights[j];
+    expected.col_transitions += top != HEIGHT ? transitions : 0;
+    if (heights[j] > expected.max_height) expected.max_height = heights[j];
+    res &= board->heights[j] == heights[j];
+  }
+  for (int j = 0; j < WIDTH; j++) {
+    int left = j > 0 ? heights[j - 1] : HEIGHT;
+    int right = j < WIDTH - 1 ? heights[j + 1] : HEIGHT;
+    int well = (left < right ? left : right) - heights[j];
+    expected.wells += well > 0 ? well : 0;
+    if (j < WIDTH - 1) expected.bumpiness += abs(heights[j] - heights[j + 1]);
+  }
+  return res && memcmp(&expected, &board->totals, sizeof(expected)) == 0;
+}
+
+/**
+ * Return the board of a game to update, rebuilt from the field first if the
+ * game was loaded without it by session_load().
+ * @param game Main game structure.
+ */
+Board_t *board_sync(GameInfo_t *game) {
+  if (game->board_stale) {
+    board_rebuild(&game->board, game->field);
+    game->board_stale = 0;
+  }
+  return &game->board;
+}
+
+/**
+ * Return the board of a game, read only.
+ * @param game Main game structure.
+ */
+const Board_t *game_board(GameInfo_t *game) { return board_sync(game); }
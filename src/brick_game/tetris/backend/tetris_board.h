@@ -0,0 +1,16 @@
+#ifndef TETRIS_BOARD_H
+#define TETRIS_BOARD_H
+
+#include <string.h>
+
+#include "tetris_backend.h"
+
+void board_clear(Board_t *board);
+void board_rebuild(Board_t *board, const int field[HEIGHT][WIDTH]);
+void board_place(Board_t *board, unsigned int mask, int x, int y);
+void board_remove_row(Board_t *board, int line);
+int board_verify(const Board_t *board, const int field[HEIGHT][WIDTH]);
+Board_t *board_sync(GameInfo_t *game);
+const Board_t *game_board(GameInfo_t *game);
+
+#endif
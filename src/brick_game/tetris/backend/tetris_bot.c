@@ -0,0 +1,116 @@
+#include "tetris_bot.h"
+
+/**
+ * Reset the bot, the next call plans for the current figure.
+ * @param bot Bot state.
+ */
+void bot_init(Bot_t *bot) {
+  bot->head = 0;
+  bot->len = 0;
+  bot->piece = -1;
+}
+
+/**
+ * Return the next bot action for the game. A plan is made once for every new
+ * figure and then played back one action per call.
+ * @param bot Bot state.
+ * @param game Game the bot plays.
+ * @return Next action or -1 if the bot waits.
+ */
+UserAction_t bot_action(Bot_t *bot, GameInfo_t *game) {
+  UserAction_t action = -1;
+  if (game->state == MOVING) {
+    if (bot->piece != game->pieces) {
+      bot_plan(bot, game);
+      bot->piece = game->pieces;
+    }
+    if (bot->head < bot->len) action = bot->queue[bot->head++];
+  }
+  return action;
+}
+
+/**
+ * Try every rotation and column for the current figure on a copy of the game
+ * and queue the actions of the best placement.
+ * @param bot Bot state.
+ * @param game Game the bot plays.
+ */
+void bot_plan(Bot_t *bot, GameInfo_t *game) {
+  GameInfo_t trial;
+  GameInfo_t *prev = bind_game(&trial);
+  double best = 0;
+  int best_rotations = 0;
+  int best_from = game->current.x;
+  int best_x = game->current.x;
+  int found = 0;
+  for (int rotations = 0; rotations < 4; rotations++) {
+    for (int x = -2; x < WIDTH; x++) {
+      int from = 0;
+      memcpy(&trial, game, sizeof(trial));
+      int lines = bot_try(&trial, rotations, x, &from);
+      if (lines >= 0) {
+        double score = bot_evaluate(&trial, lines);
+        if (!found || score > best) {
+          best = score;
+          best_rotations = rotations;
+          best_from = from;
+          best_x = x;
+          found = 1;
+        }
+      }
+    }
+  }
+  bind_game(prev);
+
+  bot->head = 0;
+  bot->len = 0;
+  for (int i = 0; i < best_rotations; i++) bot->queue[bot->len++] = Action;
+  for (int x = best_from; x > best_x; x--) bot->queue[bot->len++] = Left;
+  for (int x = best_from; x < best_x; x++) bot->queue[bot->len++] = Right;
+  bot->queue[bot->len++] = Down;
+}
+
+/**
+ * Rotate, move and drop the current figure of a bound trial game, then set it
+ * on the field and remove full lines.
+ * @param trial Trial game bound to the calling thread.
+ * @param rotations Number of rotations.
+ * @param target_x Target column of the figure.
+ * @param from_x Set to the figure column after rotation.
+ * @return Number of removed lines or -1 if the placement is unreachable.
+ */
+int bot_try(GameInfo_t *trial, int rotations, int target_x, int *from_x) {
+  int lines = -1;
+  for (int i = 0; i < rotations; i++) rotate_figure();
+  *from_x = trial->current.x;
+  for (int moved = 1; moved && trial->current.x > target_x;) {
+    int x = trial->current.x;
+    moving_left();
+    moved = trial->current.x != x;
+  }
+  for (int moved = 1; moved && trial->current.x < target_x;) {
+    int x = trial->current.x;
+    moving_right();
+    moved = trial->current.x != x;
+  }
+  if (trial->current.x == target_x) {
+    while ((collision() & 0b100) != 4) moving_down();
+    set_figure_on_field();
+    lines = 0;
+    while (remove_lines(&lines))
+      ;
+  }
+  return lines;
+}
+
+/**
+ * Evaluate the game field after a placement from its board features.
+ * @param game Game with the figure set on the field.
+ * @param lines Number of lines the placement removed.
+ * @return Placement score, higher is better.
+ */
+double bot_evaluate(GameInfo_t *game, int lines) {
+  const BoardFeatures *features = &game_board(game)->totals;
+  return BOT_HEIGHT * features->aggregate_height + BOT_LINES * lines +
+         BOT_HOLES * features->holes + BOT_BUMPINESS * features->bumpiness;
+}
@@ -0,0 +1,32 @@
+#ifndef TETRIS_BOT_H
+#define TETRIS_BOT_H
+
+#include <string.h>
+
+#include "tetris_backend.h"
+#include "tetris_board.h"
+
+// planned actions per figure
+#define BOT_QUEUE 16
+
+// placement evaluation weights
+#define BOT_HEIGHT -0.51
+#define BOT_LINES 0.76
+#define BOT_HOLES -0.36
+#define BOT_BUMPINESS -0.18
+
+// greedy placement bot, plans once per figure and plays one action per call
+typedef struct {
+  UserAction_t queue[BOT_QUEUE];
+  int head;
+  int len;
+  int piece;
+} Bot_t;
+
+void bot_init(Bot_t *bot);
+UserAction_t bot_action(Bot_t *bot, GameInfo_t *game);
+void bot_plan(Bot_t *bot, GameInfo_t *game);
+int bot_try(GameInfo_t *trial, int rotations, int target_x, int *from_x);
+double bot_evaluate(GameInfo_t *game, int lines);
+
+#endif
@@ -0,0 +1,497 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_dataset.h"
+
+// columns in file order, values are stored in host byte order
+static const DatasetColumn columns[DATASET_COLUMNS] = {
+    {"board", sizeof(unsigned short) * HEIGHT, offsetof(DatasetBlock, board)},
+    {"current", sizeof(unsigned char), offsetof(DatasetBlock, current)},
+    {"next", sizeof(unsigned char), offsetof(DatasetBlock, next)},
+    {"x", sizeof(signed char), offsetof(DatasetBlock, x)},
+    {"y", sizeof(signed char), offsetof(DatasetBlock, y)},
+    {"mask", sizeof(unsigned int), offsetof(DatasetBlock, mask)},
+    {"reward", sizeof(int), offsetof(DatasetBlock, reward)},
+    {"done", sizeof(unsigned char), offsetof(DatasetBlock, done)}};
+
+static unsigned char *column_data(DatasetBlock *block, int column) {
+  return (unsigned char *)block + columns[column].offset;
+}
+
+/**
+ * Return the size of the encoding buffer: every column of a full block
+ * encoded in the worst case.
+ */
+static size_t scratch_size() {
+  size_t size = 0;
+  for (int i = 0; i < DATASET_COLUMNS; i++) {
+    size_t raw = (size_t)columns[i].width * DATASET_BLOCK;
+    size += raw + raw / 128 + 1;
+  }
+  return size;
+}
+
+/**
+ * Create a dataset file and write its header: magic and the name and width of
+ * every column.
+ * @param set Dataset to init.
+ * @param path File path, an existing file is replaced.
+ * @param compress 1 - run-length encode columns that get smaller.
+ * @return 1 - created, 0 - error.
+ */
+int dataset_create(Dataset_t *set, const char *path, int compress) {
+  unsigned char header[8 + 4 + DATASET_COLUMNS * (DATASET_NAME_LEN + 4)] = {0};
+  unsigned char *pos = header + 8;
+  unsigned int count = DATASET_COLUMNS;
+  memcpy(header, DATASET_MAGIC, 8);
+  memcpy(pos, &count, 4);
+  pos += 4;
+  for (int i = 0; i < DATASET_COLUMNS; i++) {
+    unsigned int width = columns[i].width;
+    strncpy((char *)pos, columns[i].name, DATASET_NAME_LEN);
+    memcpy(pos + DATASET_NAME_LEN, &width, 4);
+    pos += DATASET_NAME_LEN + 4;
+  }
+  set->writable = 1;
+  set->compress = compress;
+  set->records = 0;
+  set->block.count = 0;
+  set->scratch = malloc(scratch_size());
+  set->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  int res = set->scratch != NULL && set->fd >= 0 &&
+            write(set->fd, header, sizeof(header)) == sizeof(header);
+  if (!res) dataset_close(set);
+  return res;
+}
+
+/**
+ * Add a record to the current block, a full block is written out.
+ * @param set Dataset open for writing.
+ * @param record Record to add.
+ * @return 1 - added, 0 - write error.
+ */
+int dataset_append(Dataset_t *set, const DatasetRecord *record) {
+  DatasetBlock *block = &set->block;
+  int i = block->count++;
+  memcpy(block->board[i], record->board, sizeof(record->board));
+  block->current[i] = record->current;
+  block->next[i] = record->next;
+  block->x[i] = record->x;
+  block->y[i] = record->y;
+  block->mask[i] = record->mask;
+  block->reward[i] = record->reward;
+  block->done[i] = record->done;
+  set->records++;
+  return block->count < DATASET_BLOCK || dataset_flush(set);
+}
+
+/**
+ * Write the current block with one writev(): the record count, the encoding
+ * and stored size of every column, then the columns one after another.
+ * @param set Dataset open for writing.
+ * @return 1 - written, 0 - write error.
+ */
+int dataset_flush(Dataset_t *set) {
+  unsigned int header[1 + 2 * DATASET_COLUMNS];
+  struct iovec parts[1 + DATASET_COLUMNS];
+  unsigned char *scratch = set->scratch;
+  int count = set->block.count;
+  ssize_t total = sizeof(header);
+  header[0] = count;
+  parts[0].iov_base = header;
+  parts[0].iov_len = sizeof(header);
+  for (int i = 0; i < DATASET_COLUMNS; i++) {
+    int raw = columns[i].width * count;
+    int size = raw;
+    parts[i + 1].iov_base = column_data(&set->block, i);
+    header[1 + 2 * i] = DATASET_RAW;
+    if (set->compress) {
+      size = rle_encode(column_data(&set->block, i), raw, scratch);
+      if (size < raw) {
+        parts[i + 1].iov_base = scratch;
+        header[1 + 2 * i] = DATASET_RLE;
+        scratch += size;
+      } else {
+        size = raw;
+      }
+    }
+    header[2 + 2 * i] = size;
+    parts[i + 1].iov_len = size;
+    total += size;
+  }
+  int res = count == 0 || writev(set->fd, parts, 1 + DATASET_COLUMNS) == total;
+  set->block.count = 0;
+  return res;
+}
+
+/**
+ * Write the last block of a dataset open for writing and close the file.
+ * @param set Dataset.
+ * @return 1 - closed, 0 - write error.
+ */
+int dataset_close(Dataset_t *set) {
+  int res = set->fd >= 0;
+  if (res && set->writable && set->scratch != NULL) res = dataset_flush(set);
+  if (set->fd >= 0) res = close(set->fd) == 0 && res;
+  free(set->scratch);
+  set->scratch = NULL;
+  set->fd = -1;
+  return res;
+}
+
+/**
+ * Open a dataset file for reading and check that its columns match.
+ * @param set Dataset to init, close it with dataset_close().
+ * @param path File path.
+ * @return 1 - opened, 0 - file error or another format.
+ */
+int dataset_open(Dataset_t *set, const char *path) {
+  unsigned char header[8 + 4 + DATASET_COLUMNS * (DATASET_NAME_LEN + 4)];
+  unsigned int count = 0;
+  set->writable = 0;
+  set->compress = 0;
+  set->records = 0;
+  set->block.count = 0;
+  set->scratch = malloc(scratch_size());
+  set->fd = open(path, O_RDONLY);
+  int res = set->scratch != NULL && set->fd >= 0 &&
+            read(set->fd, header, sizeof(header)) == sizeof(header) &&
+            memcmp(header, DATASET_MAGIC, 8) == 0;
+  if (res) memcpy(&count, header + 8, 4);
+  res = res && count == DATASET_COLUMNS;
+  for (int i = 0; res && i < DATASET_COLUMNS; i++) {
+    const unsigned char *pos = header + 12 + i * (DATASET_NAME_LEN + 4);
+    unsigned int width = 0;
+    memcpy(&width, pos + DATASET_NAME_LEN, 4);
+    res = strncmp((const char *)pos, columns[i].name, DATASET_NAME_LEN) == 0 &&
+          width == (unsigned int)columns[i].width;
+  }
+  if (!res) {
+    free(set->scratch);
+    set->scratch = NULL;
+    if (set->fd >= 0) close(set->fd);
+    set->fd = -1;
+  }
+  return res;
+}
+
+/**
+ * Read the next block of an open dataset into set->block.
+ * @param set Dataset open for reading.
+ * @return 1 - block read, 0 - end of file or malformed block.
+ */
+int dataset_read_block(Dataset_t *set) {
+  unsigned int header[1 + 2 * DATASET_COLUMNS];
+  int res = read(set->fd, header, sizeof(header)) == sizeof(header) &&
+            header[0] > 0 && header[0] <= DATASET_BLOCK;
+  int count = res ? (int)header[0] : 0;
+  for (int i = 0; res && i < DATASET_COLUMNS; i++) {
+    int raw = columns[i].width * count;
+    int size = (int)header[2 + 2 * i];
+    unsigned char *data = column_data(&set->block, i);
+    if (header[1 + 2 * i] == DATASET_RLE) {
+      res = size > 0 && size < raw &&
+            read(set->fd, set->scratch, size) == size &&
+            rle_decode(set->scratch, size, data, raw) == raw;
+    } else {
+      res = header[1 + 2 * i] == DATASET_RAW && size == raw &&
+            read(set->fd, data, size) == size;
+    }
+  }
+  set->block.count = res ? count : 0;
+  set->records += set->block.count;
+  return res;
+}
+
+/**
+ * Copy a record out of a block.
+ * @param block Block.
+ * @param i Record index in the block.
+ * @param record Record to fill.
+ */
+void dataset_get(const DatasetBlock *block, int i, DatasetRecord *record) {
+  memcpy(record->board, block->board[i], sizeof(record->board));
+  record->current = block->current[i];
+  record->next = block->next[i];
+  record->x = block->x[i];
+  record->y = block->y[i];
+  record->mask = block->mask[i];
+  record->reward = block->reward[i];
+  record->done = block->done[i];
+}
+
+/**
+ * Run-length encode bytes: a control byte 0-127 is followed by that many plus
+ * one literal bytes, a control byte 129-255 repeats the next byte 257 minus
+ * control times.
+ * @param src Bytes to encode.
+ * @param len Number of bytes.
+ * @param dst Output of at least len + len / 128 + 1 bytes.
+ * @return Encoded size.
+ */
+int rle_encode(const unsigned char *src, int len, unsigned char *dst) {
+  int out = 0;
+  for (int i = 0; i < len;) {
+    int run = 1;
+    while (i + run < len && run < 128 && src[i + run] == src[i]) run++;
+    if (run >= 3) {
+      dst[out++] = (unsigned char)(257 - run);
+      dst[out++] = src[i];
+      i += run;
+    } else {
+      int start = i;
+      while (i < len && i - start < 128 &&
+             !(i + 2 < len && src[i] == src[i + 1] && src[i] == src[i + 2]))
+        i++;
+      dst[out++] = (unsigned char)(i - start - 1);
+      memcpy(dst + out, src + start, i - start);
+      out += i - start;
+    }
+  }
+  return out;
+}
+
+/**
+ * Decode bytes written by rle_encode().
+ * @param src Encoded bytes.
+ * @param len Number of encoded bytes.
+ * @param dst Output.
+ * @param size Output size.
+ * @return Decoded size, -1 - malformed input or output overflow.
+ */
+int rle_decode(const unsigned char *src, int len, unsigned char *dst,
+               int size) {
+  int out = 0;
+  int res = 1;
+  for (int i = 0; res && i < len;) {
+    int control = src[i++];
+    int n = control < 128 ? control + 1 : 257 - control;
+    res = control != 128 && out + n <= size &&
+          (control < 128 ? i + n <= len : i < len);
+    if (res && control < 128) {
+      memcpy(dst + out, src + i, n);
+      i += n;
+    } else if (res) {
+      memset(dst + out, src[i++], n);
+    }
+    out += n;
+  }
+  return res ? out : -1;
+}
+
+/**
+ * Check if a packed figure view fits on a field of row masks, rows above the
+ * field are free.
+ */
+static int figure_fits(const unsigned short *board, unsigned int mask, int x,
+                       int y) {
+  int res = 1;
+  for (int bit = 0; res && bit < FIGURE_CELLS; bit++) {
+    if (mask >> bit & 1) {
+      int row = y + bit / FIGURE_SIZE;
+      int col = x + bit % FIGURE_SIZE;
+      res = col >= 0 && col < WIDTH && row < HEIGHT &&
+            (row < 0 || !(board[row] >> col & 1));
+    }
+  }
+  return res;
+}
+
+/**
+ * Start a sample for the figure that has just spawned.
+ */
+static void sampler_take(Sampler_t *sampler, GameInfo_t *game) {
+  DatasetRecord *record = &sampler->pending;
+  memcpy(record->board, game_board(game)->rows, sizeof(record->board));
+  record->current = figure_kind(game->current.type);
+  record->next = figure_kind(game->next.type);
+  sampler->pieces = game->pieces;
+  sampler->score = game->score;
+}
+
+/**
+ * Init a sampler with no figure in play.
+ * @param sampler Sampler to init.
+ */
+void sampler_init(Sampler_t *sampler) {
+  memset(sampler, 0, sizeof(*sampler));
+}
+
+/**
+ * Deliver an action or a tick to a headless game and append a record once a
+ * figure is placed. The figure can only lock on a step that does not move it
+ * sideways, so its placement is its position before the step dropped to rest.
+ * The reward is the score the placement earned.
+ * @param set Dataset open for writing.
+ * @param sampler Sampler of the game.
+ * @param game Headless game.
+ * @param action The user action, -1 - one tick.
+ * @return 1 - stepped, 0 - write error.
+ */
+int sample_step(Dataset_t *set, Sampler_t *sampler, GameInfo_t *game,
+                UserAction_t action) {
+  Tetramino before = game->current;
+  int res = 1;
+  if ((int)action == -1)
+    game_tick(game);
+  else
+    game_input(game, action);
+  if (sampler->open && game->pieces != sampler->pieces) {
+    DatasetRecord *record = &sampler->pending;
+    PackedFigure placed;
+    pack_figure(&before, &placed);
+    while (figure_fits(record->board, placed.mask, placed.x, placed.y + 1))
+      placed.y++;
+    record->x = placed.x;
+    record->y = placed.y;
+    record->mask = placed.mask;
+    record->reward = game->score - sampler->score;
+    record->done = game->state == GAMEOVER;
+    res = dataset_append(set, record);
+    sampler->open = 0;
+  }
+  if (!sampler->open && game->state == MOVING) {
+    sampler_take(sampler, game);
+    sampler->open = 1;
+  }
+  return res;
+}
+
+/**
+ * Record a headless game played by the greedy bot.
+ * @param set Dataset open for writing.
+ * @param seed Figure generator seed.
+ * @param max_ticks Tick limit.
+ * @return 1 - recorded, 0 - write error.
+ */
+int dataset_bot_game(Dataset_t *set, unsigned int seed, long long max_ticks) {
+  GameInfo_t game = {0};
+  Sampler_t sampler;
+  Bot_t bot;
+  game.headless = 1;
+  game.metrics = 1;
+  seed_game(&game, seed);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  bot_init(&bot);
+  sampler_init(&sampler);
+  int res = sample_step(set, &sampler, &game, Start);
+  while (res && game.state == MOVING && game.ticks < max_ticks) {
+    UserAction_t action = bot_action(&bot, &game);
+    if ((int)action != -1) res = sample_step(set, &sampler, &game, action);
+    if (res) res = sample_step(set, &sampler, &game, -1);
+  }
+  return res;
+}
+
+/**
+ * Record a recorded game, it is re-simulated the same way replay_run() does.
+ * @param set Dataset open for writing.
+ * @param rec Recording.
+ * @return 1 - recorded, 0 - write error or the events cannot be replayed.
+ */
+int dataset_replay(Dataset_t *set, const Recording_t *rec) {
+  GameInfo_t game = {0};
+  Sampler_t sampler;
+  int res = 1;
+  game.headless = 1;
+  seed_game(&game, rec->seed);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  sampler_init(&sampler);
+  for (int i = 0; res && i < rec->count; i++) {
+    const ReplayEvent *event = &rec->events[i];
+    while (res && game.state == MOVING && game.ticks < event->tick)
+      res = sample_step(set, &sampler, &game, -1);
+    res = res && game.ticks == event->tick && event->action >= Start &&
+          event->action <= Action &&
+          (game.state == START || game.state == MOVING ||
+           game.state == PAUSE) &&
+          sample_step(set, &sampler, &game, event->action);
+  }
+  while (res && game.state == MOVING && game.ticks < rec->ticks)
+    res = sample_step(set, &sampler, &game, -1);
+  return res;
+}
+
+/**
+ * Export training records of verified recordings and of bot games on a pool
+ * of worker threads, each worker streams to its own shard file
+ * shard-N.ttds of the output directory.
+ * @param out Output directory, created if missing.
+ * @param replays Directory with recordings, NULL - none.
+ * @param games Number of bot games.
+ * @param threads Number of worker threads.
+ * @param compress 1 - run-length encode columns.
+ * @return Number of records exported, -1 - an error occurred.
+ */
+long long dataset_export(const char *out, const char *replays, int games,
+                         int threads, int compress) {
+  pthread_t workers[DATASET_THREADS_MAX];
+  Exporter_t exporter = {0};
+  int res = 1;
+  exporter.out = out;
+  exporter.games = games > 0 ? games : 0;
+  exporter.compress = compress;
+  if (replays != NULL) {
+    exporter.replays = replay_list(replays, &exporter.paths);
+    res = exporter.replays >= 0;
+  }
+  mkdir(out, 0755);
+  atomic_init(&exporter.next, 0);
+  atomic_init(&exporter.shards, 0);
+  atomic_init(&exporter.failed, 0);
+  atomic_init(&exporter.records, 0);
+  int jobs = exporter.replays + exporter.games;
+  if (threads > jobs) threads = jobs;
+  if (threads < 1) threads = 1;
+  if (threads > DATASET_THREADS_MAX) threads = DATASET_THREADS_MAX;
+  int started = 0;
+  for (; res && started < threads; started++) {
+    if (pthread_create(&workers[started], NULL, dataset_worker, &exporter))
+      break;
+  }
+  if (res && started == 0) dataset_worker(&exporter);
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+  free(exporter.paths);
+  res = res && atomic_load(&exporter.failed) == 0;
+  return res ? atomic_load(&exporter.records) : -1;
+}
+
+/**
+ * Worker thread of dataset_export(). Recordings whose claimed result does not
+ * replay are skipped.
+ * @param arg Exporter_t shared by the workers.
+ */
+void *dataset_worker(void *arg) {
+  Exporter_t *exporter = arg;
+  Dataset_t *set = malloc(sizeof(*set));
+  Recording_t rec;
+  char path[REPLAY_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/shard-%03d%s", exporter->out,
+           atomic_fetch_add(&exporter->shards, 1), DATASET_EXT);
+  recording_init(&rec);
+  int res = set != NULL && dataset_create(set, path, exporter->compress);
+  int jobs = exporter->replays + exporter->games;
+  for (int i = atomic_fetch_add(&exporter->next, 1); res && i < jobs;
+       i = atomic_fetch_add(&exporter->next, 1)) {
+    if (i < exporter->replays) {
+      ReplayResult result;
+      if (recording_load(&rec, exporter->paths[i]) &&
+          replay_run(&rec, &result))
+        res = dataset_replay(set, &rec);
+    } else {
+      res = dataset_bot_game(set, i - exporter->replays + 1,
+                             DATASET_MAX_TICKS);
+    }
+  }
+  if (set != NULL) {
+    atomic_fetch_add(&exporter->records, set->records);
+    res = dataset_close(set) && res;
+  }
+  if (!res) atomic_fetch_add(&exporter->failed, 1);
+  recording_free(&rec);
+  free(set);
+  return NULL;
+}
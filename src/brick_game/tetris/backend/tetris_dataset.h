@@ -0,0 +1,112 @@
+#ifndef TETRIS_DATASET_H
+#define TETRIS_DATASET_H
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "tetris_bot.h"
+#include "tetris_replay.h"
+#include "tetris_session.h"
+
+// dataset file format
+#define DATASET_MAGIC "TTRSDS02"
+#define DATASET_EXT ".ttds"
+#define DATASET_BLOCK 65536
+#define DATASET_COLUMNS 8
+#define DATASET_NAME_LEN 12
+#define DATASET_RAW 0
+#define DATASET_RLE 1
+
+// dataset export parameters
+#define DATASET_MAX_TICKS (60L * 60 * 10)
+#define DATASET_THREADS_MAX 64
+#define EXPORT_GAMES 1000
+
+// training sample: the field a figure spawned on and where it was placed
+typedef struct {
+  unsigned short board[HEIGHT];
+  unsigned char current;
+  unsigned char next;
+  signed char x;
+  signed char y;
+  unsigned int mask;
+  int reward;
+  unsigned char done;
+} DatasetRecord;
+
+// block of samples stored column by column, the unit of every file write
+typedef struct {
+  int count;
+  unsigned short board[DATASET_BLOCK][HEIGHT];
+  unsigned char current[DATASET_BLOCK];
+  unsigned char next[DATASET_BLOCK];
+  signed char x[DATASET_BLOCK];
+  signed char y[DATASET_BLOCK];
+  unsigned int mask[DATASET_BLOCK];
+  int reward[DATASET_BLOCK];
+  unsigned char done[DATASET_BLOCK];
+} DatasetBlock;
+
+// fixed-width column of a block
+typedef struct {
+  const char *name;
+  int width;
+  size_t offset;
+} DatasetColumn;
+
+// open dataset shard for writing or reading, one per thread
+typedef struct {
+  int fd;
+  int writable;
+  int compress;
+  long long records;
+  unsigned char *scratch;
+  DatasetBlock block;
+} Dataset_t;
+
+// records the placement of every figure of a game stepped through it
+typedef struct {
+  DatasetRecord pending;
+  int open;
+  int pieces;
+  int score;
+} Sampler_t;
+
+// export jobs shared between worker threads
+typedef struct {
+  const char *out;
+  char (*paths)[REPLAY_PATH_MAX];
+  int replays;
+  int games;
+  int compress;
+  atomic_int next;
+  atomic_int shards;
+  atomic_int failed;
+  atomic_llong records;
+} Exporter_t;
+
+int dataset_create(Dataset_t *set, const char *path, int compress);
+int dataset_append(Dataset_t *set, const DatasetRecord *record);
+int dataset_flush(Dataset_t *set);
+int dataset_close(Dataset_t *set);
+int dataset_open(Dataset_t *set, const char *path);
+int dataset_read_block(Dataset_t *set);
+void dataset_get(const DatasetBlock *block, int i, DatasetRecord *record);
+
+int rle_encode(const unsigned char *src, int len, unsigned char *dst);
+int rle_decode(const unsigned char *src, int len, unsigned char *dst,
+               int size);
+
+void sampler_init(Sampler_t *sampler);
+int sample_step(Dataset_t *set, Sampler_t *sampler, GameInfo_t *game,
+                UserAction_t action);
+int dataset_bot_game(Dataset_t *set, unsigned int seed, long long max_ticks);
+int dataset_replay(Dataset_t *set, const Recording_t *rec);
+
+long long dataset_export(const char *out, const char *replays, int games,
+                         int threads, int compress);
+void *dataset_worker(void *arg);
+
+#endif
@@ -0,0 +1,227 @@
+#include "tetris_finesse.h"
+
+static FinesseTable finesse_tables;
+static pthread_once_t finesse_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Build the shared finesse table, run once per process.
+ */
+static void finesse_table_build() { finesse_build(&finesse_tables); }
+
+/**
+ * Shift a figure mask to its top left cell.
+ * @param mask Figure view, bit i * FIGURE_SIZE + j is view[i][j].
+ * @param x Figure column, set to the column of the left cell.
+ * @return Shifted mask.
+ */
+static unsigned int finesse_view(unsigned int mask, int *x) {
+  while (mask != 0 && (mask & FIGURE_ROW) == 0) mask >>= FIGURE_SIZE;
+  while (mask != 0 && (mask & FIGURE_COLUMN) == 0) {
+    mask >>= 1;
+    (*x)++;
+  }
+  return mask;
+}
+
+/**
+ * Return the finesse table shared by all games, built on the first call for
+ * the piece set active then.
+ */
+const FinesseTable *finesse_table() {
+  pthread_once(&finesse_once, finesse_table_build);
+  return &finesse_tables;
+}
+
+/**
+ * Fill a finesse table for the active piece set from the engine's movement
+ * rules: every figure spawns on an empty field and the move generator finds
+ * the shortest path to each resting placement. Rows of gravity on the path
+ * are waited for, not pressed, so only Left, Right and Action moves are kept.
+ * @param table Table to fill.
+ */
+void finesse_build(FinesseTable *table) {
+  MoveGen_t *gen = malloc(sizeof(*gen));
+  Placement *placements = malloc(PLACEMENTS_MAX * sizeof(*placements));
+  memset(table, 0, sizeof(*table));
+  memset(table->presses, FINESSE_NONE, sizeof(table->presses));
+  table->set = pieces_active();
+  for (int kind = 0;
+       gen != NULL && placements != NULL && kind < table->set->count;
+       kind++) {
+    GameInfo_t game = {0};
+    game.headless = 1;
+    seed_game(&game, 1);
+    GameInfo_t *prev = bind_game(&game);
+    make_figure(&game.next, kind);
+    spawn_figure();
+    bind_game(prev);
+    int count = generate_placements(gen, &game, placements);
+    for (int i = 0; i < count; i++) {
+      int column = placements[i].figure.x;
+      unsigned int mask = finesse_view(placements[i].figure.mask, &column);
+      int view = 0;
+      while (view < table->view_count[kind] &&
+             table->views[kind][view] != mask)
+        view++;
+      if (view == table->view_count[kind] && view < FINESSE_VIEWS)
+        table->views[kind][table->view_count[kind]++] = mask;
+      unsigned char moves[FINESSE_PATH];
+      int presses = 0;
+      for (int j = 0; j < placements[i].length; j++) {
+        if (placements[i].moves[j] != MOVE_DOWN && presses < FINESSE_PATH)
+          moves[presses++] = placements[i].moves[j];
+      }
+      if (view < FINESSE_VIEWS && column >= 0 && column < WIDTH &&
+          presses < FINESSE_PATH &&
+          presses < table->presses[kind][view][column]) {
+        table->presses[kind][view][column] = (unsigned char)presses;
+        memcpy(table->moves[kind][view][column], moves, presses);
+      }
+    }
+  }
+  free(placements);
+  free(gen);
+}
+
+/**
+ * Find the table entry of a figure position from its type, rotation and
+ * column, the row is ignored.
+ * @param table Finesse table.
+ * @param figure Figure.
+ * @param view Set to the rotation index of the figure.
+ * @param column Set to the column of the left cell of the figure.
+ * @return Figure kind or -1 if the figure has no entry.
+ */
+int finesse_key(const FinesseTable *table, const Tetramino *figure, int *view,
+                int *column) {
+  PackedFigure packed;
+  int res = -1;
+  pack_figure(figure, &packed);
+  *column = packed.x;
+  unsigned int mask = finesse_view(packed.mask, column);
+  const Piece_t *piece = pieces_find(table->set, packed.type);
+  int kind = piece != NULL ? (int)(piece - table->set->pieces) : -1;
+  if (kind >= 0 && *column >= 0 && *column < WIDTH) {
+    *view = 0;
+    while (*view < table->view_count[kind] &&
+           table->views[kind][*view] != mask)
+      (*view)++;
+    if (*view < table->view_count[kind]) res = kind;
+  }
+  return res;
+}
+
+/**
+ * Return the fewest actions that bring a spawned figure to the column and
+ * rotation of the given one on an open board, ending with the Down drop.
+ * @param figure Target figure position.
+ * @param actions Array of FINESSE_PATH actions to fill.
+ * @return Number of actions or -1 if the position has no entry.
+ */
+int finesse_optimal(const Tetramino *figure, UserAction_t *actions) {
+  static const UserAction_t move_actions[] = {Left, Right, Action};
+  const FinesseTable *table = finesse_table();
+  int view = 0;
+  int column = 0;
+  int res = -1;
+  int kind = finesse_key(table, figure, &view, &column);
+  if (kind >= 0 && table->presses[kind][view][column] != FINESSE_NONE) {
+    res = table->presses[kind][view][column];
+    for (int i = 0; i < res; i++)
+      actions[i] = move_actions[table->moves[kind][view][column][i]];
+    actions[res++] = Down;
+  }
+  return res;
+}
+
+/**
+ * Start a new analysis with zero totals.
+ * @param finesse Finesse analyzer.
+ */
+void finesse_reset(Finesse_t *finesse) {
+  memset(finesse, 0, sizeof(*finesse));
+  finesse->piece = -1;
+}
+
+/**
+ * Count an action pressed while a figure is falling.
+ * @param finesse Finesse analyzer.
+ * @param game Game the action is applied to.
+ * @param action User action.
+ */
+void finesse_input(Finesse_t *finesse, const GameInfo_t *game,
+                   UserAction_t action) {
+  if (finesse->piece != game->pieces) {
+    finesse->piece = game->pieces;
+    finesse->shifts = 0;
+    finesse->drops = 0;
+  }
+  if (action == Left || action == Right || action == Action)
+    finesse->shifts++;
+  else if (action == Down)
+    finesse->drops++;
+}
+
+/**
+ * Compare the presses of the figure being locked with the table. Presses
+ * beyond the table count and every drop after the first are wasted.
+ * Positions the open board has no entry for are skipped.
+ * @param finesse Finesse analyzer.
+ * @param game Game with the figure at its final position.
+ */
+void finesse_lock(Finesse_t *finesse, const GameInfo_t *game) {
+  const FinesseTable *table = finesse_table();
+  FinesseSummary *summary = &finesse->summary;
+  int view = 0;
+  int column = 0;
+  int kind = finesse_key(table, &game->current, &view, &column);
+  int optimal = kind >= 0 ? table->presses[kind][view][column] : FINESSE_NONE;
+  if (finesse->piece != game->pieces) {
+    finesse->shifts = 0;
+    finesse->drops = 0;
+  }
+  finesse->last = 0;
+  if (optimal == FINESSE_NONE) {
+    summary->skipped++;
+  } else {
+    if (finesse->shifts > optimal) finesse->last += finesse->shifts - optimal;
+    if (finesse->drops > 1) finesse->last += finesse->drops - 1;
+    summary->pieces++;
+    summary->faults += finesse->last > 0;
+    summary->presses += finesse->shifts + finesse->drops;
+    summary->optimal += optimal + (finesse->drops > 0);
+    summary->wasted += finesse->last;
+  }
+  finesse->piece = -1;
+  finesse->shifts = 0;
+  finesse->drops = 0;
+}
+
+/**
+ * Re-simulate a recording with the analyzer attached.
+ * @param finesse Finesse analyzer, totals are added to.
+ * @param rec Recording.
+ * @return 1 - the recording was replayed, 0 - its events cannot be replayed.
+ */
+int finesse_replay(Finesse_t *finesse, const Recording_t *rec) {
+  GameInfo_t game = {0};
+  FinesseSummary summary = finesse->summary;
+  game.finesse = finesse;
+  int res = replay_play(rec, &game);
+  finesse_add(&finesse->summary, &summary);
+  return res;
+}
+
+/**
+ * Add finesse totals to others.
+ * @param total Totals to add to.
+ * @param summary Totals to add.
+ */
+void finesse_add(FinesseSummary *total, const FinesseSummary *summary) {
+  total->pieces += summary->pieces;
+  total->faults += summary->faults;
+  total->presses += summary->presses;
+  total->optimal += summary->optimal;
+  total->wasted += summary->wasted;
+  total->skipped += summary->skipped;
+}
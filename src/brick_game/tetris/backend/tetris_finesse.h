@@ -0,0 +1,57 @@
+#ifndef TETRIS_FINESSE_H
+#define TETRIS_FINESSE_H
+
+#include <pthread.h>
+
+#include "tetris_movegen.h"
+#include "tetris_replay.h"
+
+// finesse table parameters
+#define FINESSE_VIEWS 4
+#define FINESSE_PATH 16
+#define FINESSE_NONE 0xFF
+
+// fewest Left/Right/Action presses to every column and rotation of every
+// figure of a piece set on an open board, views are shifted to their top left
+// cell
+typedef struct {
+  const PieceSet_t *set;
+  unsigned int views[PIECES_MAX][FINESSE_VIEWS];
+  unsigned char view_count[PIECES_MAX];
+  unsigned char presses[PIECES_MAX][FINESSE_VIEWS][WIDTH];
+  unsigned char moves[PIECES_MAX][FINESSE_VIEWS][WIDTH][FINESSE_PATH];
+} FinesseTable;
+
+// finesse totals over the figures of a game
+typedef struct {
+  int pieces;
+  int faults;
+  int presses;
+  int optimal;
+  int wasted;
+  int skipped;
+} FinesseSummary;
+
+// finesse analyzer attached to a game: presses of the falling figure, the
+// wasted presses of the last locked one and the game totals
+typedef struct Finesse {
+  int piece;
+  int shifts;
+  int drops;
+  int last;
+  FinesseSummary summary;
+} Finesse_t;
+
+const FinesseTable *finesse_table();
+void finesse_build(FinesseTable *table);
+int finesse_key(const FinesseTable *table, const Tetramino *figure, int *view,
+                int *column);
+int finesse_optimal(const Tetramino *figure, UserAction_t *actions);
+void finesse_reset(Finesse_t *finesse);
+void finesse_input(Finesse_t *finesse, const GameInfo_t *game,
+                   UserAction_t action);
+void finesse_lock(Finesse_t *finesse, const GameInfo_t *game);
+int finesse_replay(Finesse_t *finesse, const Recording_t *rec);
+void finesse_add(FinesseSummary *total, const FinesseSummary *summary);
+
+#endif
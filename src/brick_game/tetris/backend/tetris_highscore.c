@@ -0,0 +1,146 @@
+#define _DEFAULT_SOURCE
+
+#include "tetris_highscore.h"
+
+#include "tetris_leaderboard.h"
+
+static HighScore_t process_store = {.fd = -1};
+static pthread_once_t process_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Raise the shared score to at least the given one.
+ * @return 1 - raised, 0 - the shared score was already as high.
+ */
+static int score_max(HighScoreShared *shared, int score) {
+  int best = atomic_load(&shared->score);
+  while (score > best &&
+         !atomic_compare_exchange_weak(&shared->score, &best, score))
+    ;
+  return score > best;
+}
+
+/**
+ * Write the shared score to the text file. The caller holds the file lock,
+ * so writers never interleave and the file only moves up.
+ * @return 1 - written and synced, 0 - file error.
+ */
+static int score_persist(HighScore_t *store) {
+  char temp[520];
+  snprintf(temp, sizeof(temp), "%s.tmp", store->path);
+  FILE *file = fopen(temp, "w");
+  int res = file != NULL;
+  if (res) {
+    fprintf(file, "%d", atomic_load(&store->shared->score));
+    res = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    res = fclose(file) == 0 && res && rename(temp, store->path) == 0;
+  }
+  return res;
+}
+
+/**
+ * Open the high score store of a data directory, creating it on first use
+ * from the best of the high score file and the leaderboard.
+ * @param store Store to open.
+ * @param dir Data directory.
+ * @return 1 - opened, 0 - file error.
+ */
+int highscore_open(HighScore_t *store, const char *dir) {
+  char path[512];
+  struct stat st;
+  Leaderboard_t board;
+  int res = 0;
+  memset(store, 0, sizeof(*store));
+  mkdir(dir, 0755);
+  snprintf(store->path, sizeof(store->path), "%s/%s", dir, HIGH_SCORE_FILE);
+  snprintf(path, sizeof(path), "%s/%s", dir, HIGH_SCORE_MAP);
+  store->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (store->fd >= 0 && flock(store->fd, LOCK_EX) == 0) {
+    res = fstat(store->fd, &st) == 0 &&
+          (st.st_size >= (off_t)sizeof(HighScoreShared) ||
+           ftruncate(store->fd, sizeof(HighScoreShared)) == 0);
+    void *map = res ? mmap(NULL, sizeof(HighScoreShared),
+                           PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0)
+                    : MAP_FAILED;
+    res = map != MAP_FAILED;
+    if (res) store->shared = map;
+    if (res && memcmp(store->shared->magic, HIGH_SCORE_MAGIC, 8) != 0) {
+      atomic_store(&store->shared->score, 0);
+      memcpy(store->shared->magic, HIGH_SCORE_MAGIC, 8);
+    }
+    if (res) score_max(store->shared, read_high_score(store->path));
+    if (res && leaderboard_open(&board, dir)) {
+      score_max(store->shared, leaderboard_best(&board));
+      leaderboard_close(&board);
+    }
+    flock(store->fd, LOCK_UN);
+  }
+  if (!res) highscore_close(store);
+  return res;
+}
+
+/**
+ * Close the store, writing a record it raised to the high score file.
+ * @param store Store.
+ */
+void highscore_close(HighScore_t *store) {
+  if (store->shared != NULL) highscore_flush(store);
+  if (store->shared != NULL) munmap(store->shared, sizeof(HighScoreShared));
+  if (store->fd >= 0) close(store->fd);
+  store->shared = NULL;
+  store->fd = -1;
+}
+
+/**
+ * Return the best score of every process, a single atomic load.
+ * @param store Open store.
+ */
+int highscore_get(const HighScore_t *store) {
+  return atomic_load(&store->shared->score);
+}
+
+/**
+ * Offer a score. The shared score is raised with a compare-and-swap, so a
+ * lower score never replaces a higher one whatever the order of the
+ * processes. Offers are made on every lock, so the file is only marked to be
+ * written by highscore_flush().
+ * @param store Open store.
+ * @param score Score to offer.
+ * @return The best score after the offer.
+ */
+int highscore_offer(HighScore_t *store, int score) {
+  if (score_max(store->shared, score)) atomic_store(&store->dirty, 1);
+  return highscore_get(store);
+}
+
+/**
+ * Write the shared score to the high score file under the store lock if this
+ * process raised it since the last flush.
+ * @param store Open store.
+ * @return 1 - written or nothing to write, 0 - file error.
+ */
+int highscore_flush(HighScore_t *store) {
+  int res = 1;
+  if (atomic_exchange(&store->dirty, 0)) {
+    res = flock(store->fd, LOCK_EX) == 0;
+    if (res) {
+      res = score_persist(store);
+      flock(store->fd, LOCK_UN);
+    }
+    if (!res) atomic_store(&store->dirty, 1);
+  }
+  return res;
+}
+
+static void process_store_open() {
+  highscore_open(&process_store, data_dir());
+}
+
+/**
+ * Return the store of the data directory shared by the process, opened on
+ * first use.
+ * @return The store, NULL - it cannot be opened.
+ */
+HighScore_t *highscore_store() {
+  pthread_once(&process_once, process_store_open);
+  return process_store.shared != NULL ? &process_store : NULL;
+}
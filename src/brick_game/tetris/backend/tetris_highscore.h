@@ -0,0 +1,41 @@
+#ifndef TETRIS_HIGHSCORE_H
+#define TETRIS_HIGHSCORE_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tetris_backend.h"
+
+// shared high score file in the data directory
+#define HIGH_SCORE_MAP "high_score.map"
+#define HIGH_SCORE_MAGIC "TTRSHS01"
+
+// memory-mapped high score shared by every process of the data directory
+typedef struct {
+  char magic[8];
+  atomic_int score;
+} HighScoreShared;
+
+// open high score store, dirty is set when this process raised the score
+// and the file is not written yet
+typedef struct {
+  int fd;
+  HighScoreShared *shared;
+  atomic_int dirty;
+  char path[512];
+} HighScore_t;
+
+int highscore_open(HighScore_t *store, const char *dir);
+void highscore_close(HighScore_t *store);
+int highscore_get(const HighScore_t *store);
+int highscore_offer(HighScore_t *store, int score);
+int highscore_flush(HighScore_t *store);
+HighScore_t *highscore_store();
+
+#endif
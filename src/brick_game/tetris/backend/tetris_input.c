@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_input.h"
+
+/**
+ * Init an empty input queue.
+ * @param queue Input queue.
+ */
+void input_init(InputQueue *queue) {
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->waiting, 0);
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->wake, NULL);
+}
+
+/**
+ * Release the wake-up lock of a queue nobody uses any more.
+ * @param queue Input queue.
+ */
+void input_free(InputQueue *queue) {
+  pthread_cond_destroy(&queue->wake);
+  pthread_mutex_destroy(&queue->lock);
+}
+
+/**
+ * Add an event to the queue, called by the producer thread only.
+ * @param queue Input queue.
+ * @param action The user action.
+ * @param time Time the action was read at in microseconds.
+ * @return 1 - event added, 0 - queue is full.
+ */
+int input_push(InputQueue *queue, UserAction_t action, long long time) {
+  unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+  int res = tail - head < INPUT_QUEUE_SIZE;
+  if (res) {
+    InputEvent *event = &queue->events[tail & (INPUT_QUEUE_SIZE - 1)];
+    event->action = action;
+    event->time = time;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+  if (res && atomic_load_explicit(&queue->waiting, memory_order_relaxed)) {
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_signal(&queue->wake);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return res;
+}
+
+/**
+ * Take the oldest event from the queue, called by the consumer thread only.
+ * @param queue Input queue.
+ * @param event Event to fill.
+ * @return 1 - event taken, 0 - queue is empty.
+ */
+int input_pop(InputQueue *queue, InputEvent *event) {
+  unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+  int res = head != tail;
+  if (res) {
+    *event = queue->events[head & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  }
+  return res;
+}
+
+/**
+ * Block the consumer until the queue has an event or the timeout passes. The
+ * waiting flag is set before the queue is checked and the producer reads it
+ * after adding an event, so an event is either seen here or wakes the wait.
+ * @param queue Input queue.
+ * @param timeout_us Longest wait in microseconds, 0 - do not wait.
+ * @return 1 - the queue has an event, 0 - timed out.
+ */
+int input_wait(InputQueue *queue, long long timeout_us) {
+  int res = atomic_load(&queue->head) != atomic_load(&queue->tail);
+  if (!res && timeout_us > 0) {
+    long long at = get_time_us() + timeout_us;
+    struct timespec until = {at / 1000000, at % 1000000 * 1000};
+    pthread_mutex_lock(&queue->lock);
+    atomic_store(&queue->waiting, 1);
+    while (!(res = atomic_load(&queue->head) != atomic_load(&queue->tail)) &&
+           pthread_cond_timedwait(&queue->wake, &queue->lock, &until) == 0)
+      ;
+    atomic_store(&queue->waiting, 0);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return res;
+}
@@ -0,0 +1,37 @@
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "tetris_backend.h"
+
+// input queue parameters, the size must be a power of two
+#define INPUT_QUEUE_SIZE 256
+#define INPUT_ALIGN 64
+
+// user action and the time it was read at
+typedef struct {
+  UserAction_t action;
+  long long time;
+} InputEvent;
+
+// single-producer single-consumer ring, each index on its own cache line,
+// the producer only takes the lock to wake a consumer blocked in input_wait()
+typedef struct {
+  InputEvent events[INPUT_QUEUE_SIZE];
+  _Alignas(INPUT_ALIGN) atomic_uint head;
+  _Alignas(INPUT_ALIGN) atomic_uint tail;
+  atomic_int waiting;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} InputQueue;
+
+void input_init(InputQueue *queue);
+void input_free(InputQueue *queue);
+int input_push(InputQueue *queue, UserAction_t action, long long time);
+int input_pop(InputQueue *queue, InputEvent *event);
+int input_wait(InputQueue *queue, long long timeout_us);
+
+#endif
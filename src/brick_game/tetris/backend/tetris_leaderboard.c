@@ -0,0 +1,307 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_leaderboard.h"
+#include "tetris_pieces.h"
+
+/**
+ * Check if the node goes before the other one: higher score first, equal
+ * scores in the order they were added.
+ */
+static int node_before(const LeaderNode *a, const LeaderNode *b) {
+  return a->score > b->score || (a->score == b->score && a->record < b->record);
+}
+
+static void node_update(LeaderNode *nodes, int node) {
+  nodes[node].size = nodes[nodes[node].left].size +
+                     nodes[nodes[node].right].size + 1;
+}
+
+static int rotate_right(LeaderNode *nodes, int node) {
+  int left = nodes[node].left;
+  nodes[node].left = nodes[left].right;
+  nodes[left].right = node;
+  node_update(nodes, node);
+  node_update(nodes, left);
+  return left;
+}
+
+static int rotate_left(LeaderNode *nodes, int node) {
+  int right = nodes[node].right;
+  nodes[node].right = nodes[right].left;
+  nodes[right].left = node;
+  node_update(nodes, node);
+  node_update(nodes, right);
+  return right;
+}
+
+/**
+ * Insert a node into the treap.
+ * @param nodes Treap nodes.
+ * @param root Subtree root.
+ * @param node Node to insert.
+ * @return New subtree root.
+ */
+static int node_insert(LeaderNode *nodes, int root, int node) {
+  if (root != 0) {
+    nodes[root].size++;
+    if (node_before(&nodes[node], &nodes[root])) {
+      nodes[root].left = node_insert(nodes, nodes[root].left, node);
+      if (nodes[nodes[root].left].priority > nodes[root].priority)
+        root = rotate_right(nodes, root);
+    } else {
+      nodes[root].right = node_insert(nodes, nodes[root].right, node);
+      if (nodes[nodes[root].right].priority > nodes[root].priority)
+        root = rotate_left(nodes, root);
+    }
+  } else {
+    root = node;
+  }
+  return root;
+}
+
+/**
+ * Map the index file with room for the given number of nodes, the file is
+ * extended if needed.
+ * @return 1 - mapped, 0 - error.
+ */
+static int index_map(Leaderboard_t *board, int capacity) {
+  size_t size = sizeof(LeaderHeader) + (capacity + 1) * sizeof(LeaderNode);
+  struct stat info;
+  int res = fstat(board->index_fd, &info) == 0;
+  if (res && (size_t)info.st_size < size)
+    res = ftruncate(board->index_fd, size) == 0;
+  if (res && board->header != NULL) munmap(board->header, board->map_size);
+  if (res) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     board->index_fd, 0);
+    res = map != MAP_FAILED;
+    board->header = res ? map : NULL;
+    board->nodes = res ? (LeaderNode *)(board->header + 1) : NULL;
+    board->map_size = res ? size : 0;
+  }
+  return res;
+}
+
+/**
+ * Add the record with the given number and score to the index.
+ * @return 1 - indexed, 0 - the index cannot grow.
+ */
+static int index_insert(Leaderboard_t *board, int record, int score) {
+  int res = 1;
+  if (board->header->count == board->header->capacity) {
+    int capacity = board->header->capacity * 2;
+    res = index_map(board, capacity);
+    if (res) board->header->capacity = capacity;
+  }
+  if (res) {
+    int node = ++board->header->count;
+    LeaderNode *nodes = board->nodes;
+    nodes[node].score = score;
+    nodes[node].record = record;
+    nodes[node].priority = next_random(&board->header->rng);
+    nodes[node].left = 0;
+    nodes[node].right = 0;
+    nodes[node].size = 1;
+    board->header->root = node_insert(nodes, board->header->root, node);
+  }
+  return res;
+}
+
+/**
+ * Index the records of the log that are not indexed yet. An index that does
+ * not match the log is rebuilt from scratch. The caller holds the index lock.
+ * @return 1 - index is up to date, 0 - error.
+ */
+static int index_sync(Leaderboard_t *board) {
+  off_t size = lseek(board->log_fd, 0, SEEK_END);
+  int records = size > 0 ? (int)(size / sizeof(LeaderRecord)) : 0;
+  int res = 1;
+  if (size > 0 && size % sizeof(LeaderRecord) != 0)
+    res = ftruncate(board->log_fd, (off_t)records * sizeof(LeaderRecord)) == 0;
+  if (memcmp(board->header->magic, LEADER_MAGIC, 8) != 0 ||
+      board->header->count > records || board->header->capacity < 1) {
+    memcpy(board->header->magic, LEADER_MAGIC, 8);
+    board->header->count = 0;
+    board->header->root = 0;
+    board->header->capacity = LEADER_NODES_MIN;
+    board->header->rng = 0x2545F491;
+    memset(&board->nodes[0], 0, sizeof(LeaderNode));
+  }
+  if (res && board->header->capacity * sizeof(LeaderNode) +
+                     sizeof(LeaderHeader) >=
+                 board->map_size)
+    res = index_map(board, board->header->capacity);
+  for (int i = board->header->count; res && i < records; i++) {
+    LeaderRecord record;
+    res = pread(board->log_fd, &record, sizeof(record),
+                (off_t)i * sizeof(record)) == sizeof(record) &&
+          index_insert(board, i, record.score);
+  }
+  return res;
+}
+
+/**
+ * Open the leaderboard of the data directory, the files are created if
+ * missing.
+ * @param board Leaderboard to open.
+ * @param dir Data directory.
+ * @return 1 - opened, 0 - error.
+ */
+int leaderboard_open(Leaderboard_t *board, const char *dir) {
+  char path[512];
+  int res = 0;
+  memset(board, 0, sizeof(*board));
+  mkdir(dir, 0755);
+  snprintf(path, sizeof(path), "%s/%s", dir, LEADER_LOG);
+  board->log_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  snprintf(path, sizeof(path), "%s/%s", dir, LEADER_INDEX);
+  board->index_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (board->log_fd >= 0 && board->index_fd >= 0 &&
+      flock(board->index_fd, LOCK_EX) == 0) {
+    res = index_map(board, 0) && index_sync(board);
+    flock(board->index_fd, LOCK_UN);
+  }
+  if (!res) leaderboard_close(board);
+  return res;
+}
+
+/**
+ * Close the leaderboard files.
+ * @param board Leaderboard.
+ */
+void leaderboard_close(Leaderboard_t *board) {
+  if (board->header != NULL) munmap(board->header, board->map_size);
+  if (board->log_fd >= 0) close(board->log_fd);
+  if (board->index_fd >= 0) close(board->index_fd);
+  board->header = NULL;
+  board->nodes = NULL;
+  board->log_fd = -1;
+  board->index_fd = -1;
+}
+
+/**
+ * Append a record to the log and index it. The index lock is held from the
+ * resync with records other processes added to the insert, so the record
+ * number matches the position of the record in the log.
+ * @param board Leaderboard.
+ * @param record Record to add.
+ * @return Rank of the record, 0 - error.
+ */
+int leaderboard_add(Leaderboard_t *board, const LeaderRecord *record) {
+  int res = 0;
+  if (flock(board->index_fd, LOCK_EX) == 0) {
+    res = index_sync(board);
+    int number = board->header->count;
+    res = res &&
+          write(board->log_fd, record, sizeof(*record)) == sizeof(*record) &&
+          index_insert(board, number, record->score);
+    if (res) res = leaderboard_rank(board, record->score) - 1;
+    flock(board->index_fd, LOCK_UN);
+  }
+  return res;
+}
+
+/**
+ * Return the number of records.
+ * @param board Leaderboard.
+ */
+int leaderboard_count(const Leaderboard_t *board) {
+  return board->header->count;
+}
+
+/**
+ * Return the rank a new record with the given score gets: one more than the
+ * number of records with a higher or equal score.
+ * @param board Leaderboard.
+ * @param score Score.
+ */
+int leaderboard_rank(const Leaderboard_t *board, int score) {
+  const LeaderNode *nodes = board->nodes;
+  int rank = 1;
+  for (int node = board->header->root; node != 0;) {
+    if (nodes[node].score >= score) {
+      rank += nodes[nodes[node].left].size + 1;
+      node = nodes[node].right;
+    } else {
+      node = nodes[node].left;
+    }
+  }
+  return rank;
+}
+
+/**
+ * Read the record with the given rank.
+ * @param board Leaderboard.
+ * @param rank Rank, 1 - the best record.
+ * @param record Record to fill.
+ * @return 1 - record read, 0 - no such rank.
+ */
+int leaderboard_get(const Leaderboard_t *board, int rank, LeaderRecord *record) {
+  const LeaderNode *nodes = board->nodes;
+  int node = board->header->root;
+  int res = 0;
+  if (rank >= 1 && rank <= board->header->count) {
+    while (rank != nodes[nodes[node].left].size + 1) {
+      if (rank <= nodes[nodes[node].left].size) {
+        node = nodes[node].left;
+      } else {
+        rank -= nodes[nodes[node].left].size + 1;
+        node = nodes[node].right;
+      }
+    }
+    res = pread(board->log_fd, record, sizeof(*record),
+                (off_t)nodes[node].record * sizeof(*record)) ==
+          sizeof(*record);
+  }
+  return res;
+}
+
+/**
+ * Read the best records.
+ * @param board Leaderboard.
+ * @param records Records to fill.
+ * @param n Maximum number of records.
+ * @return Number of records read.
+ */
+int leaderboard_top(const Leaderboard_t *board, LeaderRecord *records, int n) {
+  int count = 0;
+  while (count < n && leaderboard_get(board, count + 1, &records[count]))
+    count++;
+  return count;
+}
+
+/**
+ * Return the best score or 0 for an empty leaderboard.
+ * @param board Leaderboard.
+ */
+int leaderboard_best(const Leaderboard_t *board) {
+  const LeaderNode *nodes = board->nodes;
+  int node = board->header->root;
+  while (node != 0 && nodes[node].left != 0) node = nodes[node].left;
+  return node != 0 ? nodes[node].score : 0;
+}
+
+/**
+ * Add a finished game to the leaderboard of the data directory. Games that
+ * never spawned a figure or played a custom piece set are skipped.
+ * @param game Finished game.
+ * @return Rank of the game, 0 - not added.
+ */
+int leaderboard_submit(const GameInfo_t *game) {
+  Leaderboard_t board;
+  LeaderRecord record = {0};
+  const char *name = getenv("USER");
+  int rank = 0;
+  if (game->pieces > 0 && pieces_active() == pieces_builtin() &&
+      leaderboard_open(&board, data_dir())) {
+    snprintf(record.name, sizeof(record.name), "%s", name ? name : "player");
+    record.score = game->score;
+    record.lines = game->lines;
+    record.level = game->level;
+    record.duration = (int)(game->ticks * TICK_US / 1000);
+    record.timestamp = time(NULL);
+    rank = leaderboard_add(&board, &record);
+    leaderboard_close(&board);
+  }
+  return rank;
+}
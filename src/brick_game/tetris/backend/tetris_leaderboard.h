@@ -0,0 +1,69 @@
+#ifndef TETRIS_LEADERBOARD_H
+#define TETRIS_LEADERBOARD_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tetris_backend.h"
+
+// leaderboard files in the data directory
+#define LEADER_LOG "leaderboard.log"
+#define LEADER_INDEX "leaderboard.idx"
+#define LEADER_MAGIC "TTRSIDX1"
+#define LEADER_NAME_LEN 16
+#define LEADER_NODES_MIN 1024
+#define LEADER_TOP 10
+
+// finished game, one fixed-size record of the append-only log
+typedef struct {
+  char name[LEADER_NAME_LEN];
+  int score;
+  int lines;
+  int level;
+  int duration;
+  long long timestamp;
+} LeaderRecord;
+
+// index file header, followed by the treap nodes
+typedef struct {
+  char magic[8];
+  int count;
+  int root;
+  int capacity;
+  unsigned int rng;
+} LeaderHeader;
+
+// order-statistic treap node, 0 is the empty node
+typedef struct {
+  int score;
+  int record;
+  unsigned int priority;
+  int left;
+  int right;
+  int size;
+} LeaderNode;
+
+// open leaderboard: record log and memory-mapped index
+typedef struct {
+  int log_fd;
+  int index_fd;
+  LeaderHeader *header;
+  LeaderNode *nodes;
+  size_t map_size;
+} Leaderboard_t;
+
+int leaderboard_open(Leaderboard_t *board, const char *dir);
+void leaderboard_close(Leaderboard_t *board);
+int leaderboard_add(Leaderboard_t *board, const LeaderRecord *record);
+int leaderboard_count(const Leaderboard_t *board);
+int leaderboard_rank(const Leaderboard_t *board, int score);
+int leaderboard_get(const Leaderboard_t *board, int rank, LeaderRecord *record);
+int leaderboard_top(const Leaderboard_t *board, LeaderRecord *records, int n);
+int leaderboard_best(const Leaderboard_t *board);
+int leaderboard_submit(const GameInfo_t *game);
+
+#endif
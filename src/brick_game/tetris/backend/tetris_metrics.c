@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_metrics.h"
+
+// shards of the threads that have counted something, the last one is shared
+// by the threads that come while all the others are owned; a shard goes to
+// the free list when its thread exits and keeps its counts for the next owner
+static MetricsShard shards[METRICS_SHARDS] = {
+    [METRICS_SHARDS - 1] = {.shared = 1}};
+static atomic_int shard_count;
+static int free_shards[METRICS_SHARDS - 1];
+static int free_count;
+static pthread_mutex_t shard_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t shard_once = PTHREAD_ONCE_INIT;
+static pthread_key_t shard_key;
+static _Thread_local MetricsShard *local_shard = NULL;
+
+/**
+ * Give the owned shard of an exiting thread back to the free list.
+ * @param value MetricsShard of the thread.
+ */
+static void shard_release(void *value) {
+  pthread_mutex_lock(&shard_lock);
+  free_shards[free_count++] = (int)((MetricsShard *)value - shards);
+  pthread_mutex_unlock(&shard_lock);
+}
+
+/**
+ * Create the key that releases shards at thread exit, run once per process.
+ */
+static void shard_key_create() { pthread_key_create(&shard_key, shard_release); }
+
+/**
+ * Return the shard of the calling thread, taking a free or a new one on first
+ * use.
+ */
+static MetricsShard *get_shard() {
+  if (local_shard == NULL) {
+    int index = METRICS_SHARDS - 1;
+    pthread_once(&shard_once, shard_key_create);
+    pthread_mutex_lock(&shard_lock);
+    if (free_count > 0) {
+      index = free_shards[--free_count];
+    } else if (atomic_load(&shard_count) < METRICS_SHARDS - 1) {
+      index = atomic_fetch_add(&shard_count, 1);
+    }
+    pthread_mutex_unlock(&shard_lock);
+    local_shard = &shards[index];
+    if (!local_shard->shared && pthread_setspecific(shard_key, local_shard)) {
+      shard_release(local_shard);
+      local_shard = &shards[METRICS_SHARDS - 1];
+    }
+  }
+  return local_shard;
+}
+
+/**
+ * Check if the calling thread counts into a shard of its own.
+ * @return 1 - owned shard, 0 - the shared one.
+ */
+int metrics_owned() { return !get_shard()->shared; }
+
+/**
+ * Add to a counter of the calling thread's shard. An owned shard needs no
+ * read-modify-write, the shared one falls back to an atomic add.
+ */
+static void shard_add(atomic_llong *counter, int shared) {
+  if (shared)
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+  else
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+}
+
+/**
+ * Count a figure set on the field.
+ * @param type Figure type letter.
+ */
+void metrics_piece(char type) {
+  MetricsShard *shard = get_shard();
+  shard_add(&shard->pieces[figure_kind(type)], shard->shared);
+}
+
+/**
+ * Count lines cleared at once, 1 to FIGURE_SIZE as scored by
+ * calculate_score().
+ * @param lines Number of lines.
+ */
+void metrics_clear(int lines) {
+  MetricsShard *shard = get_shard();
+  if (lines >= 1 && lines <= CLEAR_KINDS)
+    shard_add(&shard->clears[lines - 1], shard->shared);
+}
+
+/**
+ * Count a started game.
+ */
+void metrics_game_started() {
+  MetricsShard *shard = get_shard();
+  shard_add(&shard->started, shard->shared);
+}
+
+/**
+ * Count a finished game and the level it reached.
+ * @param level Final level.
+ */
+void metrics_game_ended(int level) {
+  MetricsShard *shard = get_shard();
+  shard_add(&shard->ended, shard->shared);
+  if (level >= 0 && level <= LEVEL_MAX)
+    shard_add(&shard->levels[level], shard->shared);
+}
+
+/**
+ * Sum the counters of every thread. Counters keep moving while they are read,
+ * each one is exact at some moment during the call.
+ * @param metrics Snapshot to fill.
+ */
+void metrics_snapshot(Metrics_t *metrics) {
+  int count = atomic_load(&shard_count);
+  memset(metrics, 0, sizeof(*metrics));
+  for (int i = 0; i <= count; i++) {
+    MetricsShard *shard = &shards[i < count ? i : METRICS_SHARDS - 1];
+    for (int j = 0; j < PIECES_MAX; j++)
+      metrics->pieces[j] +=
+          atomic_load_explicit(&shard->pieces[j], memory_order_relaxed);
+    for (int j = 0; j < CLEAR_KINDS; j++)
+      metrics->clears[j] +=
+          atomic_load_explicit(&shard->clears[j], memory_order_relaxed);
+    metrics->started +=
+        atomic_load_explicit(&shard->started, memory_order_relaxed);
+    metrics->ended += atomic_load_explicit(&shard->ended, memory_order_relaxed);
+    for (int j = 0; j <= LEVEL_MAX; j++)
+      metrics->levels[j] +=
+          atomic_load_explicit(&shard->levels[j], memory_order_relaxed);
+  }
+}
+
+/**
+ * Write a snapshot as "name{label} value" lines, pieces are labeled with the
+ * types of the active set. The file is written next to the target and renamed
+ * over it, so readers never see a partial dump.
+ * @param path File path.
+ * @return 1 - written, 0 - file error.
+ */
+int metrics_dump(const char *path) {
+  const PieceSet_t *set = pieces_active();
+  Metrics_t metrics;
+  char temp[512];
+  metrics_snapshot(&metrics);
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+  FILE *file = fopen(temp, "w");
+  int res = file != NULL;
+  if (res) {
+    fprintf(file, "tetris_games_started %lld\n", metrics.started);
+    fprintf(file, "tetris_games_ended %lld\n", metrics.ended);
+    for (int i = 0; i < set->count; i++)
+      fprintf(file, "tetris_pieces{type=\"%c\"} %lld\n", set->pieces[i].type,
+              metrics.pieces[i]);
+    for (int i = 0; i < CLEAR_KINDS; i++)
+      fprintf(file, "tetris_clears{lines=\"%d\"} %lld\n", i + 1,
+              metrics.clears[i]);
+    for (int i = LEVEL_MIN; i <= LEVEL_MAX; i++)
+      fprintf(file, "tetris_games_by_level{level=\"%d\"} %lld\n", i,
+              metrics.levels[i]);
+    res = fclose(file) == 0 && rename(temp, path) == 0;
+  }
+  return res;
+}
+
+/**
+ * Start a thread that dumps the metrics to a file periodically.
+ * @param dumper Dumper to start.
+ * @param path File path.
+ * @param interval_ms Time between dumps in milliseconds.
+ */
+void metrics_dumper_start(MetricsDumper_t *dumper, const char *path,
+                          int interval_ms) {
+  dumper->path = path;
+  dumper->interval_ms = interval_ms;
+  dumper->stop = 0;
+  pthread_mutex_init(&dumper->lock, NULL);
+  pthread_cond_init(&dumper->wake, NULL);
+  dumper->running = pthread_create(&dumper->thread, NULL,
+                                   metrics_dumper_thread, dumper) == 0;
+}
+
+/**
+ * Stop the dumper thread, a last dump is written on the way out.
+ * @param dumper Started dumper.
+ */
+void metrics_dumper_stop(MetricsDumper_t *dumper) {
+  pthread_mutex_lock(&dumper->lock);
+  dumper->stop = 1;
+  pthread_cond_signal(&dumper->wake);
+  pthread_mutex_unlock(&dumper->lock);
+  if (dumper->running) pthread_join(dumper->thread, NULL);
+  dumper->running = 0;
+  pthread_cond_destroy(&dumper->wake);
+  pthread_mutex_destroy(&dumper->lock);
+}
+
+/**
+ * Dumper thread of metrics_dumper_start().
+ * @param arg MetricsDumper_t to run.
+ */
+void *metrics_dumper_thread(void *arg) {
+  MetricsDumper_t *dumper = arg;
+  int stop = 0;
+  while (!stop) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += dumper->interval_ms / 1000;
+    until.tv_nsec += dumper->interval_ms % 1000 * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&dumper->lock);
+    while (!dumper->stop &&
+           pthread_cond_timedwait(&dumper->wake, &dumper->lock, &until) == 0)
+      ;
+    stop = dumper->stop;
+    pthread_mutex_unlock(&dumper->lock);
+    metrics_dump(dumper->path);
+  }
+  return NULL;
+}
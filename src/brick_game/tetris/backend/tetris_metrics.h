@@ -0,0 +1,60 @@
+#ifndef TETRIS_METRICS_H
+#define TETRIS_METRICS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "tetris_session.h"
+
+// metrics parameters
+#define METRICS_SHARDS 256
+#define METRICS_ALIGN 64
+#define METRICS_FILE "metrics.txt"
+#define METRICS_INTERVAL_MS 1000
+#define CLEAR_KINDS FIGURE_SIZE
+
+// counters of one thread, only the owning thread writes them so updates are
+// plain relaxed stores, readers load them without tearing
+typedef struct {
+  _Alignas(METRICS_ALIGN) atomic_llong pieces[PIECES_MAX];
+  atomic_llong clears[CLEAR_KINDS];
+  atomic_llong started;
+  atomic_llong ended;
+  atomic_llong levels[LEVEL_MAX + 1];
+  int shared;
+} MetricsShard;
+
+// snapshot of the counters of every thread
+typedef struct {
+  long long pieces[PIECES_MAX];
+  long long clears[CLEAR_KINDS];
+  long long started;
+  long long ended;
+  long long levels[LEVEL_MAX + 1];
+} Metrics_t;
+
+// thread writing a metrics snapshot to a file periodically
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  const char *path;
+  int interval_ms;
+  int stop;
+  int running;
+} MetricsDumper_t;
+
+void metrics_piece(char type);
+void metrics_clear(int lines);
+void metrics_game_started();
+void metrics_game_ended(int level);
+int metrics_owned();
+void metrics_snapshot(Metrics_t *metrics);
+int metrics_dump(const char *path);
+
+void metrics_dumper_start(MetricsDumper_t *dumper, const char *path,
+                          int interval_ms);
+void metrics_dumper_stop(MetricsDumper_t *dumper);
+void *metrics_dumper_thread(void *arg);
+
+#endif
@@ -0,0 +1,193 @@
+#include "tetris_movegen.h"
+
+/**
+ * Return the search state index of a figure position or -1 if the position
+ * is out of the search area.
+ */
+static int state_index(MoveGen_t *gen, const PackedFigure *figure) {
+  int view = 0;
+  int res = -1;
+  while (view < gen->view_count && gen->views[view] != figure->mask) view++;
+  if (view == gen->view_count && view < MOVEGEN_VIEWS)
+    gen->views[gen->view_count++] = figure->mask;
+  int x = figure->x + MOVEGEN_BORDER;
+  int y = figure->y + MOVEGEN_BORDER;
+  if (view < gen->view_count && x >= 0 && x < MOVEGEN_X && y >= 0 &&
+      y < MOVEGEN_Y)
+    res = (view * MOVEGEN_X + x) * MOVEGEN_Y + y;
+  return res;
+}
+
+/**
+ * Return the cells a figure covers as one key: the view mask moved to the
+ * top left corner of the box and, above it, the field index of that corner
+ * counted from MOVEGEN_BORDER rows above the field. Equal cell sets give
+ * equal keys whatever view and position they came from.
+ */
+static unsigned long long cells_key(const PackedFigure *figure) {
+  unsigned int columns = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++)
+    columns |= figure->mask >> (i * FIGURE_SIZE) & FIGURE_ROW;
+  int top = __builtin_ctz(figure->mask) / FIGURE_SIZE;
+  int left = __builtin_ctz(columns);
+  int row = figure->y + top + MOVEGEN_BORDER;
+  unsigned long long corner = (unsigned)(row * WIDTH + figure->x + left);
+  return corner << FIGURE_CELLS | figure->mask >> (top * FIGURE_SIZE) >> left;
+}
+
+/**
+ * Apply a move to the current figure of the bound game.
+ */
+static void apply_move(int move) {
+  switch (move) {
+    case MOVE_LEFT:
+      moving_left();
+      break;
+    case MOVE_RIGHT:
+      moving_right();
+      break;
+    case MOVE_ROTATE:
+      rotate_figure();
+      break;
+    case MOVE_DOWN:
+      moving_down();
+      break;
+  }
+}
+
+/**
+ * Store a resting figure as a placement unless a placement covering the same
+ * cells is already known. Breadth-first order makes the first path found the
+ * shortest one.
+ * @return New number of placements.
+ */
+static int add_placement(MoveGen_t *gen, int node, Placement *placements,
+                         int count) {
+  unsigned long long key = cells_key(&gen->nodes[node].figure);
+  int known = 0;
+  for (int i = 0; i < count && !known; i++)
+    known = cells_key(&placements[i].figure) == key;
+  if (!known && count < PLACEMENTS_MAX) {
+    Placement *placement = &placements[count++];
+    int length = 0;
+    placement->figure = gen->nodes[node].figure;
+    for (int i = node; gen->nodes[i].parent >= 0; i = gen->nodes[i].parent)
+      length++;
+    placement->length = length < MOVE_PATH_MAX ? length : MOVE_PATH_MAX;
+    for (int i = node; gen->nodes[i].parent >= 0; i = gen->nodes[i].parent) {
+      if (--length < MOVE_PATH_MAX) placement->moves[length] = gen->nodes[i].move;
+    }
+  }
+  return count;
+}
+
+/**
+ * List every distinct resting placement of the current figure reachable with
+ * moving_left(), moving_right(), moving_down() and rotate_figure(), tucks and
+ * spins under overhangs included, together with the shortest move path to
+ * each. The game is left unchanged.
+ * @param gen Search workspace.
+ * @param game Game with the figure to place.
+ * @param placements Array of PLACEMENTS_MAX placements to fill.
+ * @return Number of placements.
+ */
+int generate_placements(MoveGen_t *gen, GameInfo_t *game,
+                        Placement *placements) {
+  GameInfo_t *prev = bind_game(game);
+  Tetramino current = game->current;
+  int count = 0;
+  int head = 0;
+  int tail = 0;
+  memset(gen->visited, 0, sizeof(gen->visited));
+  gen->view_count = 0;
+  pack_figure(&game->current, &gen->nodes[tail].figure);
+  gen->nodes[tail].parent = -1;
+  gen->nodes[tail].move = -1;
+  int start = state_index(gen, &gen->nodes[tail].figure);
+  if (start >= 0) {
+    gen->visited[start] = 1;
+    tail++;
+  }
+  for (; head < tail; head++) {
+    Tetramino base;
+    unpack_figure(&gen->nodes[head].figure, &base);
+    game->current = base;
+    if ((collision() & 0b100) == 4)
+      count = add_placement(gen, head, placements, count);
+    for (int move = 0; move < MOVE_KINDS; move++) {
+      PackedFigure moved;
+      game->current = base;
+      apply_move(move);
+      pack_figure(&game->current, &moved);
+      int state = state_index(gen, &moved);
+      if (state >= 0 && !gen->visited[state] && tail < MOVEGEN_STATES) {
+        gen->visited[state] = 1;
+        gen->nodes[tail].figure = moved;
+        gen->nodes[tail].parent = head;
+        gen->nodes[tail].move = move;
+        tail++;
+      }
+    }
+  }
+  game->current = current;
+  bind_game(prev);
+  return count;
+}
+
+/**
+ * Set a placement on the field, remove full lines and spawn the next figure.
+ * @param game Game to update.
+ * @param placement Placement of the current figure.
+ * @return 1 - the next figure fits, 0 - the game is over.
+ */
+int placement_apply(GameInfo_t *game, const Placement *placement) {
+  GameInfo_t *prev = bind_game(game);
+  int lines = 0;
+  unpack_figure(&placement->figure, &game->current);
+  set_figure_on_field();
+  while (remove_lines(&lines))
+    ;
+  game->lines += lines;
+  spawn_figure();
+  game->pieces++;
+  int fits = !figure_overlay();
+  bind_game(prev);
+  return fits;
+}
+
+/**
+ * Count the positions reachable by placing the next depth figures, every
+ * placement generates the next figure from the game generator.
+ * @param game Start position with the current figure spawned.
+ * @param depth Number of figures to place.
+ * @return Number of leaf positions, 1 for depth 0.
+ */
+long long perft(GameInfo_t *game, int depth) {
+  MoveGen_t *gen = malloc(sizeof(*gen));
+  long long nodes = gen != NULL ? perft_search(gen, game, depth) : 0;
+  free(gen);
+  return nodes;
+}
+
+/**
+ * Recursive step of perft() sharing one search workspace.
+ * @param gen Search workspace.
+ * @param game Current position.
+ * @param depth Number of figures left to place.
+ * @return Number of leaf positions.
+ */
+long long perft_search(MoveGen_t *gen, GameInfo_t *game, int depth) {
+  long long nodes = 1;
+  if (depth > 0) {
+    Placement *placements = malloc(PLACEMENTS_MAX * sizeof(*placements));
+    int count = placements ? generate_placements(gen, game, placements) : 0;
+    nodes = depth == 1 ? count : 0;
+    for (int i = 0; depth > 1 && i < count; i++) {
+      GameInfo_t child = *game;
+      if (placement_apply(&child, &placements[i]))
+        nodes += perft_search(gen, &child, depth - 1);
+    }
+    free(placements);
+  }
+  return nodes;
+}
@@ -0,0 +1,46 @@
+#ifndef TETRIS_MOVEGEN_H
+#define TETRIS_MOVEGEN_H
+
+#include "tetris_session.h"
+
+// move generator parameters
+#define MOVE_PATH_MAX 64
+#define PLACEMENTS_MAX 256
+#define MOVEGEN_VIEWS 8
+#define MOVEGEN_BORDER FIGURE_SIZE
+#define MOVEGEN_X (WIDTH + 2 * MOVEGEN_BORDER)
+#define MOVEGEN_Y (HEIGHT + 2 * MOVEGEN_BORDER)
+#define MOVEGEN_STATES (MOVEGEN_VIEWS * MOVEGEN_X * MOVEGEN_Y)
+
+// figure moves, MOVE_DOWN is a single row of gravity or soft drop
+typedef enum { MOVE_LEFT, MOVE_RIGHT, MOVE_ROTATE, MOVE_DOWN, MOVE_KINDS } Move_t;
+
+// final resting place of a figure and the shortest move path to it
+typedef struct {
+  PackedFigure figure;
+  unsigned char moves[MOVE_PATH_MAX];
+  int length;
+} Placement;
+
+// searched figure position and the move it was reached with
+typedef struct {
+  PackedFigure figure;
+  short parent;
+  char move;
+} MoveNode;
+
+// breadth-first search workspace, reused between searches
+typedef struct {
+  MoveNode nodes[MOVEGEN_STATES];
+  unsigned char visited[MOVEGEN_STATES];
+  unsigned int views[MOVEGEN_VIEWS];
+  int view_count;
+} MoveGen_t;
+
+int generate_placements(MoveGen_t *gen, GameInfo_t *game,
+                        Placement *placements);
+int placement_apply(GameInfo_t *game, const Placement *placement);
+long long perft(GameInfo_t *game, int depth);
+long long perft_search(MoveGen_t *gen, GameInfo_t *game, int depth);
+
+#endif
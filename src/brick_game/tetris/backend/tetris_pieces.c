@@ -0,0 +1,313 @@
+#include "tetris_pieces.h"
+
+// definitions of the seven tetrominoes in make_figure() order
+static const char pieces_tetrominoes[] =
+    PIECES_MAGIC
+    "\n"
+    "piece I red\n"
+    "....\n"
+    "####\n"
+    "turn\n"
+    ".#\n"
+    ".#\n"
+    ".#\n"
+    ".#\n"
+    "piece O yellow fixed\n"
+    ".##\n"
+    ".##\n"
+    "piece L blue\n"
+    "..#\n"
+    "###\n"
+    "...\n"
+    "piece J green\n"
+    "#..\n"
+    "###\n"
+    "...\n"
+    "piece S cyan\n"
+    ".##\n"
+    "##.\n"
+    "...\n"
+    "piece T orange\n"
+    ".#.\n"
+    "###\n"
+    "...\n"
+    "piece Z violet\n"
+    "##.\n"
+    ".##\n"
+    "...\n";
+
+// color names of piece definitions
+static const struct {
+  const char *name;
+  int color;
+} piece_colors[] = {
+    {"red", COLOR_RED},       {"yellow", COLOR_YELLOW_},
+    {"blue", COLOR_BLUE},     {"green", COLOR_GREEN},
+    {"cyan", COLOR_CYAN},     {"orange", COLOR_ORANGE},
+    {"violet", COLOR_VIOLET},
+};
+
+static PieceSet_t pieces_default;
+static pthread_once_t pieces_once = PTHREAD_ONCE_INIT;
+static const PieceSet_t *pieces_current;
+
+/**
+ * Compile the built-in set, run once per process.
+ */
+static void pieces_default_build() {
+  pieces_compile(&pieces_default, pieces_tetrominoes);
+}
+
+/**
+ * Return the set of the seven tetrominoes, compiled on the first call.
+ */
+const PieceSet_t *pieces_builtin() {
+  pthread_once(&pieces_once, pieces_default_build);
+  return &pieces_default;
+}
+
+/**
+ * Return the set new figures are made from.
+ */
+const PieceSet_t *pieces_active() {
+  return pieces_current != NULL ? pieces_current : pieces_builtin();
+}
+
+/**
+ * Make new figures from another set. The set is not copied and must not be
+ * switched while games are running on other threads.
+ * @param set Piece set, NULL - the built-in set.
+ */
+void pieces_use(const PieceSet_t *set) { pieces_current = set; }
+
+/**
+ * Return the leftmost and the rightmost occupied column of a view mask.
+ * @param mask Non-empty view mask.
+ * @param left Set to the left column.
+ * @param right Set to the right column.
+ */
+static void piece_columns(unsigned int mask, int *left, int *right) {
+  unsigned int columns = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++)
+    columns |= mask >> (i * FIGURE_SIZE) & FIGURE_ROW;
+  *left = __builtin_ctz(columns);
+  *right = 31 - __builtin_clz(columns);
+}
+
+/**
+ * Check a parsed piece and compile its tables: views a single drawing turns
+ * into, the turn order, the spawn figure and the wall kicks. A piece that
+ * never turns keeps the size of its cells as its box.
+ * @param piece Parsed piece.
+ * @return 1 - compiled, 0 - malformed piece.
+ */
+static int piece_finish(Piece_t *piece) {
+  PieceView *views = piece->views;
+  int res = 1;
+  for (int i = 0; i < piece->view_count; i++) res = res && views[i].mask != 0;
+  if (res && !piece->turns) {
+    int left = 0;
+    int right = 0;
+    piece_columns(views[0].mask, &left, &right);
+    views[0].rows =
+        (unsigned char)((31 - __builtin_clz(views[0].mask)) / FIGURE_SIZE -
+                        __builtin_ctz(views[0].mask) / FIGURE_SIZE + 1);
+    views[0].cols = (unsigned char)(right - left + 1);
+  } else if (res && piece->view_count == 1) {
+    res = views[0].rows == views[0].cols;
+    for (int i = 1; res && i < PIECE_VIEWS; i++) {
+      unsigned int mask =
+          pieces_turn(views[i - 1].mask, views[0].rows, views[0].cols);
+      if (mask == views[0].mask) break;
+      views[i] = views[0];
+      views[i].mask = mask;
+      piece->view_count++;
+    }
+  }
+  piece->kick_left = 1;
+  piece->kick_right = 1;
+  for (int i = 0; res && i < piece->view_count; i++) {
+    int from_left = 0;
+    int from_right = 0;
+    int to_left = 0;
+    int to_right = 0;
+    views[i].top = (unsigned char)(__builtin_ctz(views[i].mask) / FIGURE_SIZE);
+    views[i].next = (unsigned char)((i + 1) % piece->view_count);
+    piece_columns(views[i].mask, &from_left, &from_right);
+    piece_columns(views[views[i].next].mask, &to_left, &to_right);
+    if (from_left - to_left > piece->kick_left)
+      piece->kick_left = from_left - to_left;
+    if (to_right - from_right > piece->kick_right)
+      piece->kick_right = to_right - from_right;
+  }
+  if (res) {
+    Tetramino *spawn = &piece->spawn;
+    for (int i = 0; i < FIGURE_CELLS; i++)
+      spawn->view[i / FIGURE_SIZE][i % FIGURE_SIZE] =
+          views[0].mask >> i & 1 ? piece->color : 0;
+    spawn->x = WIDTH / 2 - 2;
+    spawn->y = -views[0].top;
+    spawn->type = piece->type;
+    spawn->rows = views[0].rows;
+    spawn->cols = views[0].cols;
+  }
+  return res;
+}
+
+/**
+ * Start a new piece of a "piece TYPE COLOR [fixed]" line.
+ * @param set Set to add the piece to.
+ * @param line Definition line.
+ * @return Added piece or NULL if the line is malformed or the set is full.
+ */
+static Piece_t *piece_begin(PieceSet_t *set, const char *line) {
+  char type = 0;
+  char color[16] = "";
+  char flag[16] = "";
+  int fields = sscanf(line, "piece %c %15s %15s", &type, color, flag);
+  Piece_t *piece = NULL;
+  if (fields >= 2 && set->count < PIECES_MAX && type > ' ' && type < 127 &&
+      set->kinds[(int)type] < 0 && (fields == 2 || strcmp(flag, "fixed") == 0))
+    piece = &set->pieces[set->count];
+  size_t colors = sizeof(piece_colors) / sizeof(piece_colors[0]);
+  for (size_t i = 0; piece != NULL && i < colors; i++) {
+    if (strcmp(color, piece_colors[i].name) == 0)
+      piece->color = piece_colors[i].color;
+  }
+  if (piece != NULL && piece->color != 0) {
+    piece->type = type;
+    piece->turns = fields == 2;
+    piece->view_count = 1;
+    set->kinds[(int)type] = (signed char)set->count++;
+  }
+  return piece != NULL && piece->color != 0 ? piece : NULL;
+}
+
+/**
+ * Compile piece definitions into a set: the header line, then for every piece
+ * a "piece TYPE COLOR" line and its view as rows of '.' - empty and '#' -
+ * filled, at most FIGURE_SIZE x FIGURE_SIZE. A piece with one view turns in its
+ * square box, "turn" lines separate views listed in turn order and a "fixed"
+ * piece never turns. Pieces spawn with their top row on the top of the field.
+ * @param set Set to fill.
+ * @param text Definitions.
+ * @return 1 - compiled, 0 - malformed definitions.
+ */
+int pieces_compile(PieceSet_t *set, const char *text) {
+  Piece_t *piece = NULL;
+  PieceView *view = NULL;
+  int res = strncmp(text, PIECES_MAGIC, strlen(PIECES_MAGIC)) == 0;
+  memset(set, 0, sizeof(*set));
+  memset(set->kinds, -1, sizeof(set->kinds));
+  text += strcspn(text, "\n");
+  while (res && *text != '\0') {
+    char line[64];
+    size_t len = strcspn(++text, "\n");
+    res = len < sizeof(line);
+    if (res) {
+      memcpy(line, text, len);
+      line[len] = '\0';
+      text += len;
+      len = strcspn(line, "\r");
+      line[len] = '\0';
+    }
+    if (!res || len == 0) {
+      continue;
+    } else if (strncmp(line, "piece ", 6) == 0) {
+      res = (piece == NULL || piece_finish(piece)) &&
+            (piece = piece_begin(set, line)) != NULL;
+      view = res ? &piece->views[0] : NULL;
+    } else if (strcmp(line, "turn") == 0) {
+      res = piece != NULL && piece->turns && view->rows > 0 &&
+            piece->view_count < PIECE_VIEWS;
+      view = res ? &piece->views[piece->view_count++] : NULL;
+    } else {
+      res = piece != NULL && strspn(line, ".#") == len &&
+            len <= FIGURE_SIZE && view->rows < FIGURE_SIZE &&
+            (view->rows == 0 || view->cols == len);
+      for (size_t j = 0; res && j < len; j++) {
+        if (line[j] == '#') view->mask |= 1u << (view->rows * FIGURE_SIZE + j);
+      }
+      if (res) view->cols = (unsigned char)len;
+      if (res) view->rows++;
+    }
+  }
+  return res && piece != NULL && piece_finish(piece);
+}
+
+/**
+ * Read piece definitions from a file and compile them.
+ * @param set Set to fill.
+ * @param path File path.
+ * @return 1 - loaded, 0 - file error or malformed definitions.
+ */
+int pieces_load(PieceSet_t *set, const char *path) {
+  FILE *file = fopen(path, "r");
+  char *text = malloc(PIECES_FILE_MAX);
+  int res = file != NULL && text != NULL;
+  if (res) {
+    size_t size = fread(text, 1, PIECES_FILE_MAX - 1, file);
+    text[size] = '\0';
+    res = size < PIECES_FILE_MAX - 1 && !ferror(file) &&
+          pieces_compile(set, text);
+  }
+  if (file != NULL) fclose(file);
+  free(text);
+  return res;
+}
+
+/**
+ * Find the piece of a figure type.
+ * @param set Piece set.
+ * @param type Figure type letter.
+ * @return Piece or NULL if the set has no such type.
+ */
+const Piece_t *pieces_find(const PieceSet_t *set, char type) {
+  int kind = type > 0 && type < 127 ? set->kinds[(int)type] : -1;
+  return kind >= 0 ? &set->pieces[kind] : NULL;
+}
+
+/**
+ * Return the number of a figure type in make_figure() order.
+ * @param set Piece set.
+ * @param type Figure type letter.
+ * @return Figure number, 0 for an unknown type.
+ */
+int pieces_kind(const PieceSet_t *set, char type) {
+  const Piece_t *piece = pieces_find(set, type);
+  return piece != NULL ? (int)(piece - set->pieces) : 0;
+}
+
+/**
+ * Find the view of a piece with the given cells.
+ * @param piece Piece.
+ * @param mask View mask, bit i * FIGURE_SIZE + j is view[i][j].
+ * @return View index or -1 if the piece has no such view.
+ */
+int pieces_view(const Piece_t *piece, unsigned int mask) {
+  int res = -1;
+  for (int i = 0; res < 0 && i < piece->view_count; i++) {
+    if (piece->views[i].mask == mask) res = i;
+  }
+  return res;
+}
+
+/**
+ * Turn the cells of a view clockwise inside its top left rows x cols box,
+ * cells outside the box stay.
+ * @param mask View mask, bit i * FIGURE_SIZE + j is view[i][j].
+ * @param rows Box rows.
+ * @param cols Box columns.
+ * @return Turned mask.
+ */
+unsigned int pieces_turn(unsigned int mask, int rows, int cols) {
+  unsigned int res = mask;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      unsigned int bit = 1u << (i * FIGURE_SIZE + j);
+      res = mask >> ((cols - 1 - j) * FIGURE_SIZE + i) & 1 ? res | bit
+                                                          : res & ~bit;
+    }
+  }
+  return res;
+}
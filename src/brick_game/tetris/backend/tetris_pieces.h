@@ -0,0 +1,55 @@
+#ifndef TETRIS_PIECES_H
+#define TETRIS_PIECES_H
+
+#include <pthread.h>
+#include <string.h>
+
+#include "tetris_backend.h"
+
+// piece set parameters
+#define PIECES_MAX 16
+#define PIECE_VIEWS 4
+#define PIECES_FILE_MAX 8192
+#define PIECES_MAGIC "tetris-pieces 1"
+
+// one rotation of a piece: view mask, bit i * FIGURE_SIZE + j is view[i][j],
+// the box it turns in, its top row and the index of the view it turns into
+typedef struct {
+  unsigned int mask;
+  unsigned char rows;
+  unsigned char cols;
+  unsigned char top;
+  unsigned char next;
+} PieceView;
+
+// piece compiled from its definition: views in turn order, the figure
+// make_figure() copies, spawn row and the wall kicks its turns need
+typedef struct {
+  char type;
+  int color;
+  int turns;
+  int view_count;
+  PieceView views[PIECE_VIEWS];
+  Tetramino spawn;
+  int kick_left;
+  int kick_right;
+} Piece_t;
+
+// pieces a game draws from, looked up by kind or by type letter
+typedef struct {
+  Piece_t pieces[PIECES_MAX];
+  int count;
+  signed char kinds[128];
+} PieceSet_t;
+
+const PieceSet_t *pieces_builtin();
+const PieceSet_t *pieces_active();
+void pieces_use(const PieceSet_t *set);
+int pieces_compile(PieceSet_t *set, const char *text);
+int pieces_load(PieceSet_t *set, const char *path);
+const Piece_t *pieces_find(const PieceSet_t *set, char type);
+int pieces_kind(const PieceSet_t *set, char type);
+int pieces_view(const Piece_t *piece, unsigned int mask);
+unsigned int pieces_turn(unsigned int mask, int rows, int cols);
+
+#endif
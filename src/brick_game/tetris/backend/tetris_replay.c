@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_replay.h"
+
+/**
+ * Init an empty closed recording.
+ * @param rec Recording to init.
+ */
+void recording_init(Recording_t *rec) {
+  memset(rec, 0, sizeof(*rec));
+}
+
+/**
+ * Release the events of a recording.
+ * @param rec Recording to free.
+ */
+void recording_free(Recording_t *rec) {
+  free(rec->events);
+  recording_init(rec);
+}
+
+/**
+ * Start recording a new game. Must be called before stats_init() starts the
+ * game, an unseeded game is seeded here so the figure sequence can be
+ * reproduced.
+ * @param rec Recording to start.
+ * @param game Game that is about to start.
+ */
+void recording_begin(Recording_t *rec, GameInfo_t *game) {
+  if (game->rng == 0) seed_game(game, rand());
+  rec->seed = game->rng;
+  rec->score = 0;
+  rec->lines = 0;
+  rec->level = LEVEL_MIN;
+  rec->ticks = 0;
+  rec->count = 0;
+  rec->open = 1;
+}
+
+/**
+ * Append an input event to the recording.
+ * @param rec Recording.
+ * @param tick Game tick the action was delivered at.
+ * @param action The user action.
+ */
+void recording_add(Recording_t *rec, long long tick, UserAction_t action) {
+  if (rec->count == rec->capacity) {
+    int capacity = rec->capacity ? rec->capacity * 2 : 256;
+    ReplayEvent *events = realloc(rec->events, capacity * sizeof(*events));
+    if (events != NULL) {
+      rec->events = events;
+      rec->capacity = capacity;
+    }
+  }
+  if (rec->count < rec->capacity) {
+    rec->events[rec->count].tick = tick;
+    rec->events[rec->count].action = action;
+    rec->count++;
+  }
+}
+
+/**
+ * Close the recording and store the game result it claims.
+ * @param rec Recording.
+ * @param game Finished game.
+ */
+void recording_finish(Recording_t *rec, const GameInfo_t *game) {
+  rec->score = game->score;
+  rec->lines = game->lines;
+  rec->level = game->level;
+  rec->ticks = game->ticks;
+  rec->open = 0;
+}
+
+/**
+ * Record a user action before it is passed to userInput(). Only actions the
+ * game consumes are kept, Start in GAMEOVER begins a new recording.
+ * @param rec Recording.
+ * @param game Main game structure.
+ * @param action The user action, -1 - no action.
+ */
+void record_action(Recording_t *rec, GameInfo_t *game, UserAction_t action) {
+  if ((int)action != -1) {
+    switch (game->state) {
+      case GAMEOVER:
+        if (action == Start) {
+          recording_begin(rec, game);
+          recording_add(rec, 0, Start);
+        }
+        break;
+      case START:
+      case MOVING:
+      case PAUSE:
+        if (rec->open) recording_add(rec, game->ticks, action);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**
+ * Save the recording once the game is over or terminated. Recordings of games
+ * that never spawned a figure or were rewound are dropped.
+ * @param rec Recording.
+ * @param game Main game structure.
+ * @param dir Directory to save recordings to, created if missing.
+ * @return 1 - the game has just finished, 0 - otherwise.
+ */
+int record_result(Recording_t *rec, const GameInfo_t *game, const char *dir) {
+  int finished = rec->open &&
+                 (game->state == GAMEOVER || game->state == EXIT_STATE);
+  if (finished) {
+    recording_finish(rec, game);
+    if (game->pieces > 0 && !rewind_used(game)) {
+      char path[REPLAY_PATH_MAX];
+      mkdir(dir, 0755);
+      snprintf(path, sizeof(path), "%s/%lld-%u%s", dir, get_time_us(),
+               rec->seed, REPLAY_EXT);
+      recording_save(rec, path);
+    }
+  }
+  return finished;
+}
+
+/**
+ * Write a recording as text: header, seed, claimed result and one
+ * "tick action" line per event.
+ * @param rec Recording.
+ * @param path File path.
+ * @return 1 - saved, 0 - file error.
+ */
+int recording_save(const Recording_t *rec, const char *path) {
+  FILE *file = fopen(path, "w");
+  int res = file != NULL;
+  if (res) {
+    fprintf(file, "%s\nseed %u\nresult %d %d %d %lld\nevents %d\n",
+            REPLAY_MAGIC, rec->seed, rec->score, rec->lines, rec->level,
+            rec->ticks, rec->count);
+    for (int i = 0; i < rec->count; i++)
+      fprintf(file, "%lld %d\n", rec->events[i].tick, rec->events[i].action);
+    res = fclose(file) == 0;
+  }
+  return res;
+}
+
+/**
+ * Read a recording written by recording_save().
+ * @param rec Initialized recording, its events are replaced.
+ * @param path File path.
+ * @return 1 - loaded, 0 - file error or malformed recording.
+ */
+int recording_load(Recording_t *rec, const char *path) {
+  FILE *file = fopen(path, "r");
+  char magic[32] = {0};
+  int count = 0;
+  int res = file != NULL;
+  if (res) {
+    res = fgets(magic, sizeof(magic), file) != NULL &&
+          strncmp(magic, REPLAY_MAGIC, strlen(REPLAY_MAGIC)) == 0 &&
+          fscanf(file, " seed %u result %d %d %d %lld events %d", &rec->seed,
+                 &rec->score, &rec->lines, &rec->level, &rec->ticks,
+                 &count) == 6 &&
+          count >= 0;
+    rec->count = 0;
+    rec->open = 0;
+    for (int i = 0; res && i < count; i++) {
+      long long tick = 0;
+      int action = 0;
+      res = fscanf(file, "%lld %d", &tick, &action) == 2;
+      if (res) recording_add(rec, tick, action);
+    }
+    res = res && rec->count == count;
+    fclose(file);
+  }
+  return res;
+}
+
+/**
+ * Re-simulate a recording headless: every event is delivered at the tick it
+ * was recorded at, then the game runs to the claimed final tick.
+ * @param rec Recording.
+ * @param result Result of the re-simulation.
+ * @return 1 - the claimed result matches, 0 - it does not or the events
+ * cannot be replayed.
+ */
+int replay_run(const Recording_t *rec, ReplayResult *result) {
+  GameInfo_t game = {0};
+  int valid = replay_play(rec, &game);
+  result->score = game.score;
+  result->lines = game.lines;
+  result->level = game.level;
+  result->ticks = game.ticks;
+  result->valid = valid && game.score == rec->score &&
+                  game.lines == rec->lines && game.level == rec->level &&
+                  game.ticks == rec->ticks;
+  return result->valid;
+}
+
+/**
+ * Play a recording headless on a game: every event is delivered at the tick
+ * it was recorded at, then the game runs to the claimed final tick.
+ * @param rec Recording.
+ * @param game Zeroed game to play on, attached analyzers are kept.
+ * @return 1 - every event was delivered, 0 - the events cannot be replayed.
+ */
+int replay_play(const Recording_t *rec, GameInfo_t *game) {
+  int valid = 1;
+  game->headless = 1;
+  seed_game(game, rec->seed);
+  GameInfo_t *prev = bind_game(game);
+  stats_init(game);
+  bind_game(prev);
+  for (int i = 0; valid && i < rec->count; i++) {
+    const ReplayEvent *event = &rec->events[i];
+    while (game->state == MOVING && game->ticks < event->tick) game_tick(game);
+    valid = game->ticks == event->tick && event->action >= Start &&
+            event->action <= Action &&
+            (game->state == START || game->state == MOVING ||
+             game->state == PAUSE);
+    if (valid) game_input(game, event->action);
+  }
+  while (valid && game->state == MOVING && game->ticks < rec->ticks)
+    game_tick(game);
+  return valid;
+}
+
+/**
+ * List the recordings of a directory.
+ * @param dir Directory with recordings.
+ * @param paths Set to the allocated paths, free() them after use.
+ * @return Number of recordings or -1 if the directory cannot be read.
+ */
+int replay_list(const char *dir, char (**paths)[REPLAY_PATH_MAX]) {
+  DIR *handle = opendir(dir);
+  int capacity = 0;
+  int count = -1;
+  *paths = NULL;
+  if (handle != NULL) {
+    size_t ext = strlen(REPLAY_EXT);
+    count = 0;
+    for (struct dirent *entry = readdir(handle); entry != NULL;
+         entry = readdir(handle)) {
+      size_t len = strlen(entry->d_name);
+      if (len > ext && strcmp(entry->d_name + len - ext, REPLAY_EXT) == 0) {
+        if (count == capacity) {
+          int grown = capacity ? capacity * 2 : 1024;
+          void *grown_paths = realloc(*paths, grown * REPLAY_PATH_MAX);
+          if (grown_paths != NULL) {
+            *paths = grown_paths;
+            capacity = grown;
+          }
+        }
+        if (count < capacity)
+          snprintf((*paths)[count++], REPLAY_PATH_MAX, "%s/%s", dir,
+                   entry->d_name);
+      }
+    }
+    closedir(handle);
+  }
+  return count;
+}
+
+/**
+ * Verify every recording of a directory on a pool of worker threads. A line
+ * is written for each recording as soon as it is checked.
+ * @param dir Directory with recordings.
+ * @param threads Number of worker threads.
+ * @param out Stream for the results.
+ * @param failed Set to the number of recordings that failed.
+ * @return Number of recordings checked or -1 if the directory cannot be read.
+ */
+int replay_verify_dir(const char *dir, int threads, FILE *out, int *failed) {
+  Verifier_t verifier = {0};
+  int res = replay_list(dir, &verifier.paths);
+  *failed = 0;
+  if (res >= 0) {
+    pthread_t workers[REPLAY_THREADS_MAX];
+    verifier.count = res;
+    atomic_init(&verifier.next, 0);
+    atomic_init(&verifier.passed, 0);
+    atomic_init(&verifier.failed, 0);
+    verifier.out = out;
+    pthread_mutex_init(&verifier.lock, NULL);
+    if (threads < 1) threads = 1;
+    if (threads > REPLAY_THREADS_MAX) threads = REPLAY_THREADS_MAX;
+    if (threads > verifier.count) threads = verifier.count;
+    int started = 0;
+    for (; started < threads; started++) {
+      if (pthread_create(&workers[started], NULL, replay_worker, &verifier))
+        break;
+    }
+    if (started == 0) replay_worker(&verifier);
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    pthread_mutex_destroy(&verifier.lock);
+    *failed = atomic_load(&verifier.failed);
+  }
+  free(verifier.paths);
+  return res;
+}
+
+/**
+ * Worker thread of replay_verify_dir().
+ * @param arg Verifier_t shared by the workers.
+ */
+void *replay_worker(void *arg) {
+  Verifier_t *verifier = arg;
+  Recording_t rec;
+  recording_init(&rec);
+  for (int i = atomic_fetch_add(&verifier->next, 1); i < verifier->count;
+       i = atomic_fetch_add(&verifier->next, 1)) {
+    ReplayResult result = {0};
+    int loaded = recording_load(&rec, verifier->paths[i]);
+    int valid = loaded && replay_run(&rec, &result);
+    atomic_fetch_add(valid ? &verifier->passed : &verifier->failed, 1);
+    pthread_mutex_lock(&verifier->lock);
+    if (!loaded) {
+      fprintf(verifier->out, "BAD  %s\n", verifier->paths[i]);
+    } else if (valid) {
+      fprintf(verifier->out, "OK   %s score %d lines %d level %d\n",
+              verifier->paths[i], result.score, result.lines, result.level);
+    } else {
+      fprintf(verifier->out,
+              "FAIL %s claimed %d/%d/%d/%lld replayed %d/%d/%d/%lld\n",
+              verifier->paths[i], rec.score, rec.lines, rec.level, rec.ticks,
+              result.score, result.lines, result.level, result.ticks);
+    }
+    fflush(verifier->out);
+    pthread_mutex_unlock(&verifier->lock);
+  }
+  recording_free(&rec);
+  return NULL;
+}
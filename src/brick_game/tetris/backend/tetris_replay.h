@@ -0,0 +1,75 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "tetris_backend.h"
+#include "tetris_rewind.h"
+
+// replay parameters
+#define REPLAY_DIR "replays"
+#define REPLAY_EXT ".replay"
+#define REPLAY_MAGIC "tetris-replay 2"
+#define REPLAY_PATH_MAX 512
+#define REPLAY_THREADS_MAX 64
+
+// user action delivered to the game at the given tick
+typedef struct {
+  long long tick;
+  int action;
+} ReplayEvent;
+
+// recorded game: generator seed, input events and the claimed result
+typedef struct {
+  unsigned int seed;
+  int score;
+  int lines;
+  int level;
+  long long ticks;
+  ReplayEvent *events;
+  int count;
+  int capacity;
+  int open;
+} Recording_t;
+
+// result of a re-simulated recording
+typedef struct {
+  int valid;
+  int score;
+  int lines;
+  int level;
+  long long ticks;
+} ReplayResult;
+
+// recordings shared between verifier threads
+typedef struct {
+  char (*paths)[REPLAY_PATH_MAX];
+  int count;
+  atomic_int next;
+  atomic_int passed;
+  atomic_int failed;
+  FILE *out;
+  pthread_mutex_t lock;
+} Verifier_t;
+
+void recording_init(Recording_t *rec);
+void recording_free(Recording_t *rec);
+void recording_begin(Recording_t *rec, GameInfo_t *game);
+void recording_add(Recording_t *rec, long long tick, UserAction_t action);
+void recording_finish(Recording_t *rec, const GameInfo_t *game);
+void record_action(Recording_t *rec, GameInfo_t *game, UserAction_t action);
+int record_result(Recording_t *rec, const GameInfo_t *game, const char *dir);
+int recording_save(const Recording_t *rec, const char *path);
+int recording_load(Recording_t *rec, const char *path);
+
+int replay_list(const char *dir, char (**paths)[REPLAY_PATH_MAX]);
+int replay_run(const Recording_t *rec, ReplayResult *result);
+int replay_play(const Recording_t *rec, GameInfo_t *game);
+int replay_verify_dir(const char *dir, int threads, FILE *out, int *failed);
+void *replay_worker(void *arg);
+
+#endif
@@ -0,0 +1,149 @@
+#include "tetris_rewind.h"
+
+/**
+ * Pack the game state before the next figure spawns. Only cell occupancy is
+ * kept, restored cells are drawn in one color.
+ * @param game Game waiting to spawn its next figure.
+ * @param snapshot Snapshot to fill.
+ */
+void snapshot_take(const GameInfo_t *game, Snapshot *snapshot) {
+  memset(snapshot->field, 0, sizeof(snapshot->field));
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      int bit = i * WIDTH + j;
+      if (game->field[i][j] != 0) snapshot->field[bit / 8] |= 1u << bit % 8;
+    }
+  }
+  snapshot->next = game->next.type;
+  snapshot->streak =
+      (unsigned char)(game->combo | (game->b2b ? REWIND_B2B : 0));
+  snapshot->cleared = (unsigned char)game->cleared;
+  snapshot->rng = game->rng;
+  snapshot->score = game->score;
+  snapshot->lines = game->lines;
+  snapshot->pieces = game->pieces;
+  snapshot->ticks = (unsigned int)game->ticks;
+}
+
+/**
+ * Put a game back into the state of a snapshot and spawn the figure it was
+ * taken before, the figure sequence goes on from the saved generator state.
+ * @param snapshot Snapshot.
+ * @param game Game to restore.
+ */
+void snapshot_restore(const Snapshot *snapshot, GameInfo_t *game) {
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      int bit = i * WIDTH + j;
+      game->field[i][j] =
+          snapshot->field[bit / 8] >> bit % 8 & 1 ? COLOR_GARBAGE : 0;
+    }
+  }
+  reset_figure(&game->next);
+  make_figure(&game->next, pieces_kind(pieces_active(), snapshot->next));
+  game->combo = snapshot->streak & ~REWIND_B2B;
+  game->b2b = (snapshot->streak & REWIND_B2B) != 0;
+  game->cleared = snapshot->cleared;
+  game->garbage = 0;
+  game->sent = 0;
+  game->rng = snapshot->rng;
+  game->score = snapshot->score;
+  game->lines = snapshot->lines;
+  game->pieces = snapshot->pieces;
+  game->ticks = snapshot->ticks;
+  game->lag = 0;
+  board_rebuild(&game->board, game->field);
+  GameInfo_t *prev = bind_game(game);
+  set_level();
+  spawn_state_actions(game);
+  bind_game(prev);
+}
+
+/**
+ * Allocate an empty rewind history.
+ * @return History or NULL if there is no memory, the game then plays on with
+ * rewinding disabled.
+ */
+Rewind_t *rewind_create() {
+  Rewind_t *rewind = malloc(sizeof(*rewind));
+  if (rewind != NULL) rewind_reset(rewind);
+  return rewind;
+}
+
+/**
+ * Drop the history, used when a new game starts.
+ * @param rewind Rewind history.
+ */
+void rewind_reset(Rewind_t *rewind) {
+  rewind->first = 0;
+  rewind->count = 0;
+  rewind->pos = -1;
+  rewind->used = 0;
+}
+
+/**
+ * Save the state of a game about to spawn a figure. Snapshots after the one
+ * the game was rewound to are dropped, the oldest one is overwritten once the
+ * ring is full.
+ * @param rewind Rewind history.
+ * @param game Game waiting to spawn its next figure.
+ */
+void rewind_push(Rewind_t *rewind, const GameInfo_t *game) {
+  rewind->count = rewind->pos + 1;
+  if (rewind->count == REWIND_STEPS) {
+    rewind->first = (rewind->first + 1) % REWIND_STEPS;
+    rewind->count--;
+  }
+  rewind->pos = rewind->count++;
+  snapshot_take(game, &rewind->steps[(rewind->first + rewind->pos) %
+                                     REWIND_STEPS]);
+}
+
+/**
+ * Restore the snapshot at a position of the history.
+ * @param rewind Rewind history.
+ * @param game Game to restore, its state is kept.
+ * @param pos Position, 0 is the oldest snapshot.
+ * @return 1 - restored, 0 - no snapshot at the position.
+ */
+static int rewind_to(Rewind_t *rewind, GameInfo_t *game, int pos) {
+  int res = pos >= 0 && pos < rewind->count;
+  if (res) {
+    GameState_t state = game->state;
+    rewind->pos = pos;
+    rewind->used = 1;
+    snapshot_restore(&rewind->steps[(rewind->first + pos) % REWIND_STEPS],
+                     game);
+    game->state = state;
+  }
+  return res;
+}
+
+/**
+ * Step back to the spawn of the previous figure.
+ * @param rewind Rewind history.
+ * @param game Paused game, it stays paused.
+ * @return 1 - restored, 0 - the history has no older state.
+ */
+int rewind_back(Rewind_t *rewind, GameInfo_t *game) {
+  return rewind_to(rewind, game, rewind->pos - 1);
+}
+
+/**
+ * Step forward again after rewinding, until a new figure is placed.
+ * @param rewind Rewind history.
+ * @param game Paused game, it stays paused.
+ * @return 1 - restored, 0 - the game is at its latest state.
+ */
+int rewind_forward(Rewind_t *rewind, GameInfo_t *game) {
+  return rewind_to(rewind, game, rewind->pos + 1);
+}
+
+/**
+ * Check if the game has been rewound. A rewound game is practice: it is not
+ * recorded and its score does not count as a high score.
+ * @param game Main game structure.
+ */
+int rewind_used(const GameInfo_t *game) {
+  return game->rewind != NULL && game->rewind->used;
+}
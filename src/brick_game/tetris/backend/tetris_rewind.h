@@ -0,0 +1,44 @@
+#ifndef TETRIS_REWIND_H
+#define TETRIS_REWIND_H
+
+#include "tetris_pieces.h"
+#include "tetris_session.h"
+
+// rewind history parameters
+#define REWIND_STEPS 4096
+#define REWIND_FIELD_BYTES ((HEIGHT * WIDTH + 7) / 8)
+#define REWIND_B2B 0x80
+
+// game state before a figure spawns, the field keeps one bit per cell; the
+// streak keeps the combo and the REWIND_B2B bit, the level follows the score
+typedef struct {
+  unsigned char field[REWIND_FIELD_BYTES];
+  char next;
+  unsigned char streak;
+  unsigned char cleared;
+  unsigned int rng;
+  int score;
+  int lines;
+  int pieces;
+  unsigned int ticks;
+} Snapshot;
+
+// ring of the latest snapshots and the one the game was rewound to
+typedef struct Rewind {
+  Snapshot steps[REWIND_STEPS];
+  int first;
+  int count;
+  int pos;
+  int used;
+} Rewind_t;
+
+Rewind_t *rewind_create();
+void rewind_reset(Rewind_t *rewind);
+void rewind_push(Rewind_t *rewind, const GameInfo_t *game);
+int rewind_back(Rewind_t *rewind, GameInfo_t *game);
+int rewind_forward(Rewind_t *rewind, GameInfo_t *game);
+int rewind_used(const GameInfo_t *game);
+void snapshot_take(const GameInfo_t *game, Snapshot *snapshot);
+void snapshot_restore(const Snapshot *snapshot, GameInfo_t *game);
+
+#endif
@@ -0,0 +1,199 @@
+#include "tetris_rollout.h"
+
+/**
+ * Evaluate every placement of the current figure with seeded random playouts
+ * run on worker threads. Each candidate gets at least one playout, further
+ * rounds run until every candidate has the given number of playouts or the
+ * time budget runs out. The best candidate survives the most playouts, ties
+ * are broken by the expected number of lines.
+ * @param game Game with the figure to place, left unchanged.
+ * @param seed Seed of the playout generator streams.
+ * @param threads Number of worker threads.
+ * @param budget_us Time budget in microseconds.
+ * @param playouts Playouts per candidate, ROLLOUT_PLAYOUTS if 0 or less.
+ * @param result Result to fill.
+ * @return Index of the best candidate or -1 if the figure cannot be placed.
+ */
+int rollout_evaluate(const GameInfo_t *game, unsigned int seed, int threads,
+                     long long budget_us, int playouts, RolloutResult *result) {
+  Rollout_t rollout;
+  pthread_t ids[ROLLOUT_THREADS_MAX];
+  GameInfo_t root = *game;
+  Placement *placements = malloc(PLACEMENTS_MAX * sizeof(*placements));
+  MoveGen_t *gen = malloc(sizeof(*gen));
+  if (threads < 1) threads = 1;
+  if (threads > ROLLOUT_THREADS_MAX) threads = ROLLOUT_THREADS_MAX;
+  RolloutWorker_t *workers = calloc(threads, sizeof(*workers));
+  memset(result, 0, sizeof(*result));
+  result->best = -1;
+  root.rewind = NULL;
+  root.finesse = NULL;
+  if (placements != NULL && gen != NULL && workers != NULL)
+    result->count = generate_placements(gen, &root, placements);
+  for (int i = 0; i < result->count; i++)
+    result->candidates[i].placement = placements[i];
+  rollout.game = &root;
+  rollout.result = result;
+  rollout.seed = seed;
+  rollout.total = (long long)result->count *
+                  (playouts > 0 ? playouts : ROLLOUT_PLAYOUTS);
+  rollout.deadline = get_time_us() + budget_us;
+  atomic_init(&rollout.next, 0);
+  pthread_mutex_init(&rollout.lock, NULL);
+  int started = 0;
+  for (; result->count > 0 && started < threads; started++) {
+    workers[started].rollout = &rollout;
+    if (pthread_create(&ids[started], NULL, rollout_worker, &workers[started]))
+      break;
+  }
+  if (result->count > 0 && started == 0) {
+    workers[0].rollout = &rollout;
+    rollout_worker(&workers[0]);
+  }
+  for (int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+  pthread_mutex_destroy(&rollout.lock);
+  for (int i = 0; i < result->count; i++) {
+    const RolloutCandidate *candidate = &result->candidates[i];
+    result->playouts += candidate->playouts;
+    if (result->best < 0 ||
+        rollout_better(candidate, &result->candidates[result->best]))
+      result->best = i;
+  }
+  free(workers);
+  free(gen);
+  free(placements);
+  return result->best;
+}
+
+/**
+ * Worker thread of rollout_evaluate(): takes playouts with an atomic counter
+ * until all are played or the deadline passes, then adds its totals to the
+ * result.
+ * @param arg RolloutWorker_t of the thread.
+ */
+void *rollout_worker(void *arg) {
+  RolloutWorker_t *worker = arg;
+  Rollout_t *rollout = worker->rollout;
+  RolloutResult *result = rollout->result;
+  for (long long i = atomic_fetch_add(&rollout->next, 1);
+       i < rollout->total &&
+       (i < result->count || get_time_us() < rollout->deadline);
+       i = atomic_fetch_add(&rollout->next, 1)) {
+    int candidate = (int)(i % result->count);
+    int lines = 0;
+    worker->rng = rollout_stream(rollout->seed, i);
+    worker->survived[candidate] +=
+        rollout_play(rollout->game, &result->candidates[candidate].placement,
+                     &worker->rng, &lines);
+    worker->lines[candidate] += lines;
+    worker->playouts[candidate]++;
+  }
+  pthread_mutex_lock(&rollout->lock);
+  for (int i = 0; i < result->count; i++) {
+    result->candidates[i].playouts += worker->playouts[i];
+    result->candidates[i].survived += worker->survived[i];
+    result->candidates[i].lines += worker->lines[i];
+  }
+  pthread_mutex_unlock(&rollout->lock);
+  return NULL;
+}
+
+/**
+ * Play one candidate placement and then ROLLOUT_DEPTH - 1 figures with the
+ * default policy on a copy of the game, with figures drawn from the playout
+ * generator.
+ * @param game Game with the figure to place.
+ * @param placement Candidate placement of the current figure.
+ * @param rng Playout generator state.
+ * @param lines Set to the number of lines cleared in the playout.
+ * @return 1 - every figure was placed, 0 - the game was lost.
+ */
+int rollout_play(const GameInfo_t *game, const Placement *placement,
+                 unsigned int *rng, int *lines) {
+  GameInfo_t playout = *game;
+  playout.rng = next_random(rng);
+  int alive = placement_apply(&playout, placement);
+  for (int i = 1; alive && i < ROLLOUT_DEPTH; i++)
+    alive = rollout_policy(&playout, rng);
+  *lines = playout.lines - game->lines;
+  return alive;
+}
+
+/**
+ * Default playout policy: drop the current figure at ROLLOUT_SAMPLES random
+ * rotations and columns, keep the one the bot evaluation likes best and
+ * spawn the next figure.
+ * @param game Game to play.
+ * @param rng Playout generator state.
+ * @return 1 - the next figure fits, 0 - the game is over.
+ */
+int rollout_policy(GameInfo_t *game, unsigned int *rng) {
+  GameInfo_t trial;
+  GameInfo_t best = *game;
+  double best_score = 0;
+  int best_lines = -1;
+  GameInfo_t *prev = bind_game(&trial);
+  for (int i = 0; i < ROLLOUT_SAMPLES; i++) {
+    unsigned int pick = next_random(rng);
+    int from = 0;
+    trial = *game;
+    int lines = bot_try(&trial, pick % 4, (int)(pick / 4 % (WIDTH + 2)) - 2,
+                        &from);
+    double score = lines >= 0 ? bot_evaluate(&trial, lines) : 0;
+    if (lines >= 0 && (best_lines < 0 || score > best_score)) {
+      best = trial;
+      best_score = score;
+      best_lines = lines;
+    }
+  }
+  int fits = best_lines >= 0;
+  if (fits) {
+    *game = best;
+    bind_game(game);
+    game->lines += best_lines;
+    spawn_figure();
+    game->pieces++;
+    fits = !figure_overlay();
+  }
+  bind_game(prev);
+  return fits;
+}
+
+/**
+ * Return the generator state of a playout, mixed from the seed and the
+ * playout index so results do not depend on the thread that runs it.
+ * @param seed Evaluation seed.
+ * @param playout Playout index.
+ * @return Non-zero xorshift32 state.
+ */
+unsigned int rollout_stream(unsigned int seed, long long playout) {
+  unsigned long long x = (unsigned long long)playout * 0x9E3779B97F4A7C15ULL;
+  x += seed;
+  x = (x ^ x >> 30) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ x >> 27) * 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return (unsigned int)x != 0 ? (unsigned int)x : 1;
+}
+
+/**
+ * Return the time a figure takes to fall one row at the game speed, the
+ * budget to decide on a placement without falling behind gravity.
+ * @param game Main game structure.
+ * @return Budget in microseconds.
+ */
+long long rollout_budget(const GameInfo_t *game) { return game->speed; }
+
+/**
+ * Compare the playout statistics of two candidates.
+ * @param a Candidate.
+ * @param b Candidate.
+ * @return 1 - a survives more often or as often with more lines, 0 -
+ * otherwise. Candidates without playouts are never better.
+ */
+int rollout_better(const RolloutCandidate *a, const RolloutCandidate *b) {
+  long long survival = (long long)a->survived * b->playouts -
+                       (long long)b->survived * a->playouts;
+  long long lines = a->lines * b->playouts - b->lines * a->playouts;
+  return a->playouts > 0 &&
+         (b->playouts == 0 || survival > 0 || (survival == 0 && lines > 0));
+}
@@ -0,0 +1,63 @@
+#ifndef TETRIS_ROLLOUT_H
+#define TETRIS_ROLLOUT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "tetris_bot.h"
+#include "tetris_movegen.h"
+
+// rollout parameters
+#define ROLLOUT_DEPTH 8
+#define ROLLOUT_SAMPLES 4
+#define ROLLOUT_PLAYOUTS 256
+#define ROLLOUT_THREADS_MAX 64
+
+// playout statistics of one candidate placement of the current figure
+typedef struct {
+  Placement placement;
+  int playouts;
+  int survived;
+  long long lines;
+} RolloutCandidate;
+
+// candidates of an evaluation and the index of the best one
+typedef struct {
+  RolloutCandidate candidates[PLACEMENTS_MAX];
+  int count;
+  int best;
+  long long playouts;
+} RolloutResult;
+
+// evaluation shared between worker threads, playout i plays candidate
+// i % count with a generator stream derived from the seed and i
+typedef struct {
+  const GameInfo_t *game;
+  RolloutResult *result;
+  unsigned int seed;
+  long long total;
+  long long deadline;
+  atomic_llong next;
+  pthread_mutex_t lock;
+} Rollout_t;
+
+// playout totals of one thread, merged when the thread is done
+typedef struct {
+  Rollout_t *rollout;
+  unsigned int rng;
+  int playouts[PLACEMENTS_MAX];
+  int survived[PLACEMENTS_MAX];
+  long long lines[PLACEMENTS_MAX];
+} RolloutWorker_t;
+
+int rollout_evaluate(const GameInfo_t *game, unsigned int seed, int threads,
+                     long long budget_us, int playouts, RolloutResult *result);
+void *rollout_worker(void *arg);
+int rollout_play(const GameInfo_t *game, const Placement *placement,
+                 unsigned int *rng, int *lines);
+int rollout_policy(GameInfo_t *game, unsigned int *rng);
+unsigned int rollout_stream(unsigned int seed, long long playout);
+long long rollout_budget(const GameInfo_t *game);
+int rollout_better(const RolloutCandidate *a, const RolloutCandidate *b);
+
+#endif
@@ -0,0 +1,92 @@
+#include "tetris_score.h"
+#include "tetris_backend.h"
+
+#define CORNER_COUNT(c) \
+  (((c) & 1) + ((c) >> 1 & 1) + ((c) >> 2 & 1) + ((c) >> 3 & 1))
+#define SPIN(c, front)                                   \
+  (CORNER_COUNT(c) < 3           ? SPIN_NONE               \
+   : ((c) & (front)) == (front) ? SPIN_FULL : SPIN_MINI)
+#define SPIN_ROW(front)                                                 \
+  {SPIN(0, front),  SPIN(1, front),  SPIN(2, front),  SPIN(3, front),   \
+   SPIN(4, front),  SPIN(5, front),  SPIN(6, front),  SPIN(7, front),   \
+   SPIN(8, front),  SPIN(9, front),  SPIN(10, front), SPIN(11, front),  \
+   SPIN(12, front), SPIN(13, front), SPIN(14, front), SPIN(15, front)}
+
+// spin kind by the side the T points to (up, right, down, left) and the
+// occupied corners: three corners make a spin, a full one when both corners
+// the T points to are among them
+static const unsigned char spin_table[4][16] = {
+    SPIN_ROW(CORNER_TOP_LEFT | CORNER_TOP_RIGHT),
+    SPIN_ROW(CORNER_TOP_RIGHT | CORNER_BOTTOM_RIGHT),
+    SPIN_ROW(CORNER_BOTTOM_LEFT | CORNER_BOTTOM_RIGHT),
+    SPIN_ROW(CORNER_TOP_LEFT | CORNER_BOTTOM_LEFT)};
+
+// points by spin kind and lines cleared at once
+static const int clear_points[3][5] = {{0, 100, 300, 700, 1500},
+                                       {100, 200, 400, 400, 400},
+                                       {400, 800, 1200, 1600, 1600}};
+
+/**
+ * Classify a T figure locked right after a rotation.
+ * @param mask T figure view, bit i * FIGURE_SIZE + j is view[i][j].
+ * @param corners Occupied corners of its 3x3 box, walls and the floor count
+ * as occupied.
+ * @return SPIN_NONE, SPIN_MINI or SPIN_FULL.
+ */
+int spin_kind(unsigned int mask, unsigned int corners) {
+  int side = 3;
+  if (!(mask >> (2 * FIGURE_SIZE + 1) & 1))
+    side = 0;
+  else if (!(mask >> FIGURE_SIZE & 1))
+    side = 1;
+  else if (!(mask >> 1 & 1))
+    side = 2;
+  return spin_table[side][corners & 0xF];
+}
+
+/**
+ * Score a locked figure. Four or more lines and spins that clear lines are
+ * difficult clears, five lines score as four. A difficult clear right after
+ * another one gets half its points on top. Every clearing figure in a row
+ * after the first adds COMBO_BONUS per figure before it, a figure that clears
+ * nothing ends the combo.
+ * @param lines Lines cleared by the figure.
+ * @param spin Spin kind of the figure.
+ * @param combo Clearing figures in a row before this one, updated.
+ * @param b2b 1 - the last clear was difficult, updated.
+ * @return Points scored.
+ */
+int score_lock(int lines, int spin, int *combo, int *b2b) {
+  int res = clear_points[spin][lines > 4 ? 4 : lines];
+  if (lines > 0) {
+    int difficult = lines >= 4 || spin != SPIN_NONE;
+    if (difficult && *b2b) res += res / 2;
+    res += COMBO_BONUS * *combo;
+    *b2b = difficult;
+    (*combo)++;
+  } else {
+    *combo = 0;
+  }
+  return res;
+}
+
+/**
+ * Return the number of garbage rows sent for cleared lines.
+ * @param lines Number of lines cleared at once.
+ */
+int garbage_rows(int lines) {
+  int rows = 0;
+  switch (lines) {
+    case 2:
+      rows = 1;
+      break;
+    case 3:
+      rows = 2;
+      break;
+    case 4:
+    case 5:
+      rows = 4;
+      break;
+  }
+  return rows;
+}
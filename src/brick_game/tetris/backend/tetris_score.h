@@ -0,0 +1,22 @@
+#ifndef TETRIS_SCORE_H
+#define TETRIS_SCORE_H
+
+// spin kinds of a locked T figure
+#define SPIN_NONE 0
+#define SPIN_MINI 1
+#define SPIN_FULL 2
+
+// corners of the 3x3 box around the T center, one bit each
+#define CORNER_TOP_LEFT 1
+#define CORNER_TOP_RIGHT 2
+#define CORNER_BOTTOM_LEFT 4
+#define CORNER_BOTTOM_RIGHT 8
+
+// points per clearing figure in a row, counted from the second one
+#define COMBO_BONUS 50
+
+int spin_kind(unsigned int mask, unsigned int corners);
+int score_lock(int lines, int spin, int *combo, int *b2b);
+int garbage_rows(int lines);
+
+#endif
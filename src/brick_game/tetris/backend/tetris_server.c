@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_server.h"
+
+#include <errno.h>
+
+static const char *state_names[] = {"start",    "spawn",     "moving",
+                                    "shifting", "attaching", "gameover",
+                                    "pause",    "exit"};
+
+static char *put_str(char *out, const char *str) {
+  while (*str) *out++ = *str++;
+  return out;
+}
+
+static char *put_int(char *out, long long value) {
+  char digits[24];
+  int count = 0;
+  unsigned long long rest = value;
+  if (value < 0) rest = -rest;
+  if (value < 0) *out++ = '-';
+  do {
+    digits[count++] = '0' + rest % 10;
+    rest /= 10;
+  } while (rest);
+  while (count) *out++ = digits[--count];
+  return out;
+}
+
+static char *put_hex(char *out, unsigned int value, int digits) {
+  for (int i = digits - 1; i >= 0; i--)
+    *out++ = "0123456789abcdef"[value >> (i * 4) & 0xf];
+  return out;
+}
+
+/**
+ * Write a figure as type:x:y:mask, the mask is the packed view.
+ */
+static char *put_packed(char *out, const PackedFigure *packed) {
+  *out++ = packed->type ? packed->type : '-';
+  *out++ = ':';
+  out = put_int(out, packed->x);
+  *out++ = ':';
+  out = put_int(out, packed->y);
+  *out++ = ':';
+  return put_hex(out, packed->mask, (FIGURE_CELLS + 3) / 4);
+}
+
+static char *put_figure(char *out, const Tetramino *figure) {
+  PackedFigure packed;
+  pack_figure(figure, &packed);
+  return put_packed(out, &packed);
+}
+
+/**
+ * Take the next space separated word of a request.
+ * @param pos Parse position, moved past the word.
+ * @param end End of the request.
+ * @param len Set to the word length.
+ * @return Start of the word.
+ */
+static const char *next_word(const char **pos, const char *end, int *len) {
+  const char *word = *pos;
+  while (word < end && *word == ' ') word++;
+  const char *stop = word;
+  while (stop < end && *stop != ' ') stop++;
+  *len = (int)(stop - word);
+  *pos = stop;
+  return word;
+}
+
+static int word_is(const char *word, int len, const char *name) {
+  return (int)strlen(name) == len && memcmp(word, name, len) == 0;
+}
+
+/**
+ * Parse an unsigned decimal number.
+ * @return 1 - parsed, 0 - not a number or too large.
+ */
+static int parse_number(const char *word, int len, unsigned long long max,
+                        unsigned long long *value) {
+  int res = len > 0 && len <= 20;
+  *value = 0;
+  for (int i = 0; res && i < len; i++) {
+    res = word[i] >= '0' && word[i] <= '9' &&
+          *value <= (max - (word[i] - '0')) / 10;
+    if (res) *value = *value * 10 + (word[i] - '0');
+  }
+  return res;
+}
+
+/**
+ * Convert a protocol action letter, '.' is a tick without input.
+ * @return The user action, -1 - tick, -2 - unknown letter.
+ */
+static int letter_action(char letter) {
+  int res = -2;
+  switch (letter) {
+    case 's':
+      res = Start;
+      break;
+    case 'p':
+      res = Pause;
+      break;
+    case 'q':
+      res = Terminate;
+      break;
+    case 'l':
+      res = Left;
+      break;
+    case 'r':
+      res = Right;
+      break;
+    case 'u':
+      res = Up;
+      break;
+    case 'd':
+      res = Down;
+      break;
+    case 'a':
+      res = Action;
+      break;
+    case '.':
+      res = -1;
+      break;
+  }
+  return res;
+}
+
+/**
+ * Start a new headless game with the given seed and deliver Start to it.
+ */
+static void server_start(Server_t *server, unsigned int seed) {
+  GameInfo_t *game = &server->game;
+  memset(game, 0, sizeof(*game));
+  game->headless = 1;
+  game->metrics = 1;
+  seed_game(game, seed);
+  server->seed = seed;
+  GameInfo_t *prev = bind_game(game);
+  stats_init(game);
+  bind_game(prev);
+  game_input(game, Start);
+}
+
+/**
+ * Write the short game summary: state, ticks, score and lines.
+ */
+static char *put_summary(char *out, const GameInfo_t *game) {
+  out = put_str(out, "ok ");
+  out = put_str(out, state_names[game->state]);
+  *out++ = ' ';
+  out = put_int(out, game->ticks);
+  *out++ = ' ';
+  out = put_int(out, game->score);
+  *out++ = ' ';
+  return put_int(out, game->lines);
+}
+
+/**
+ * Write the full game state: summary, level, current and next figures and the
+ * field as one 3-digit hex row mask per row, top row first, bit i is column i.
+ */
+static char *put_state(char *out, const GameInfo_t *game) {
+  out = put_str(out, "state ");
+  out = put_str(out, state_names[game->state]);
+  *out++ = ' ';
+  out = put_int(out, game->ticks);
+  *out++ = ' ';
+  out = put_int(out, game->score);
+  *out++ = ' ';
+  out = put_int(out, game->lines);
+  *out++ = ' ';
+  out = put_int(out, game->level);
+  *out++ = ' ';
+  out = put_figure(out, &game->current);
+  *out++ = ' ';
+  out = put_figure(out, &game->next);
+  *out++ = ' ';
+  for (int i = 0; i < HEIGHT; i++) {
+    unsigned int row = 0;
+    for (int j = 0; j < WIDTH; j++) row |= (game->field[i][j] != 0) << j;
+    out = put_hex(out, row, 3);
+  }
+  return out;
+}
+
+/**
+ * Apply a batch of action letters in order, actions reach the game only while
+ * it waits for input.
+ * @return 1 - applied, 0 - unknown letter, nothing is applied.
+ */
+static int server_act(Server_t *server, const char *letters, int len) {
+  int res = 1;
+  for (int i = 0; res && i < len; i++) res = letter_action(letters[i]) != -2;
+  for (int i = 0; res && i < len; i++) {
+    int action = letter_action(letters[i]);
+    GameState_t state = server->game.state;
+    if (action == -1)
+      game_tick(&server->game);
+    else if (state == START || state == MOVING || state == PAUSE)
+      game_input(&server->game, action);
+  }
+  return res;
+}
+
+/**
+ * Solve the field of the game for its next pieces, the figure in play counts
+ * as the first one.
+ * @param count Number of pieces, SERVER_SOLVE_MAX at most.
+ * @param lines Lines to clear, 0 for a perfect clear.
+ */
+static char *server_solve(char *out, const GameInfo_t *game, int count,
+                          int lines) {
+  Puzzle_t puzzle;
+  Solution_t solution;
+  puzzle_capture(&puzzle, game, count, lines);
+  if (solve_puzzle(&puzzle, 1, &solution) && solution.found) {
+    out = put_str(out, "ok ");
+    out = put_int(out, solution.length);
+    for (int i = 0; i < solution.length; i++) {
+      *out++ = ' ';
+      out = put_packed(out, &solution.placements[i].figure);
+    }
+  } else {
+    out = put_str(out, "none");
+  }
+  return out;
+}
+
+/**
+ * Init the server with a game started from seed 1.
+ * @param server Server to init.
+ */
+void server_init(Server_t *server) {
+  server->quit = 0;
+  server->skip = 0;
+  server->in_len = 0;
+  server->out_len = 0;
+  server_start(server, 1);
+}
+
+/**
+ * Handle one request line and write its one line reply.
+ *
+ * Requests:
+ * start [SEED] - new game, replies "ok";
+ * reset - new game with the seed of the last start, replies "ok";
+ * act LETTERS - actions s, p, q, l, r, u, d, a and '.' for a tick, replies
+ * "ok STATE TICKS SCORE LINES";
+ * tick N - up to N ticks while the figure is moving, same reply as act;
+ * state - replies "state STATE TICKS SCORE LINES LEVEL CURRENT NEXT FIELD";
+ * solve N [LINES] - shortest placements of the next N pieces that clear the
+ * field or LINES lines, replies "ok LENGTH FIGURE..." or "none";
+ * quit - replies "bye" and stops the server.
+ * Errors are replied as "err MESSAGE".
+ * @param server Server.
+ * @param line Request without the line end.
+ * @param len Request length.
+ * @param reply Buffer of SERVER_REPLY_MAX bytes.
+ * @return Reply length including the line end.
+ */
+int server_request(Server_t *server, const char *line, int len, char *reply) {
+  const char *end = line + len;
+  const char *pos = line;
+  char *out = reply;
+  int word_len = 0;
+  int arg_len = 0;
+  unsigned long long value = 0;
+  if (end > line && end[-1] == '\r') end--;
+  const char *word = next_word(&pos, end, &word_len);
+  const char *arg = next_word(&pos, end, &arg_len);
+  if (word_is(word, word_len, "act")) {
+    if (server_act(server, arg, arg_len))
+      out = put_summary(out, &server->game);
+    else
+      out = put_str(out, "err unknown action");
+  } else if (word_is(word, word_len, "tick")) {
+    if (parse_number(arg, arg_len, SERVER_TICKS_MAX, &value)) {
+      for (; value > 0 && server->game.state == MOVING; value--)
+        game_tick(&server->game);
+      out = put_summary(out, &server->game);
+    } else {
+      out = put_str(out, "err bad tick count");
+    }
+  } else if (word_is(word, word_len, "state")) {
+    out = put_state(out, &server->game);
+  } else if (word_is(word, word_len, "solve")) {
+    int lines_len = 0;
+    unsigned long long lines = 0;
+    const char *lines_arg = next_word(&pos, end, &lines_len);
+    if (server->game.state != MOVING)
+      out = put_str(out, "err no figure in play");
+    else if (parse_number(arg, arg_len, SERVER_SOLVE_MAX, &value) &&
+             value > 0 &&
+             (lines_len == 0 ||
+              parse_number(lines_arg, lines_len, HEIGHT, &lines)))
+      out = server_solve(out, &server->game, (int)value, (int)lines);
+    else
+      out = put_str(out, "err bad solve arguments");
+  } else if (word_is(word, word_len, "start")) {
+    if (arg_len == 0 || parse_number(arg, arg_len, 0xffffffffu, &value)) {
+      server_start(server, arg_len ? (unsigned int)value : server->seed + 1);
+      out = put_str(out, "ok");
+    } else {
+      out = put_str(out, "err bad seed");
+    }
+  } else if (word_is(word, word_len, "reset")) {
+    server_start(server, server->seed);
+    out = put_str(out, "ok");
+  } else if (word_is(word, word_len, "quit")) {
+    server->quit = 1;
+    out = put_str(out, "bye");
+  } else {
+    out = put_str(out, "err unknown request");
+  }
+  *out++ = '\n';
+  return (int)(out - reply);
+}
+
+/**
+ * Write the buffered replies.
+ * @return 1 - written, 0 - output error.
+ */
+static int server_flush(Server_t *server, int out_fd) {
+  int res = 1;
+  for (int done = 0; res && done < server->out_len;) {
+    ssize_t n = write(out_fd, server->out + done, server->out_len - done);
+    if (n > 0) done += n;
+    res = n > 0 || (n < 0 && errno == EINTR);
+  }
+  server->out_len = 0;
+  return res;
+}
+
+/**
+ * Serve requests from a stream until it ends or quit is requested. Every
+ * complete line read at once is handled before the replies are written with
+ * a single write, so pipelined requests cost one system call per batch.
+ * @param server Initialized server.
+ * @param in_fd Request stream.
+ * @param out_fd Reply stream.
+ * @return 1 - input ended or quit, 0 - I/O error.
+ */
+int server_run(Server_t *server, int in_fd, int out_fd) {
+  int res = 1;
+  int ended = 0;
+  while (res && !ended && !server->quit) {
+    ssize_t n = read(in_fd, server->in + server->in_len,
+                     SERVER_BUFFER - server->in_len);
+    ended = n == 0;
+    res = n >= 0 || errno == EINTR;
+    if (n > 0) server->in_len += n;
+    int start = 0;
+    if (server->skip) {
+      char *stop = memchr(server->in, '\n', server->in_len);
+      start = stop != NULL ? (int)(stop - server->in) + 1 : server->in_len;
+      server->skip = stop == NULL;
+    }
+    for (char *stop = memchr(server->in + start, '\n', server->in_len - start);
+         stop != NULL && !server->quit;
+         stop = memchr(server->in + start, '\n', server->in_len - start)) {
+      if (server->out_len + SERVER_REPLY_MAX > SERVER_BUFFER)
+        res = server_flush(server, out_fd) && res;
+      int len = (int)(stop - server->in) - start;
+      server->out_len += server_request(server, server->in + start, len,
+                                        server->out + server->out_len);
+      start += len + 1;
+    }
+    if ((ended && start < server->in_len) ||
+        (start == 0 && server->in_len == SERVER_BUFFER)) {
+      if (server->out_len + SERVER_REPLY_MAX > SERVER_BUFFER)
+        res = server_flush(server, out_fd) && res;
+      if (ended)
+        server->out_len += server_request(server, server->in + start,
+                                          server->in_len - start,
+                                          server->out + server->out_len);
+      else
+        server->out_len += (int)(put_str(server->out + server->out_len,
+                                         "err request too long\n") -
+                                 (server->out + server->out_len));
+      server->skip = !ended;
+      start = server->in_len;
+    }
+    memmove(server->in, server->in + start, server->in_len - start);
+    server->in_len -= start;
+    res = server_flush(server, out_fd) && res;
+  }
+  return res;
+}
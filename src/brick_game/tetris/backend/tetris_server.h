@@ -0,0 +1,32 @@
+#ifndef TETRIS_SERVER_H
+#define TETRIS_SERVER_H
+
+#include <string.h>
+#include <unistd.h>
+
+#include "tetris_session.h"
+#include "tetris_solver.h"
+
+// bot protocol buffers, a request line must fit into the input buffer
+#define SERVER_BUFFER 65536
+#define SERVER_REPLY_MAX 256
+#define SERVER_TICKS_MAX 1000000
+#define SERVER_SOLVE_MAX 10
+
+// headless game driven by line requests, no allocation after init
+typedef struct {
+  GameInfo_t game;
+  unsigned int seed;
+  int quit;
+  int skip;
+  int in_len;
+  int out_len;
+  char in[SERVER_BUFFER];
+  char out[SERVER_BUFFER];
+} Server_t;
+
+void server_init(Server_t *server);
+int server_request(Server_t *server, const char *line, int len, char *reply);
+int server_run(Server_t *server, int in_fd, int out_fd);
+
+#endif
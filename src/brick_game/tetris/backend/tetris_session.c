@@ -0,0 +1,254 @@
+#include "tetris_session.h"
+
+/**
+ * Init an empty session pool and prepare the blank session every new or
+ * reset session is copied from. Sessions draw their figures from the piece
+ * set active when the pool is made.
+ * @param pool Session pool.
+ */
+void pool_init(SessionPool *pool) {
+  GameInfo_t game = {0};
+  pool->slabs = NULL;
+  pool->slab_count = 0;
+  pool->slab_capacity = 0;
+  pool->free_list = NULL;
+  pool->live = 0;
+  pool->kinds = pieces_active()->count;
+  for (int i = 0; i < pool->kinds; i++) {
+    Tetramino figure = {0};
+    make_figure(&figure, i);
+    pack_figure(&figure, &pool->spawn[i]);
+  }
+  game.headless = 1;
+  game.metrics = 1;
+  seed_game(&game, 1);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  memset(&pool->blank, 0, sizeof(pool->blank));
+  session_store(&game, &pool->blank);
+}
+
+/**
+ * Release every slab of the pool, all sessions become invalid.
+ * @param pool Session pool.
+ */
+void pool_free(SessionPool *pool) {
+  for (int i = 0; i < pool->slab_count; i++) free(pool->slabs[i]);
+  free(pool->slabs);
+  pool->slabs = NULL;
+  pool->slab_count = 0;
+  pool->slab_capacity = 0;
+  pool->free_list = NULL;
+  pool->live = 0;
+}
+
+/**
+ * Allocate one more slab and put its sessions on the free list.
+ * @return 1 - slab allocated, 0 - out of memory.
+ */
+static int pool_grow(SessionPool *pool) {
+  if (pool->slab_count == pool->slab_capacity) {
+    int capacity = pool->slab_capacity ? pool->slab_capacity * 2 : 16;
+    Session_t **slabs = realloc(pool->slabs, capacity * sizeof(*slabs));
+    if (slabs == NULL) return 0;
+    pool->slabs = slabs;
+    pool->slab_capacity = capacity;
+  }
+  Session_t *slab = aligned_alloc(SESSION_ALIGN, SLAB_SESSIONS * sizeof(*slab));
+  if (slab == NULL) return 0;
+  pool->slabs[pool->slab_count++] = slab;
+  for (int i = SLAB_SESSIONS - 1; i >= 0; i--) {
+    memcpy(&slab[i], &pool->free_list, sizeof(pool->free_list));
+    pool->free_list = &slab[i];
+  }
+  return 1;
+}
+
+/**
+ * Take a session from the pool and reset it to a new game in START state.
+ * @param pool Session pool.
+ * @param seed Figure generator seed.
+ * @return New session or NULL if out of memory.
+ */
+Session_t *session_create(SessionPool *pool, unsigned int seed) {
+  Session_t *session = NULL;
+  if (pool->free_list != NULL || pool_grow(pool)) {
+    session = pool->free_list;
+    memcpy(&pool->free_list, session, sizeof(pool->free_list));
+    session_reset(pool, session, seed);
+    pool->live++;
+  }
+  return session;
+}
+
+/**
+ * Reset a session to a new game in START state, same as stats_init() of a
+ * seeded headless game.
+ * @param pool Session pool.
+ * @param session Session to reset.
+ * @param seed Figure generator seed.
+ */
+void session_reset(SessionPool *pool, Session_t *session, unsigned int seed) {
+  memcpy(session, &pool->blank, sizeof(*session));
+  session->rng = seed ? seed : 1;
+  session->next = pool->spawn[next_random(&session->rng) % pool->kinds];
+}
+
+/**
+ * Return a session to the pool.
+ * @param pool Session pool.
+ * @param session Session to release.
+ */
+void session_destroy(SessionPool *pool, Session_t *session) {
+  memcpy(session, &pool->free_list, sizeof(pool->free_list));
+  pool->free_list = session;
+  pool->live--;
+}
+
+/**
+ * Unpack a session into a game structure the engine can step. The board is
+ * not rebuilt here: most ticks only move the figure, board_sync() rebuilds it
+ * from the field when a figure locks.
+ * @param session Packed session.
+ * @param game Game structure to fill.
+ */
+void session_load(const Session_t *session, GameInfo_t *game) {
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j += 2) {
+      game->field[i][j] = session->field[i][j / 2] & 0x0F;
+      game->field[i][j + 1] = session->field[i][j / 2] >> 4;
+    }
+  }
+  unpack_figure(&session->current, &game->current);
+  unpack_figure(&session->next, &game->next);
+  game->score = session->score;
+  game->high_score = session->high_score;
+  game->level = session->level;
+  game->speed = session->speed;
+  game->pause = session->pause;
+  game->timer = session->timer;
+  game->state = session->state;
+  game->lag = session->lag;
+  game->ticks = session->ticks;
+  game->gravity = session->gravity;
+  game->fall = session->fall;
+  game->lock = session->lock;
+  game->headless = session->headless;
+  game->metrics = session->metrics;
+  game->rng = session->rng;
+  game->lines = session->lines;
+  game->pieces = session->pieces;
+  game->cleared = session->cleared;
+  game->garbage = session->garbage;
+  game->sent = session->sent;
+  game->spun = session->spun;
+  game->combo = session->combo;
+  game->b2b = session->b2b;
+  game->input_time = 0;
+  game->rewind = NULL;
+  game->finesse = NULL;
+  game->board_stale = 1;
+}
+
+/**
+ * Pack a game structure into a session.
+ * @param game Game structure.
+ * @param session Session to fill.
+ */
+void session_store(const GameInfo_t *game, Session_t *session) {
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j += 2) {
+      session->field[i][j / 2] =
+          (unsigned char)(game->field[i][j] | (game->field[i][j + 1] << 4));
+    }
+  }
+  pack_figure(&game->current, &session->current);
+  pack_figure(&game->next, &session->next);
+  session->score = game->score;
+  session->high_score = game->high_score;
+  session->level = game->level;
+  session->speed = game->speed;
+  session->pause = game->pause;
+  session->timer = game->timer;
+  session->state = game->state;
+  session->lag = (int)game->lag;
+  session->ticks = (unsigned int)game->ticks;
+  session->gravity = game->gravity;
+  session->fall = game->fall;
+  session->lock = game->lock;
+  session->headless = game->headless;
+  session->metrics = game->metrics;
+  session->rng = game->rng;
+  session->lines = game->lines;
+  session->pieces = game->pieces;
+  session->cleared = (unsigned char)game->cleared;
+  session->garbage = (unsigned char)game->garbage;
+  session->sent = (unsigned char)game->sent;
+  session->spun = (unsigned char)game->spun;
+  session->combo = (unsigned char)game->combo;
+  session->b2b = (unsigned char)game->b2b;
+}
+
+/**
+ * Deliver a user action to a headless session and advance it by one tick.
+ * @param session Session to step.
+ * @param action The user action, -1 - no action.
+ */
+void session_step(Session_t *session, UserAction_t action) {
+  GameInfo_t game;
+  session_load(session, &game);
+  if ((int)action != -1) game_input(&game, action);
+  game_tick(&game);
+  session_store(&game, session);
+}
+
+/**
+ * Pack a Tetramino figure, all cells of a figure share one color.
+ * @param figure Figure to pack.
+ * @param packed Packed figure.
+ */
+void pack_figure(const Tetramino *figure, PackedFigure *packed) {
+  packed->mask = 0;
+  packed->color = 0;
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      if (figure->view[i][j] != 0) {
+        packed->mask |= 1u << (i * FIGURE_SIZE + j);
+        packed->color = figure->view[i][j];
+      }
+    }
+  }
+  packed->x = figure->x;
+  packed->y = figure->y;
+  packed->type = figure->type;
+  packed->rows = figure->rows;
+  packed->cols = figure->cols;
+}
+
+/**
+ * Unpack a Tetramino figure.
+ * @param packed Packed figure.
+ * @param figure Figure to fill.
+ */
+void unpack_figure(const PackedFigure *packed, Tetramino *figure) {
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      figure->view[i][j] =
+          (packed->mask >> (i * FIGURE_SIZE + j)) & 1 ? packed->color : 0;
+    }
+  }
+  figure->x = packed->x;
+  figure->y = packed->y;
+  figure->type = packed->type;
+  figure->rows = packed->rows;
+  figure->cols = packed->cols;
+}
+
+/**
+ * Return the number of a figure type in make_figure() order of the active
+ * piece set.
+ * @param type Figure type letter.
+ * @return Figure number, 0 for an unknown type.
+ */
+int figure_kind(char type) { return pieces_kind(pieces_active(), type); }
@@ -0,0 +1,83 @@
+#ifndef TETRIS_SESSION_H
+#define TETRIS_SESSION_H
+
+#include <string.h>
+
+#include "tetris_backend.h"
+#include "tetris_board.h"
+#include "tetris_pieces.h"
+
+// session pool parameters
+#define SESSION_ALIGN 64
+#define SLAB_SESSIONS 4096
+#define FIGURE_KINDS 7
+#define FIGURE_TYPES "IOLJSTZ"
+
+// Tetramino figure packed into 12 bytes: the view as a bit mask
+typedef struct {
+  unsigned int mask;
+  signed char x;
+  signed char y;
+  char type;
+  unsigned char color;
+  unsigned char rows;
+  unsigned char cols;
+} PackedFigure;
+
+// game session packed for storage, fields used on every tick go first
+typedef struct {
+  _Alignas(SESSION_ALIGN) long long timer;
+  int lag;
+  int fall;
+  int gravity;
+  unsigned int rng;
+  unsigned int ticks;
+  short lock;
+  unsigned char state;
+  unsigned char pause;
+  unsigned char level;
+  unsigned char headless;
+  unsigned char metrics;
+  PackedFigure current;
+  PackedFigure next;
+  int score;
+  int high_score;
+  int speed;
+  int lines;
+  int pieces;
+  unsigned char cleared;
+  unsigned char garbage;
+  unsigned char sent;
+  unsigned char spun;
+  unsigned char combo;
+  unsigned char b2b;
+  unsigned char field[HEIGHT][WIDTH / 2];
+} Session_t;
+
+// slab allocator for game sessions
+typedef struct {
+  Session_t **slabs;
+  int slab_count;
+  int slab_capacity;
+  Session_t *free_list;
+  long live;
+  Session_t blank;
+  PackedFigure spawn[PIECES_MAX];
+  int kinds;
+} SessionPool;
+
+void pool_init(SessionPool *pool);
+void pool_free(SessionPool *pool);
+Session_t *session_create(SessionPool *pool, unsigned int seed);
+void session_reset(SessionPool *pool, Session_t *session, unsigned int seed);
+void session_destroy(SessionPool *pool, Session_t *session);
+
+void session_load(const Session_t *session, GameInfo_t *game);
+void session_store(const GameInfo_t *game, Session_t *session);
+void session_step(Session_t *session, UserAction_t action);
+
+void pack_figure(const Tetramino *figure, PackedFigure *packed);
+void unpack_figure(const PackedFigure *packed, Tetramino *figure);
+int figure_kind(char type);
+
+#endif
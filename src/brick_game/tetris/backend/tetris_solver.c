@@ -0,0 +1,411 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_solver.h"
+
+/**
+ * Read a puzzle file: the header line, "pieces" with the figure letters of the
+ * active piece set in order, an optional "lines" target (0 or missing -
+ * perfect clear) and the field as rows of WIDTH characters, '.' - empty, '#' -
+ * filled. The rows are the bottom of the field.
+ * @param puzzle Puzzle to fill.
+ * @param path File path.
+ * @return 1 - loaded, 0 - file error or malformed puzzle.
+ */
+int puzzle_load(Puzzle_t *puzzle, const char *path) {
+  FILE *file = fopen(path, "r");
+  unsigned short rows[HEIGHT];
+  char line[128];
+  int count = 0;
+  int res = file != NULL;
+  memset(puzzle, 0, sizeof(*puzzle));
+  if (res) {
+    res = fgets(line, sizeof(line), file) != NULL &&
+          strncmp(line, PUZZLE_MAGIC, strlen(PUZZLE_MAGIC)) == 0;
+    while (res && fgets(line, sizeof(line), file) != NULL) {
+      size_t len = strcspn(line, "\r\n");
+      line[len] = '\0';
+      if (sscanf(line, "pieces %16s", puzzle->pieces) == 1 ||
+          sscanf(line, "lines %d", &puzzle->lines) == 1 || len == 0)
+        continue;
+      res = len == WIDTH && count < HEIGHT &&
+            strspn(line, ".#") == WIDTH;
+      unsigned short row = 0;
+      for (int j = 0; res && j < WIDTH; j++) row |= (line[j] == '#') << j;
+      res = res && row != FULL_ROW;
+      if (res) rows[count++] = row;
+    }
+    fclose(file);
+  }
+  for (int i = 0; i < count; i++) puzzle->rows[HEIGHT - count + i] = rows[i];
+  puzzle->count = (int)strlen(puzzle->pieces);
+  for (int i = 0; res && i < puzzle->count; i++)
+    res = pieces_find(pieces_active(), puzzle->pieces[i]) != NULL;
+  return res && puzzle->count > 0 && puzzle->lines >= 0;
+}
+
+/**
+ * Make a puzzle of a live game: its field, the current and next figures and
+ * the figures its generator will draw after them.
+ * @param puzzle Puzzle to fill.
+ * @param game Game to capture.
+ * @param count Number of figures, at most SOLVER_PIECES_MAX.
+ * @param lines Lines to clear, 0 - perfect clear.
+ */
+void puzzle_capture(Puzzle_t *puzzle, const GameInfo_t *game, int count,
+                    int lines) {
+  const PieceSet_t *set = pieces_active();
+  unsigned int rng = game->rng;
+  memset(puzzle, 0, sizeof(*puzzle));
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++)
+      puzzle->rows[i] |= (game->field[i][j] != 0) << j;
+  }
+  if (count > SOLVER_PIECES_MAX) count = SOLVER_PIECES_MAX;
+  for (int i = 0; i < count; i++) {
+    if (i == 0)
+      puzzle->pieces[i] = game->current.type;
+    else if (i == 1)
+      puzzle->pieces[i] = game->next.type;
+    else
+      puzzle->pieces[i] = set->pieces[next_random(&rng) % set->count].type;
+  }
+  puzzle->count = count;
+  puzzle->lines = lines;
+}
+
+/**
+ * Copy row masks to the field of a game.
+ * @param rows Field rows, top row first.
+ * @param game Game to fill.
+ */
+void puzzle_field(const unsigned short *rows, GameInfo_t *game) {
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++)
+      game->field[i][j] = rows[i] >> j & 1 ? COLOR_GARBAGE : 0;
+  }
+  board_rebuild(&game->board, game->field);
+}
+
+/**
+ * Make a figure the current one of a game at the spawn position.
+ * @param game Game.
+ * @param type Figure type letter.
+ * @return 1 - the figure fits, 0 - it overlaps the field or the active piece
+ * set has no such type.
+ */
+int puzzle_spawn(GameInfo_t *game, char type) {
+  const Piece_t *piece = pieces_find(pieces_active(), type);
+  GameInfo_t *prev = bind_game(game);
+  reset_figure(&game->current);
+  make_figure(&game->current, figure_kind(type));
+  if (piece != NULL) {
+    game->current.x = piece->spawn.x;
+    game->current.y = piece->spawn.y;
+  }
+  int fits = piece != NULL && !figure_overlay();
+  bind_game(prev);
+  return fits;
+}
+
+/**
+ * Set a figure on row masks and remove full rows.
+ * @param rows Field rows, top row first.
+ * @param figure Resting figure.
+ * @return Number of lines cleared, -1 - the figure sticks out above the field
+ * and nothing is set.
+ */
+int puzzle_place(unsigned short *rows, const PackedFigure *figure) {
+  int cleared = 0;
+  for (int bit = 0; bit < FIGURE_CELLS; bit++) {
+    if (figure->mask >> bit & 1 && figure->y + bit / FIGURE_SIZE < 0)
+      cleared = -1;
+  }
+  for (int bit = 0; cleared == 0 && bit < FIGURE_CELLS; bit++) {
+    if (figure->mask >> bit & 1)
+      rows[figure->y + bit / FIGURE_SIZE] |=
+          1u << (figure->x + bit % FIGURE_SIZE);
+  }
+  int to = HEIGHT - 1;
+  for (int from = HEIGHT - 1; cleared >= 0 && from >= 0; from--) {
+    if (rows[from] == FULL_ROW)
+      cleared++;
+    else
+      rows[to--] = rows[from];
+  }
+  for (; cleared > 0 && to >= 0; to--) rows[to] = 0;
+  return cleared;
+}
+
+/**
+ * Check if the puzzle goal is reached: an empty field or the target number of
+ * lines cleared.
+ */
+static int solver_goal(const Puzzle_t *puzzle, const unsigned short *rows,
+                       int cleared) {
+  int res = 1;
+  if (puzzle->lines > 0) {
+    res = cleared >= puzzle->lines;
+  } else {
+    for (int i = 0; res && i < HEIGHT; i++) res = rows[i] == 0;
+  }
+  return res;
+}
+
+/**
+ * Check if the goal is out of reach with the next figures of the puzzle.
+ *
+ * Perfect clear: the filled cells plus the cells of the figures must make
+ * whole rows, the stack must fit in those rows, since a cell above them could
+ * never be cleared, and a column filled over all of them walls off parts that
+ * are filled by whole figures only, so each part must miss a multiple of the
+ * greatest common divisor of the figure sizes.
+ *
+ * Target lines: completing a row takes at least its empty cells, so the
+ * cheapest rows must be affordable with the cells of the figures.
+ * @param index Number of figures placed.
+ * @param remaining Number of figures to place.
+ * @return 1 - prune, 0 - the goal may be reachable.
+ */
+static int solver_prune(const Puzzle_t *puzzle, const unsigned short *rows,
+                        int cleared, int index, int remaining) {
+  int filled = 0;
+  int top = HEIGHT;
+  int res = 0;
+  int figures = 0;
+  int unit = 0;
+  for (int i = index; i < index + remaining; i++) {
+    const Piece_t *piece = pieces_find(pieces_active(), puzzle->pieces[i]);
+    int size = piece != NULL ? __builtin_popcount(piece->views[0].mask) : 0;
+    figures += size;
+    for (int rest = unit; rest != 0;) {
+      int next = size % rest;
+      size = rest;
+      rest = next;
+    }
+    unit = size;
+  }
+  for (int i = 0; i < HEIGHT; i++) {
+    int cells = __builtin_popcount(rows[i]);
+    filled += cells;
+    if (cells > 0 && top == HEIGHT) top = i;
+  }
+  if (puzzle->lines == 0) {
+    int total = filled + figures;
+    int window = total / WIDTH < HEIGHT ? total / WIDTH : HEIGHT;
+    int empty = 0;
+    res = total % WIDTH != 0 || HEIGHT - top > window;
+    for (int col = 0; !res && col <= WIDTH; col++) {
+      int missing = 0;
+      for (int i = HEIGHT - window; col < WIDTH && i < HEIGHT; i++)
+        missing += !(rows[i] >> col & 1);
+      empty += missing;
+      if (col == WIDTH || missing == 0) {
+        res = unit != 0 && empty % unit != 0;
+        empty = 0;
+      }
+    }
+  } else {
+    int by_empty[WIDTH + 1] = {0};
+    int cells = figures;
+    int need = puzzle->lines - cleared;
+    for (int i = 0; i < HEIGHT; i++)
+      by_empty[WIDTH - __builtin_popcount(rows[i])]++;
+    for (int empty = 1; need > 0 && empty <= WIDTH; empty++) {
+      for (; need > 0 && by_empty[empty] > 0 && cells >= empty;
+           by_empty[empty]--) {
+        cells -= empty;
+        need--;
+      }
+    }
+    res = need > 0;
+  }
+  return res;
+}
+
+/**
+ * Hash a search position: field rows, figure index and cleared lines. The low
+ * byte is left free for the search depth of a memo entry.
+ */
+static unsigned long long board_hash(const unsigned short *rows, int index,
+                                     int cleared) {
+  unsigned long long hash = 0xcbf29ce484222325ull;
+  for (int i = 0; i < HEIGHT; i++) hash = (hash ^ rows[i]) * 0x100000001b3ull;
+  hash = (hash ^ (unsigned)index) * 0x100000001b3ull;
+  hash = (hash ^ (unsigned)cleared) * 0x100000001b3ull;
+  hash ^= hash >> 31;
+  hash *= 0x7fb5d329728ea185ull;
+  hash ^= hash >> 27;
+  return hash | 0x100;
+}
+
+/**
+ * Check if the position is known to fail with at least the given number of
+ * figures left.
+ */
+static int memo_failed(atomic_ullong *memo, unsigned long long hash,
+                       int remaining) {
+  unsigned long long mask = (1ull << SOLVER_MEMO_BITS) - 1;
+  int res = 0;
+  int done = 0;
+  for (int i = 0; !done && i < SOLVER_MEMO_PROBES; i++) {
+    unsigned long long entry = atomic_load_explicit(
+        &memo[((hash >> 8) + i) & mask], memory_order_relaxed);
+    done = entry == 0 || (entry & ~0xffull) == (hash & ~0xffull);
+    res = entry != 0 && done && (int)(entry & 0xff) >= remaining;
+  }
+  return res;
+}
+
+/**
+ * Remember that the position fails with the given number of figures left. A
+ * full probe sequence drops the entry.
+ */
+static void memo_store(atomic_ullong *memo, unsigned long long hash,
+                       int remaining) {
+  unsigned long long mask = (1ull << SOLVER_MEMO_BITS) - 1;
+  unsigned long long entry = (hash & ~0xffull) | (unsigned)remaining;
+  int done = 0;
+  for (int i = 0; !done && i < SOLVER_MEMO_PROBES; i++) {
+    atomic_ullong *slot = &memo[((hash >> 8) + i) & mask];
+    unsigned long long old = atomic_load_explicit(slot, memory_order_relaxed);
+    while (!done && (old == 0 || (old & ~0xffull) == (hash & ~0xffull))) {
+      done = (old != 0 && (int)(old & 0xff) >= remaining) ||
+             atomic_compare_exchange_weak(slot, &old, entry);
+    }
+  }
+}
+
+/**
+ * Depth-first search for the goal within the depth of the current iteration.
+ * @param worker Thread workspace, the found path is stored in it.
+ * @param rows Field rows.
+ * @param index Number of figures placed.
+ * @param cleared Lines cleared so far.
+ * @return 1 - goal reached, 0 - not reachable or another thread found it.
+ */
+static int solver_search(SolverWorker_t *worker, const unsigned short *rows,
+                         int index, int cleared) {
+  Solver_t *solver = worker->solver;
+  const Puzzle_t *puzzle = solver->puzzle;
+  int remaining = solver->depth - index;
+  int res = solver_goal(puzzle, rows, cleared);
+  worker->nodes++;
+  if (res) worker->length = index;
+  if (!res && remaining > 0 &&
+      !atomic_load_explicit(&solver->found, memory_order_relaxed) &&
+      !solver_prune(puzzle, rows, cleared, index, remaining)) {
+    unsigned long long hash = board_hash(rows, index, cleared);
+    if (!memo_failed(solver->memo, hash, remaining)) {
+      puzzle_field(rows, &worker->game);
+      if (puzzle_spawn(&worker->game, puzzle->pieces[index])) {
+        Placement *placements = worker->placements[index];
+        int count =
+            generate_placements(&worker->gen, &worker->game, placements);
+        for (int i = 0; !res && i < count; i++) {
+          unsigned short next[HEIGHT];
+          memcpy(next, rows, sizeof(next));
+          int lines = puzzle_place(next, &placements[i].figure);
+          res = lines >= 0 &&
+                solver_search(worker, next, index + 1, cleared + lines);
+          if (res) worker->path[index] = placements[i];
+        }
+      }
+      if (!res && !atomic_load(&solver->found))
+        memo_store(solver->memo, hash, remaining);
+    }
+  }
+  return res;
+}
+
+/**
+ * Find the shortest sequence of placements of the puzzle figures, in order,
+ * that reaches the goal. Depths are searched one after another, the
+ * placements of the first figure are shared between worker threads and the
+ * first thread to reach the goal stops the others.
+ * @param puzzle Puzzle.
+ * @param threads Number of worker threads.
+ * @param solution Solution to fill, found is 0 if the goal cannot be reached
+ * with the puzzle figures.
+ * @return 1 - solved, 0 - no solution or out of memory.
+ */
+int solve_puzzle(const Puzzle_t *puzzle, int threads, Solution_t *solution) {
+  Solver_t solver;
+  pthread_t ids[SOLVER_THREADS_MAX];
+  if (threads < 1) threads = 1;
+  if (threads > SOLVER_THREADS_MAX) threads = SOLVER_THREADS_MAX;
+  SolverWorker_t *workers = malloc(threads * sizeof(*workers));
+  Placement *roots = malloc(PLACEMENTS_MAX * sizeof(*roots));
+  memset(solution, 0, sizeof(*solution));
+  solver.puzzle = puzzle;
+  solver.roots = roots;
+  solver.solution = solution;
+  solver.memo = calloc(1ull << SOLVER_MEMO_BITS, sizeof(*solver.memo));
+  atomic_init(&solver.found, 0);
+  atomic_init(&solver.nodes, 0);
+  pthread_mutex_init(&solver.lock, NULL);
+  int res = workers != NULL && roots != NULL && solver.memo != NULL;
+  for (int i = 0; res && i < threads; i++) {
+    memset(&workers[i].game, 0, sizeof(workers[i].game));
+    workers[i].game.headless = 1;
+    workers[i].solver = &solver;
+    workers[i].nodes = 0;
+  }
+  for (int depth = 1; res && !solution->found && depth <= puzzle->count;
+       depth++) {
+    solver.depth = depth;
+    atomic_init(&solver.next, 0);
+    if (solver_prune(puzzle, puzzle->rows, 0, 0, depth)) continue;
+    puzzle_field(puzzle->rows, &workers[0].game);
+    if (!puzzle_spawn(&workers[0].game, puzzle->pieces[0])) break;
+    solver.root_count = generate_placements(&workers[0].gen, &workers[0].game,
+                                            roots);
+    int count = threads < solver.root_count ? threads : solver.root_count;
+    int started = 0;
+    for (; started < count; started++) {
+      if (pthread_create(&ids[started], NULL, solver_worker,
+                         &workers[started]))
+        break;
+    }
+    if (started == 0) solver_worker(&workers[0]);
+    for (int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+    solution->found = atomic_load(&solver.found);
+  }
+  solution->nodes = atomic_load(&solver.nodes);
+  pthread_mutex_destroy(&solver.lock);
+  free(solver.memo);
+  free(roots);
+  free(workers);
+  return res && solution->found;
+}
+
+/**
+ * Worker thread of solve_puzzle(): searches below the placements of the first
+ * figure taken with an atomic counter.
+ * @param arg SolverWorker_t of the thread.
+ */
+void *solver_worker(void *arg) {
+  SolverWorker_t *worker = arg;
+  Solver_t *solver = worker->solver;
+  for (int i = atomic_fetch_add(&solver->next, 1);
+       i < solver->root_count && !atomic_load(&solver->found);
+       i = atomic_fetch_add(&solver->next, 1)) {
+    unsigned short rows[HEIGHT];
+    memcpy(rows, solver->puzzle->rows, sizeof(rows));
+    int lines = puzzle_place(rows, &solver->roots[i].figure);
+    if (lines >= 0 && solver_search(worker, rows, 1, lines)) {
+      pthread_mutex_lock(&solver->lock);
+      if (!atomic_load(&solver->found)) {
+        Solution_t *solution = solver->solution;
+        solution->placements[0] = solver->roots[i];
+        for (int j = 1; j < worker->length; j++)
+          solution->placements[j] = worker->path[j];
+        solution->length = worker->length;
+        atomic_store(&solver->found, 1);
+      }
+      pthread_mutex_unlock(&solver->lock);
+    }
+  }
+  atomic_fetch_add(&solver->nodes, worker->nodes);
+  worker->nodes = 0;
+  return NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef TETRIS_SOLVER_H
+#define TETRIS_SOLVER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "tetris_movegen.h"
+#include "tetris_pieces.h"
+
+// solver parameters
+#define SOLVER_PIECES_MAX 16
+#define SOLVER_THREADS_MAX 64
+#define SOLVER_MEMO_BITS 20
+#define SOLVER_MEMO_PROBES 8
+#define PUZZLE_MAGIC "tetris-puzzle 1"
+#define FULL_ROW ((1u << WIDTH) - 1)
+
+// field as row masks, top row first, and the figures to place in order
+typedef struct {
+  unsigned short rows[HEIGHT];
+  char pieces[SOLVER_PIECES_MAX + 1];
+  int count;
+  int lines;
+} Puzzle_t;
+
+// shortest placement sequence found by the solver
+typedef struct {
+  int found;
+  int length;
+  Placement placements[SOLVER_PIECES_MAX];
+  long long nodes;
+} Solution_t;
+
+// search of one depth shared between worker threads
+typedef struct {
+  const Puzzle_t *puzzle;
+  int depth;
+  Placement *roots;
+  int root_count;
+  atomic_int next;
+  atomic_int found;
+  atomic_llong nodes;
+  atomic_ullong *memo;
+  pthread_mutex_t lock;
+  Solution_t *solution;
+} Solver_t;
+
+// search workspace of one thread
+typedef struct {
+  Solver_t *solver;
+  GameInfo_t game;
+  MoveGen_t gen;
+  Placement path[SOLVER_PIECES_MAX];
+  Placement placements[SOLVER_PIECES_MAX][PLACEMENTS_MAX];
+  int length;
+  long long nodes;
+} SolverWorker_t;
+
+int puzzle_load(Puzzle_t *puzzle, const char *path);
+void puzzle_capture(Puzzle_t *puzzle, const GameInfo_t *game, int count,
+                    int lines);
+void puzzle_field(const unsigned short *rows, GameInfo_t *game);
+int puzzle_spawn(GameInfo_t *game, char type);
+int puzzle_place(unsigned short *rows, const PackedFigure *figure);
+
+int solve_puzzle(const Puzzle_t *puzzle, int threads, Solution_t *solution);
+void *solver_worker(void *arg);
+
+#endif
@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_versus.h"
+
+/**
+ * Init a match: each player gets its own figure generator derived from the
+ * match seed and starts playing.
+ * @param match Match to init.
+ * @param seed Match seed.
+ */
+void match_init(Match_t *match, unsigned int seed) {
+  memset(match, 0, sizeof(*match));
+  for (int i = 0; i < PLAYERS; i++) {
+    GameInfo_t *game = &match->players[i];
+    game->headless = 1;
+    game->metrics = 1;
+    seed_game(game, seed + i * 0x9E3779B9u);
+    GameInfo_t *prev = bind_game(game);
+    stats_init(game);
+    bind_game(prev);
+    game_input(game, Start);
+    bot_init(&match->bots[i]);
+  }
+  match->winner = MATCH_RUNNING;
+}
+
+/**
+ * Deliver one action to each player, advance both boards by one tick and
+ * exchange garbage.
+ * @param match Match to step.
+ * @param actions Player actions, -1 - no action.
+ */
+void match_step(Match_t *match, const UserAction_t actions[PLAYERS]) {
+  for (int i = 0; i < PLAYERS; i++) {
+    if ((int)actions[i] != -1) game_input(&match->players[i], actions[i]);
+    game_tick(&match->players[i]);
+  }
+  match->ticks++;
+  match_exchange(match);
+}
+
+/**
+ * Deliver the garbage each player's clears have left to send after
+ * cancelling its own incoming rows when the figure locked.
+ * @param match Match to update.
+ */
+void match_exchange(Match_t *match) {
+  for (int i = 0; i < PLAYERS; i++) {
+    GameInfo_t *game = &match->players[i];
+    GameInfo_t *opponent = &match->players[PLAYERS - 1 - i];
+    if (game->sent > 0) {
+      opponent->garbage += game->sent;
+      if (opponent->garbage > COUNTER_MAX) opponent->garbage = COUNTER_MAX;
+      match->sent[i] += game->sent;
+      game->sent = 0;
+    }
+  }
+}
+
+/**
+ * Decide the match once a player is out or the tick limit is reached, then
+ * the higher score wins.
+ * @param match Match to judge.
+ * @param max_ticks Tick limit.
+ */
+void match_judge(Match_t *match, long long max_ticks) {
+  int lost0 = match->players[0].state == GAMEOVER;
+  int lost1 = match->players[1].state == GAMEOVER;
+  if (lost0 || lost1) {
+    match->winner = lost0 && lost1 ? MATCH_DRAW : (lost0 ? 1 : 0);
+  } else if (match->ticks >= max_ticks) {
+    int score0 = match->players[0].score;
+    int score1 = match->players[1].score;
+    match->winner = score0 == score1 ? MATCH_DRAW : (score0 > score1 ? 0 : 1);
+  }
+}
+
+/**
+ * Play a bot-versus-bot match at full speed until it is decided.
+ * @param match Initialized match.
+ * @param max_ticks Tick limit.
+ */
+void match_play_bots(Match_t *match, long long max_ticks) {
+  while (match->winner == MATCH_RUNNING) {
+    UserAction_t actions[PLAYERS];
+    for (int i = 0; i < PLAYERS; i++)
+      actions[i] = bot_action(&match->bots[i], &match->players[i]);
+    match_step(match, actions);
+    match_judge(match, max_ticks);
+  }
+}
+
+/**
+ * Play initialized bot matches on a pool of worker threads. Workers take the
+ * next match with an atomic counter, a match never leaves its thread, so
+ * garbage exchange needs no locks.
+ * @param matches Initialized matches.
+ * @param count Number of matches.
+ * @param threads Number of worker threads.
+ * @param max_ticks Tick limit of a match.
+ */
+void versus_run(Match_t *matches, int count, int threads, long long max_ticks) {
+  pthread_t workers[VERSUS_THREADS_MAX];
+  Scheduler_t scheduler;
+  scheduler.matches = matches;
+  scheduler.count = count;
+  scheduler.max_ticks = max_ticks;
+  atomic_init(&scheduler.next, 0);
+  if (threads < 1) threads = 1;
+  if (threads > VERSUS_THREADS_MAX) threads = VERSUS_THREADS_MAX;
+  int started = 0;
+  for (; started < threads; started++) {
+    if (pthread_create(&workers[started], NULL, versus_worker, &scheduler))
+      break;
+  }
+  if (started == 0) versus_worker(&scheduler);
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+}
+
+/**
+ * Worker thread of versus_run().
+ * @param arg Scheduler_t shared by the workers.
+ */
+void *versus_worker(void *arg) {
+  Scheduler_t *scheduler = arg;
+  for (int i = atomic_fetch_add(&scheduler->next, 1); i < scheduler->count;
+       i = atomic_fetch_add(&scheduler->next, 1)) {
+    match_play_bots(&scheduler->matches[i], scheduler->max_ticks);
+  }
+  return NULL;
+}
+
+/**
+ * Return the number of online CPU cores.
+ */
+int versus_threads() {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+}
+
+/**
+ * Convert a split-screen key code to a player action.
+ * @param key The key code of the user input.
+ * @param player Set to the player the key belongs to.
+ * @return The user action or -1 for keys of no player.
+ */
+UserAction_t versus_key_action(int key, int *player) {
+  UserAction_t res = -1;
+  *player = key == KEY_LEFT || key == KEY_RIGHT || key == KEY_DOWN ||
+            key == KEY_UP;
+  switch (key) {
+    case P1_LEFT_KEY:
+    case KEY_LEFT:
+      res = Left;
+      break;
+    case P1_RIGHT_KEY:
+    case KEY_RIGHT:
+      res = Right;
+      break;
+    case P1_DOWN_KEY:
+    case KEY_DOWN:
+      res = Down;
+      break;
+    case P1_ROTATE_KEY:
+    case KEY_UP:
+      res = Action;
+      break;
+  }
+  return res;
+}
@@ -0,0 +1,53 @@
+#ifndef TETRIS_VERSUS_H
+#define TETRIS_VERSUS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "tetris_bot.h"
+
+// versus parameters
+#define PLAYERS 2
+#define VERSUS_MAX_TICKS (60L * 60 * 10)
+#define VERSUS_THREADS_MAX 64
+
+// match results
+#define MATCH_RUNNING -1
+#define MATCH_DRAW PLAYERS
+
+// split-screen keys of the first player, the second one uses arrows
+#define P1_LEFT_KEY 'a'
+#define P1_RIGHT_KEY 'd'
+#define P1_DOWN_KEY 's'
+#define P1_ROTATE_KEY 'w'
+
+// head-to-head match of two boards, always stepped by one thread
+typedef struct {
+  GameInfo_t players[PLAYERS];
+  Bot_t bots[PLAYERS];
+  int sent[PLAYERS];
+  int winner;
+  long long ticks;
+} Match_t;
+
+// matches shared between worker threads
+typedef struct {
+  Match_t *matches;
+  int count;
+  long long max_ticks;
+  atomic_int next;
+} Scheduler_t;
+
+void match_init(Match_t *match, unsigned int seed);
+void match_step(Match_t *match, const UserAction_t actions[PLAYERS]);
+void match_exchange(Match_t *match);
+void match_judge(Match_t *match, long long max_ticks);
+void match_play_bots(Match_t *match, long long max_ticks);
+
+void versus_run(Match_t *matches, int count, int threads, long long max_ticks);
+void *versus_worker(void *arg);
+int versus_threads();
+UserAction_t versus_key_action(int key, int *player);
+
+#endif
@@ -0,0 +1,314 @@
+#include "tetris_wheel.h"
+
+/**
+ * Link a timer into the slot its deadline falls into: level 0 holds the
+ * deadlines of the next WHEEL_SLOTS ticks one tick per slot, each higher
+ * level holds WHEEL_SLOTS times farther deadlines WHEEL_SLOTS times coarser.
+ * Passed deadlines go to the next tick, deadlines beyond the wheel to its
+ * last slot, from where they are cascaded again.
+ */
+static void wheel_place(TimerWheel_t *wheel, WheelTimer *timer) {
+  long long base = wheel->now + 1;
+  long long expires = timer->expires;
+  int level = 0;
+  if (expires < base) expires = base;
+  if (expires - base >= WHEEL_SPAN) expires = base + WHEEL_SPAN - 1;
+  while (level < WHEEL_LEVELS - 1 &&
+         expires - base >= 1LL << (WHEEL_BITS * (level + 1)))
+    level++;
+  WheelTimer *head =
+      &wheel->slots[level][expires >> (WHEEL_BITS * level) & WHEEL_MASK];
+  timer->next = head;
+  timer->prev = head->prev;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+/**
+ * Unlink every timer of a slot.
+ * @return The first timer of the slot chained by next, NULL - empty slot.
+ */
+static WheelTimer *wheel_take(WheelTimer *head) {
+  WheelTimer *res = NULL;
+  if (head->next != head) {
+    res = head->next;
+    head->prev->next = NULL;
+  }
+  head->next = head;
+  head->prev = head;
+  return res;
+}
+
+/**
+ * Move the timers of a higher level slot whose span begins to finer slots.
+ */
+static void wheel_cascade(TimerWheel_t *wheel, int level, int slot) {
+  WheelTimer *timer = wheel_take(&wheel->slots[level][slot]);
+  while (timer != NULL) {
+    WheelTimer *next = timer->next;
+    wheel_place(wheel, timer);
+    timer = next;
+  }
+}
+
+/**
+ * Init an empty wheel.
+ * @param wheel Timer wheel.
+ * @param now Current tick.
+ */
+void wheel_init(TimerWheel_t *wheel, long long now) {
+  wheel->now = now;
+  wheel->pending = 0;
+  for (int i = 0; i < WHEEL_LEVELS; i++) {
+    for (int j = 0; j < WHEEL_SLOTS; j++) {
+      wheel->slots[i][j].next = &wheel->slots[i][j];
+      wheel->slots[i][j].prev = &wheel->slots[i][j];
+    }
+  }
+}
+
+/**
+ * Start a timer, a pending timer is moved to the new deadline. O(1).
+ * @param wheel Timer wheel.
+ * @param timer Timer.
+ * @param expires Tick the timer expires at, a passed tick expires on the
+ * next advance.
+ */
+void wheel_add(TimerWheel_t *wheel, WheelTimer *timer, long long expires) {
+  wheel_cancel(wheel, timer);
+  timer->expires = expires;
+  wheel_place(wheel, timer);
+  wheel->pending++;
+}
+
+/**
+ * Stop a timer, a timer that is not pending is left as is. O(1).
+ * @param wheel Timer wheel.
+ * @param timer Timer.
+ */
+void wheel_cancel(TimerWheel_t *wheel, WheelTimer *timer) {
+  if (wheel_pending(timer)) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+    wheel->pending--;
+  }
+}
+
+/**
+ * Check if a timer is started and has not expired yet.
+ * @param timer Timer, zero-initialized before its first use.
+ */
+int wheel_pending(const WheelTimer *timer) { return timer->prev != NULL; }
+
+/**
+ * Advance the wheel by one tick. Higher level slots are cascaded to finer
+ * ones as the wheel turns past them, so only the timers due now are touched
+ * besides the occasional cascade.
+ * @param wheel Timer wheel.
+ * @return Timers expired at the new tick chained by next, they are no
+ * longer pending and may be started again; NULL - none.
+ */
+WheelTimer *wheel_advance(TimerWheel_t *wheel) {
+  long long tick = wheel->now + 1;
+  int slot = tick & WHEEL_MASK;
+  for (int level = 1, carry = slot == 0; carry && level < WHEEL_LEVELS;
+       level++) {
+    int upper = tick >> (WHEEL_BITS * level) & WHEEL_MASK;
+    wheel_cascade(wheel, level, upper);
+    carry = upper == 0;
+  }
+  wheel->now = tick;
+  WheelTimer *res = wheel_take(&wheel->slots[0][slot]);
+  for (WheelTimer *timer = res; timer != NULL; timer = timer->next) {
+    timer->prev = NULL;
+    wheel->pending--;
+  }
+  return res;
+}
+
+/**
+ * Apply the ticks a moving session slept through up to a host tick. Until
+ * its deadline a tick only accumulates gravity or counts the lock delay, so
+ * the ticks are applied at once the way gravity_tick() would apply them.
+ */
+static void host_catch_up(HostSlot *slot, long long now) {
+  Session_t *session = slot->session;
+  long long idle = now - slot->synced;
+  if (idle > 0 && session->state == MOVING) {
+    session->ticks += (unsigned int)idle;
+    session->timer += idle * TICK_US;
+    if (slot->resting) {
+      session->fall = 0;
+      session->lock += (short)idle;
+    } else {
+      session->fall += (int)idle * session->gravity;
+    }
+  }
+  slot->synced = now;
+}
+
+/**
+ * Start the timer of a session at the tick its figure shifts or locks, a
+ * session waiting for input (START, PAUSE, GAMEOVER) is not scheduled.
+ * @param game The session loaded, synced at the current host tick.
+ */
+static void host_schedule(SessionHost_t *host, HostSlot *slot,
+                          GameInfo_t *game) {
+  wheel_cancel(&host->wheel, &slot->timer);
+  if (game->state == MOVING) {
+    GameInfo_t *prev = bind_game(game);
+    slot->resting = (collision() & 0b100) == 4;
+    bind_game(prev);
+    int ticks = slot->resting
+                    ? LOCK_DELAY - game->lock
+                    : (G_UNIT - game->fall + game->gravity - 1) / game->gravity;
+    if (ticks < 1) ticks = 1;
+    wheel_add(&host->wheel, &slot->timer, slot->synced + ticks);
+  }
+}
+
+/**
+ * Init a host for a number of sessions, its clock starts at tick 0.
+ * @param host Session host.
+ * @param capacity Maximum number of sessions.
+ * @return 1 - allocated, 0 - out of memory.
+ */
+int host_init(SessionHost_t *host, int capacity) {
+  wheel_init(&host->wheel, 0);
+  host->slots = calloc(capacity, sizeof(*host->slots));
+  host->count = 0;
+  host->capacity = host->slots != NULL ? capacity : 0;
+  host->free_slot = -1;
+  host->woken = 0;
+  return host->slots != NULL;
+}
+
+/**
+ * Release the host, its sessions stay with their pool.
+ * @param host Session host.
+ */
+void host_free(SessionHost_t *host) {
+  free(host->slots);
+  host->slots = NULL;
+  host->count = 0;
+  host->capacity = 0;
+  host->free_slot = -1;
+}
+
+/**
+ * Return the slot of an attached session.
+ * @return The slot, NULL - the id is out of range or detached.
+ */
+static HostSlot *host_slot(SessionHost_t *host, int id) {
+  HostSlot *res = NULL;
+  if (id >= 0 && id < host->count && host->slots[id].session != NULL)
+    res = &host->slots[id];
+  return res;
+}
+
+/**
+ * Add a session to the host clock, a slot freed by host_detach() is reused
+ * before a new one is taken.
+ * @param host Session host.
+ * @param session Session, from now on stepped by the host only.
+ * @return Session id, -1 - the host is full.
+ */
+int host_attach(SessionHost_t *host, Session_t *session) {
+  int res = -1;
+  if (host->free_slot >= 0) {
+    res = host->free_slot;
+    host->free_slot = host->slots[res].next_free;
+  } else if (host->count < host->capacity) {
+    res = host->count++;
+  }
+  if (res >= 0) {
+    GameInfo_t game;
+    HostSlot *slot = &host->slots[res];
+    slot->session = session;
+    slot->synced = host->wheel.now;
+    session_load(session, &game);
+    host_schedule(host, slot, &game);
+  }
+  return res;
+}
+
+/**
+ * Remove a session from the host clock, its state is brought up to the
+ * current tick first and its slot goes to the free list.
+ * @param host Session host.
+ * @param id Session id.
+ * @return 1 - detached, 0 - no session is attached with the id.
+ */
+int host_detach(SessionHost_t *host, int id) {
+  HostSlot *slot = host_slot(host, id);
+  if (slot != NULL) {
+    host_catch_up(slot, host->wheel.now);
+    wheel_cancel(&host->wheel, &slot->timer);
+    slot->session = NULL;
+    slot->next_free = host->free_slot;
+    host->free_slot = id;
+  }
+  return slot != NULL;
+}
+
+/**
+ * Deliver a user action to a session before the next host tick, the way
+ * session_step() delivers it before its tick, and reschedule the session.
+ * @param host Session host.
+ * @param id Session id.
+ * @param action The user action.
+ * @return 1 - delivered, 0 - no session is attached with the id.
+ */
+int host_input(SessionHost_t *host, int id, UserAction_t action) {
+  HostSlot *slot = host_slot(host, id);
+  if (slot != NULL) {
+    GameInfo_t game;
+    host_catch_up(slot, host->wheel.now);
+    session_load(slot->session, &game);
+    game_input(&game, action);
+    session_store(&game, slot->session);
+    host_schedule(host, slot, &game);
+  }
+  return slot != NULL;
+}
+
+/**
+ * Bring the tick counters of a sleeping session up to the current host tick,
+ * needed before the session is read.
+ * @param host Session host.
+ * @param id Session id.
+ * @return 1 - synced, 0 - no session is attached with the id.
+ */
+int host_sync(SessionHost_t *host, int id) {
+  HostSlot *slot = host_slot(host, id);
+  if (slot != NULL) host_catch_up(slot, host->wheel.now);
+  return slot != NULL;
+}
+
+/**
+ * Advance every session by one tick. Only the sessions whose figure shifts or
+ * locks on this tick are stepped, the others catch up when they are woken,
+ * synced or get input.
+ * @param host Session host.
+ * @return Number of sessions stepped.
+ */
+int host_advance(SessionHost_t *host) {
+  int res = 0;
+  WheelTimer *timer = wheel_advance(&host->wheel);
+  while (timer != NULL) {
+    HostSlot *slot = (HostSlot *)timer;
+    GameInfo_t game;
+    timer = timer->next;
+    host_catch_up(slot, host->wheel.now - 1);
+    session_load(slot->session, &game);
+    game_tick(&game);
+    session_store(&game, slot->session);
+    slot->synced = host->wheel.now;
+    host_schedule(host, slot, &game);
+    res++;
+  }
+  host->woken += res;
+  return res;
+}
@@ -0,0 +1,66 @@
+#ifndef TETRIS_WHEEL_H
+#define TETRIS_WHEEL_H
+
+#include <stdlib.h>
+
+#include "tetris_session.h"
+
+// timer wheel parameters: each level has WHEEL_SLOTS slots and one slot of a
+// level spans all slots of the level below, deadlines are in game ticks
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1LL << (WHEEL_BITS * WHEEL_LEVELS))
+
+// timer linked into a wheel slot, prev is NULL while it is not pending
+typedef struct WheelTimer {
+  struct WheelTimer *next;
+  struct WheelTimer *prev;
+  long long expires;
+} WheelTimer;
+
+// hierarchical timer wheel, now is the last tick processed
+typedef struct {
+  long long now;
+  long pending;
+  WheelTimer slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} TimerWheel_t;
+
+// session scheduled by a host, the timer goes first so an expired timer is
+// its slot; synced is the host tick the session state is up to date with,
+// next_free links a detached slot to the next one
+typedef struct {
+  WheelTimer timer;
+  Session_t *session;
+  long long synced;
+  int resting;
+  int next_free;
+} HostSlot;
+
+// sessions stepped on one clock, only those with a passed gravity or lock
+// delay deadline are woken; detached slots are reused from the free list
+typedef struct {
+  TimerWheel_t wheel;
+  HostSlot *slots;
+  int count;
+  int capacity;
+  int free_slot;
+  long long woken;
+} SessionHost_t;
+
+void wheel_init(TimerWheel_t *wheel, long long now);
+void wheel_add(TimerWheel_t *wheel, WheelTimer *timer, long long expires);
+void wheel_cancel(TimerWheel_t *wheel, WheelTimer *timer);
+int wheel_pending(const WheelTimer *timer);
+WheelTimer *wheel_advance(TimerWheel_t *wheel);
+
+int host_init(SessionHost_t *host, int capacity);
+void host_free(SessionHost_t *host);
+int host_attach(SessionHost_t *host, Session_t *session);
+int host_detach(SessionHost_t *host, int id);
+int host_input(SessionHost_t *host, int id, UserAction_t action);
+int host_sync(SessionHost_t *host, int id);
+int host_advance(SessionHost_t *host);
+
+#endif
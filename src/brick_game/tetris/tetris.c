@@ -1,23 +1,448 @@
 #include "tetris.h"
 
-int main(void) {
-  ncurses_init();
-  game_loop();
-  endwin();
+#include "../../gui/cli/tetris_ansi.h"
+#include "../../gui/cli/tetris_keyboard.h"
 
-  return 0;
+int main(int argc, char **argv) {
+  int res = 0;
+  if (argc > 1 && strcmp(argv[1], "--ansi") == 0) {
+    ansi_init();
+    ansi_game_loop();
+    ansi_end();
+  } else if (argc > 1 && strcmp(argv[1], "--versus") == 0) {
+    ncurses_init();
+    versus_game_loop();
+    endwin();
+  } else if (argc > 2 && strcmp(argv[1], "--bots") == 0) {
+    bots_run(atoi(argv[2]));
+  } else if (argc > 1 && strcmp(argv[1], "--verify") == 0) {
+    char replays[512];
+    data_path(replays, sizeof(replays), REPLAY_DIR);
+    res = verify_run(argc > 2 ? argv[2] : replays,
+                     argc > 3 ? atoi(argv[3]) : versus_threads());
+  } else if (argc > 2 && strcmp(argv[1], "--export") == 0) {
+    res = export_run(argv[2], NULL, argc > 3 ? atoi(argv[3]) : EXPORT_GAMES);
+  } else if (argc > 2 && strcmp(argv[1], "--export-replays") == 0) {
+    char replays[512];
+    data_path(replays, sizeof(replays), REPLAY_DIR);
+    res = export_run(argv[2], argc > 3 ? argv[3] : replays, 0);
+  } else if (argc > 1 && strcmp(argv[1], "--finesse") == 0) {
+    char replays[512];
+    data_path(replays, sizeof(replays), REPLAY_DIR);
+    res = finesse_run(argc > 2 ? argv[2] : replays);
+  } else if (argc > 2 && strcmp(argv[1], "--puzzle") == 0) {
+    res = puzzle_run(argv[2]);
+  } else if (argc > 2 && strcmp(argv[1], "--pieces") == 0) {
+    res = pieces_run(argv[2]);
+  } else if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+    res = serve_run();
+  } else if (argc > 1 && strcmp(argv[1], "--top") == 0) {
+    res = top_run(argc > 2 ? atoi(argv[2]) : LEADER_TOP);
+  } else {
+    ncurses_init();
+    res = game_loop();
+    endwin();
+    if (res) fprintf(stderr, "cannot start the input thread\n");
+  }
+
+  return res;
 }
 
 /**
- * The main game loop that runs the Tetris game.
+ * Check if the screen of a game differs from the one drawn last: the figure
+ * moved, locked or spawned, the state changed or another process set a high
+ * score. Ticks that only count down gravity and lock delay draw nothing.
+ * @param shown Game as it was drawn.
+ * @param game Main game structure.
  */
-void game_loop() {
+static int frame_changed(const GameInfo_t *shown, const GameInfo_t *game) {
+  return shown->state != game->state || shown->current.x != game->current.x ||
+         shown->current.y != game->current.y ||
+         shown->pieces != game->pieces || shown->score != game->score ||
+         shown->high_score != game->high_score;
+}
+
+/**
+ * The main game loop that runs the Tetris game. Keys are read by the input
+ * thread, every frame applies them in order at the time they were pressed.
+ * Between frames the loop sleeps on the input queue until a key arrives or
+ * the next tick is due, and the screen is drawn only when it changed.
+ * Games with custom pieces are neither recorded nor ranked, replays only know
+ * the built-in set.
+ * @return 0 - played, 1 - the input thread cannot be started.
+ */
+int game_loop() {
   GameInfo_t *game = updateCurrentState();
+  Recording_t rec;
+  Finesse_t finesse;
+  char replays[512];
+  int ranked = pieces_active() == pieces_builtin();
+  data_path(replays, sizeof(replays), REPLAY_DIR);
+  recording_init(&rec);
+  if (ranked) recording_begin(&rec, game);
+  game->rewind = rewind_create();
+  game->finesse = &finesse;
+  game->metrics = 1;
+  stats_init(game);
+  InputQueue queue;
+  Keyboard_t keyboard;
+  GameInfo_t shown = *game;
+  int res = 0;
+  int changed = 1;
+  input_init(&queue);
+  if (!keyboard_start(&keyboard, &queue)) res = 1;
+  while (res == 0 && game->state != EXIT_STATE) {
+    InputEvent event;
+    if (layers_update() || changed) {
+      print_game_screen(*game);
+      shown = *game;
+    }
+    long long due = game_due(game);
+    if (due < 0 || due > FRAME_IDLE_MS * 1000LL) due = FRAME_IDLE_MS * 1000LL;
+    changed = input_wait(&queue, due);
+    while (game->state != EXIT_STATE && input_pop(&queue, &event)) {
+      game_advance(game, event.time);
+      if (ranked) record_action(&rec, game, event.action);
+      userInput(event.action, 0);
+      if (record_result(&rec, game, replays) && !rewind_used(game))
+        leaderboard_submit(game);
+    }
+    game_advance(game, 0);
+    if (record_result(&rec, game, replays) && !rewind_used(game))
+      leaderboard_submit(game);
+    refresh_high_score(game);
+    changed = changed || frame_changed(&shown, game);
+  }
+  keyboard_stop(&keyboard);
+  input_free(&queue);
+  recording_free(&rec);
+  flush_high_score();
+  free(game->rewind);
+  game->rewind = NULL;
+  game->finesse = NULL;
+  return res;
+}
+
+/**
+ * The game loop for the raw ANSI terminal frontend. Input is polled until the
+ * next tick is due, so the loop sleeps instead of spinning.
+ */
+void ansi_game_loop() {
+  GameInfo_t *game = updateCurrentState();
+  Recording_t rec;
+  Finesse_t finesse;
+  char replays[512];
+  data_path(replays, sizeof(replays), REPLAY_DIR);
+  recording_init(&rec);
+  recording_begin(&rec, game);
+  game->rewind = rewind_create();
+  game->finesse = &finesse;
+  game->metrics = 1;
   stats_init(game);
   while (game->state != EXIT_STATE) {
+    refresh_high_score(game);
+    ansi_print_game_screen(*game);
+    UserAction_t action = get_action(ansi_getch(ansi_frame_timeout(game)));
+    record_action(&rec, game, action);
+    userInput(action, 0);
+    if (record_result(&rec, game, replays) && !rewind_used(game))
+      leaderboard_submit(game);
+  }
+  recording_free(&rec);
+  flush_high_score();
+  free(game->rewind);
+  game->rewind = NULL;
+  game->finesse = NULL;
+}
+
+/**
+ * Split-screen versus loop for two local players. Both boards run on a fixed
+ * tick driven by the wall clock, keys are applied as soon as they arrive.
+ */
+void versus_game_loop() {
+  Match_t match;
+  int paused = 0;
+  int running = 1;
+  match_init(&match, time(NULL));
+  long long last = get_time_us();
+  while (running) {
     erase();
-    print_game_screen(*game);
-    userInput(get_action(getch()), 0);
+    print_versus_screen(&match, paused);
     refresh();
+    for (int key = getch(); key != ERR; key = getch()) {
+      int player = 0;
+      UserAction_t action = versus_key_action(key, &player);
+      if (key == ESCAPE_KEY) {
+        running = 0;
+      } else if (key == PAUSE_KEY) {
+        paused = !paused;
+      } else if (key == ENTER_KEY && match.winner != MATCH_RUNNING) {
+        match_init(&match, time(NULL));
+      } else if ((int)action != -1 && !paused &&
+                 match.winner == MATCH_RUNNING) {
+        game_input(&match.players[player], action);
+      }
+    }
+    long long now = get_time_us();
+    if (paused || match.winner != MATCH_RUNNING) last = now;
+    for (; now - last >= TICK_US; last += TICK_US) {
+      UserAction_t none[PLAYERS] = {-1, -1};
+      match_step(&match, none);
+      match_judge(&match, LLONG_MAX);
+    }
+    napms(1);
+  }
+}
+
+/**
+ * Play headless bot-versus-bot matches on every core and print a summary.
+ * Aggregate game metrics are dumped to the data directory while they run.
+ * @param count Number of matches.
+ */
+void bots_run(int count) {
+  Match_t *matches = malloc((count > 0 ? count : 1) * sizeof(*matches));
+  int wins[PLAYERS + 1] = {0};
+  long long ticks = 0;
+  int sent = 0;
+  MetricsDumper_t dumper;
+  char metrics[512];
+  data_path(metrics, sizeof(metrics), METRICS_FILE);
+  metrics_dumper_start(&dumper, metrics, METRICS_INTERVAL_MS);
+  for (int i = 0; i < count; i++) match_init(&matches[i], i + 1);
+  long long start = get_time_us();
+  versus_run(matches, count, versus_threads(), VERSUS_MAX_TICKS);
+  double seconds = (get_time_us() - start) / 1000000.0;
+  metrics_dumper_stop(&dumper);
+  for (int i = 0; i < count; i++) {
+    wins[matches[i].winner]++;
+    ticks += matches[i].ticks;
+    sent += matches[i].sent[0] + matches[i].sent[1];
+  }
+  printf("matches: %d, P1 wins: %d, P2 wins: %d, draws: %d\n", count, wins[0],
+         wins[1], wins[2]);
+  printf("garbage rows sent: %d\n", sent);
+  printf("%.2f s, %.0f match ticks/s on %d threads\n", seconds,
+         seconds > 0 ? ticks / seconds : 0.0, versus_threads());
+  free(matches);
+}
+
+/**
+ * Re-simulate every recorded game of a directory and print the results as
+ * they arrive, followed by a summary.
+ * @param dir Directory with recordings.
+ * @param threads Number of worker threads.
+ * @return 0 - all recordings are valid, 1 - otherwise.
+ */
+int verify_run(const char *dir, int threads) {
+  int failed = 0;
+  long long start = get_time_us();
+  int count = replay_verify_dir(dir, threads, stdout, &failed);
+  double seconds = (get_time_us() - start) / 1000000.0;
+  if (count < 0) {
+    fprintf(stderr, "cannot read %s\n", dir);
+  } else {
+    printf("verified: %d, failed: %d, %.2f s, %.0f games/s on %d threads\n",
+           count, failed, seconds, seconds > 0 ? count / seconds : 0.0,
+           threads);
+  }
+  return count < 0 || failed > 0;
+}
+
+/**
+ * Play with the pieces of a definition file instead of the tetrominoes.
+ * @param path Piece definition file.
+ * @return 0 - played, 1 - the file cannot be loaded or the input thread
+ * cannot be started.
+ */
+int pieces_run(const char *path) {
+  PieceSet_t *set = malloc(sizeof(*set));
+  int res = set == NULL || !pieces_load(set, path);
+  if (res) {
+    fprintf(stderr, "cannot load pieces %s\n", path);
+  } else {
+    pieces_use(set);
+    ncurses_init();
+    res = game_loop();
+    endwin();
+    pieces_use(NULL);
+    if (res) fprintf(stderr, "cannot start the input thread\n");
+  }
+  free(set);
+  return res;
+}
+
+/**
+ * Replay every recorded game of a directory with the finesse analyzer and
+ * print the wasted presses of each game, followed by the totals.
+ * @param dir Directory with recordings.
+ * @return 0 - all recordings were replayed, 1 - otherwise.
+ */
+int finesse_run(const char *dir) {
+  char(*paths)[REPLAY_PATH_MAX] = NULL;
+  FinesseSummary total = {0};
+  Recording_t rec;
+  int failed = 0;
+  int count = replay_list(dir, &paths);
+  recording_init(&rec);
+  for (int i = 0; i < count; i++) {
+    Finesse_t finesse;
+    finesse_reset(&finesse);
+    if (recording_load(&rec, paths[i]) && finesse_replay(&finesse, &rec)) {
+      const FinesseSummary *summary = &finesse.summary;
+      printf("%s: pieces %d, faults %d, presses %d, optimal %d, wasted %d\n",
+             paths[i], summary->pieces, summary->faults, summary->presses,
+             summary->optimal, summary->wasted);
+      finesse_add(&total, summary);
+    } else {
+      printf("%s: FAIL\n", paths[i]);
+      failed++;
+    }
+  }
+  if (count < 0) {
+    fprintf(stderr, "cannot read %s\n", dir);
+  } else {
+    printf("games: %d, pieces: %d, faults: %d, wasted: %d of %d presses\n",
+           count - failed, total.pieces, total.faults, total.wasted,
+           total.presses);
+  }
+  recording_free(&rec);
+  free(paths);
+  return count < 0 || failed > 0;
+}
+
+/**
+ * Print the best games of the leaderboard.
+ * @param n Number of games.
+ * @return 0 - printed, 1 - the leaderboard cannot be opened.
+ */
+int top_run(int n) {
+  Leaderboard_t board;
+  int res = !leaderboard_open(&board, data_dir());
+  if (res) {
+    fprintf(stderr, "cannot open leaderboard in %s\n", data_dir());
+  } else {
+    LeaderRecord record;
+    printf("%4s %-16s %8s %6s %5s %8s %s\n", "RANK", "NAME", "SCORE", "LINES",
+           "LEVEL", "TIME", "DATE");
+    for (int rank = 1; rank <= n && leaderboard_get(&board, rank, &record);
+         rank++) {
+      char date[32];
+      time_t timestamp = (time_t)record.timestamp;
+      strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&timestamp));
+      printf("%4d %-16.16s %8d %6d %5d %5d:%02d %s\n", rank, record.name,
+             record.score, record.lines, record.level,
+             record.duration / 60000, record.duration / 1000 % 60, date);
+    }
+    printf("games: %d\n", leaderboard_count(&board));
+    leaderboard_close(&board);
+  }
+  return res;
+}
+
+/**
+ * Serve the bot protocol on stdin and stdout until the input ends.
+ * @return 0 - served, 1 - I/O error.
+ */
+int serve_run() {
+  Server_t *server = malloc(sizeof(*server));
+  int res = server == NULL;
+  if (!res) {
+    server_init(server);
+    res = !server_run(server, STDIN_FILENO, STDOUT_FILENO);
+    free(server);
+  }
+  return res;
+}
+
+/**
+ * Export training records of bot games or recorded games on every core and
+ * print the throughput. Set TETRIS_DATASET_RAW to store columns uncompressed.
+ * Aggregate game metrics are dumped to the data directory while it runs.
+ * @param out Output directory for the shards.
+ * @param replays Directory with recordings, NULL - play bot games.
+ * @param games Number of bot games.
+ * @return 0 - exported, 1 - an error occurred.
+ */
+int export_run(const char *out, const char *replays, int games) {
+  MetricsDumper_t dumper;
+  char metrics[512];
+  data_path(metrics, sizeof(metrics), METRICS_FILE);
+  metrics_dumper_start(&dumper, metrics, METRICS_INTERVAL_MS);
+  long long start = get_time_us();
+  long long records = dataset_export(out, replays, games, versus_threads(),
+                                     getenv("TETRIS_DATASET_RAW") == NULL);
+  double seconds = (get_time_us() - start) / 1000000.0;
+  metrics_dumper_stop(&dumper);
+  if (records < 0) {
+    fprintf(stderr, "export to %s failed\n", out);
+  } else {
+    printf("records: %lld, %.2f s, %.0f records/s on %d threads\n", records,
+           seconds, seconds > 0 ? records / seconds : 0.0, versus_threads());
+  }
+  return records < 0;
+}
+
+/**
+ * Solve a puzzle file on every core and step through the solution in the
+ * ncurses frontend.
+ * @param path Puzzle file.
+ * @return 0 - shown, 1 - the puzzle cannot be loaded.
+ */
+int puzzle_run(const char *path) {
+  Puzzle_t puzzle;
+  int res = !puzzle_load(&puzzle, path);
+  if (res) {
+    fprintf(stderr, "cannot load puzzle %s\n", path);
+  } else {
+    Solution_t *solution = malloc(sizeof(*solution));
+    ncurses_init();
+    mvprintw(1, 1, "SOLVING...");
+    refresh();
+    if (solution != NULL) solve_puzzle(&puzzle, versus_threads(), solution);
+    puzzle_game_loop(&puzzle, solution);
+    endwin();
+    free(solution);
+  }
+  return res;
+}
+
+/**
+ * Puzzle mode loop: arrows step forward and back through the solution.
+ * @param puzzle Puzzle.
+ * @param solution Solver result.
+ */
+void puzzle_game_loop(const Puzzle_t *puzzle, const Solution_t *solution) {
+  GameInfo_t board = {0};
+  int step = 0;
+  int running = solution != NULL;
+  int changed = 1;
+  while (running) {
+    if (changed) {
+      unsigned short rows[HEIGHT];
+      memcpy(rows, puzzle->rows, sizeof(rows));
+      for (int i = 0; i < step; i++)
+        puzzle_place(rows, &solution->placements[i].figure);
+      puzzle_field(rows, &board);
+      board.state = step < solution->length ? MOVING : GAMEOVER;
+      if (step < solution->length)
+        unpack_figure(&solution->placements[step].figure, &board.current);
+      erase();
+      print_puzzle_screen(&board, puzzle, solution, step);
+      refresh();
+      changed = 0;
+    }
+    for (int key = getch(); key != ERR; key = getch()) {
+      if (key == ESCAPE_KEY) {
+        running = 0;
+      } else if ((key == KEY_RIGHT || key == SPACE_KEY || key == ENTER_KEY) &&
+                 step < solution->length) {
+        step++;
+        changed = 1;
+      } else if (key == KEY_LEFT && step > 0) {
+        step--;
+        changed = 1;
+      }
+    }
+    napms(10);
   }
 }
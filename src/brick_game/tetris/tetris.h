@@ -1,6 +1,7 @@
 #ifndef TETRIS_H
 #define TETRIS_H
 
+#include <limits.h>
 #include <ncurses.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -11,7 +12,34 @@
 
 #include "../../gui/cli/tetris_frontend.h"
 #include "backend/tetris_backend.h"
+#include "backend/tetris_batch.h"
+#include "backend/tetris_board.h"
+#include "backend/tetris_dataset.h"
+#include "backend/tetris_finesse.h"
+#include "backend/tetris_highscore.h"
+#include "backend/tetris_leaderboard.h"
+#include "backend/tetris_metrics.h"
+#include "backend/tetris_pieces.h"
+#include "backend/tetris_replay.h"
+#include "backend/tetris_rewind.h"
+#include "backend/tetris_rollout.h"
+#include "backend/tetris_score.h"
+#include "backend/tetris_server.h"
+#include "backend/tetris_solver.h"
+#include "backend/tetris_versus.h"
+#include "backend/tetris_wheel.h"
 
-void game_loop();
+int game_loop();
+void ansi_game_loop();
+void versus_game_loop();
+void bots_run(int count);
+int verify_run(const char *dir, int threads);
+int top_run(int n);
+int serve_run();
+int puzzle_run(const char *path);
+void puzzle_game_loop(const Puzzle_t *puzzle, const Solution_t *solution);
+int export_run(const char *out, const char *replays, int games);
+int finesse_run(const char *dir);
+int pieces_run(const char *path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,413 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tetris_ansi.h"
+
+/**
+ * Return a pointer to the ANSI screen state: back buffer, last shown frame,
+ * output buffer and pending input bytes.
+ */
+AnsiScreen *get_ansi_screen() {
+  static AnsiScreen screen = {0};
+  return &screen;
+}
+
+/**
+ * Put the terminal in raw mode, switch to the alternate screen and hide the
+ * cursor.
+ */
+void ansi_init() {
+  AnsiScreen *screen = get_ansi_screen();
+  struct termios raw;
+  tcgetattr(STDIN_FILENO, &screen->saved);
+  raw = screen->saved;
+  raw.c_iflag &= ~(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
+  raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+  raw.c_cc[VMIN] = 1;
+  raw.c_cc[VTIME] = 0;
+  tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+  const char init[] = "\033[?1049h\033[?25l\033[2J";
+  ansi_write(init, sizeof(init) - 1);
+  screen->full_redraw = 1;
+  screen->in_len = 0;
+  srand(time(NULL));
+  init_start_screen_figures();
+}
+
+/**
+ * Restore terminal settings and the main screen.
+ */
+void ansi_end() {
+  AnsiScreen *screen = get_ansi_screen();
+  const char end[] = "\033[0m\033[?25h\033[?1049l";
+  ansi_write(end, sizeof(end) - 1);
+  tcsetattr(STDIN_FILENO, TCSAFLUSH, &screen->saved);
+}
+
+/**
+ * Wait for a key press at most timeout_ms milliseconds.
+ * @param timeout_ms Poll timeout: 0 - do not wait, -1 - wait for a key.
+ * @return Key code in ncurses notation (KEY_LEFT, ...) or ERR if no key was
+ * pressed.
+ */
+int ansi_getch(int timeout_ms) {
+  AnsiScreen *screen = get_ansi_screen();
+  int key = ERR;
+  if (!ansi_take_key(screen->in, &screen->in_len, &key)) {
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN)) {
+      ssize_t n = read(STDIN_FILENO, screen->in + screen->in_len,
+                       ANSI_IN_SIZE - screen->in_len);
+      if (n > 0) screen->in_len += (int)n;
+    }
+    ansi_take_key(screen->in, &screen->in_len, &key);
+  }
+  return key;
+}
+
+/**
+ * Take the first key off buffered terminal input. A sequence cut short by the
+ * end of a read stays buffered until the next read completes it, unless it
+ * fills the whole buffer.
+ * @param in Input buffer of ANSI_IN_SIZE bytes.
+ * @param len Number of buffered bytes, reduced by the bytes taken.
+ * @param key Set to the key code in ncurses notation, ERR - unknown sequence.
+ * @return 1 - bytes taken, 0 - no complete key is buffered.
+ */
+int ansi_take_key(unsigned char *in, int *len, int *key) {
+  int used = 0;
+  *key = ERR;
+  if (*len > 0) *key = ansi_decode_key(in, *len, &used);
+  if (used == 0) {
+    *key = ERR;
+    if (*len == ANSI_IN_SIZE) used = *len;
+  }
+  *len -= used;
+  memmove(in, in + used, *len);
+  return used > 0;
+}
+
+/**
+ * Decode the first key in a raw terminal input sequence.
+ * @param in Raw input bytes.
+ * @param len Number of input bytes, at least 1.
+ * @param used Set to the number of bytes the key occupies, 0 - the escape
+ * sequence is cut short and needs more bytes.
+ * @return Key code in ncurses notation.
+ */
+int ansi_decode_key(const unsigned char *in, int len, int *used) {
+  int key = in[0];
+  int csi = in[0] == ANSI_ESC && len >= 2 && (in[1] == '[' || in[1] == 'O');
+  *used = 1;
+  if (in[0] == ANSI_ESC && (len == 1 || (csi && len == 2))) {
+    *used = 0;
+  } else if (csi) {
+    *used = 3;
+    switch (in[2]) {
+      case 'A':
+        key = KEY_UP;
+        break;
+      case 'B':
+        key = KEY_DOWN;
+        break;
+      case 'C':
+        key = KEY_RIGHT;
+        break;
+      case 'D':
+        key = KEY_LEFT;
+        break;
+      default:
+        key = ERR;
+        while (*used < len && (in[*used - 1] < '@' || in[*used - 1] > '~'))
+          (*used)++;
+        if (in[*used - 1] < '@' || in[*used - 1] > '~') *used = 0;
+        break;
+    }
+  } else if (in[0] == '\r') {
+    key = ENTER_KEY;
+  }
+  return key;
+}
+
+/**
+ * Convert a figure color to the 256-color terminal palette.
+ * @param color Figure color (COLOR_RED, COLOR_ORANGE, ...).
+ * @return Palette index, 0 - default terminal color.
+ */
+int ansi_color(int color) {
+  int res = 0;
+  switch (color) {
+    case COLOR_RED:
+      res = 196;
+      break;
+    case COLOR_GREEN:
+      res = 40;
+      break;
+    case COLOR_BLUE:
+      res = 27;
+      break;
+    case COLOR_CYAN:
+      res = 44;
+      break;
+    case COLOR_ORANGE:
+      res = 208;
+      break;
+    case COLOR_YELLOW_:
+      res = 226;
+      break;
+    case COLOR_VIOLET:
+      res = 93;
+      break;
+    case COLOR_GARBAGE:
+      res = 250;
+      break;
+  }
+  return res;
+}
+
+/**
+ * Clear the back buffer.
+ */
+void ansi_clear() {
+  AnsiScreen *screen = get_ansi_screen();
+  for (int i = 0; i < ANSI_ROWS; i++) {
+    for (int j = 0; j < ANSI_COLS; j++) {
+      AnsiCell *cell = &screen->cells[i][j];
+      cell->glyph[0] = ' ';
+      cell->glyph[1] = '\0';
+      cell->color = 0;
+      cell->attr = 0;
+    }
+  }
+}
+
+/**
+ * Write UTF-8 text to the back buffer, one character per cell. Fullwidth
+ * forms take two cells.
+ * @param y Screen row.
+ * @param x Screen column.
+ * @param text Text to write.
+ * @param color Figure color or 0.
+ * @param attr Cell attributes (ANSI_BLINK).
+ */
+void ansi_put(int y, int x, const char *text, int color, int attr) {
+  AnsiScreen *screen = get_ansi_screen();
+  const unsigned char *s = (const unsigned char *)text;
+  while (*s && y >= 0 && y < ANSI_ROWS && x < ANSI_COLS) {
+    int len = *s >= 0xE0 ? 3 : (*s >= 0xC0 ? 2 : 1);
+    int wide = len == 3 && s[0] == 0xEF && s[1] >= 0xBC;
+    if (x >= 0) {
+      AnsiCell *cell = &screen->cells[y][x];
+      memcpy(cell->glyph, s, len);
+      cell->glyph[len] = '\0';
+      cell->color = color;
+      cell->attr = attr;
+      if (wide && x + 1 < ANSI_COLS) cell[1].glyph[0] = '\0';
+    }
+    x += wide ? 2 : 1;
+    s += len;
+  }
+}
+
+/**
+ * Build the terminal output for every row changed since the last frame and
+ * send it with a single write().
+ */
+void ansi_flush() {
+  AnsiScreen *screen = get_ansi_screen();
+  int len = 0;
+  int color = -1;
+  int attr = -1;
+  for (int i = 0; i < ANSI_ROWS; i++) {
+    if (!screen->full_redraw && memcmp(screen->cells[i], screen->shown[i],
+                                       sizeof(screen->cells[i])) == 0)
+      continue;
+    len += sprintf(screen->out + len, "\033[%d;1H", i + 1);
+    for (int j = 0; j < ANSI_COLS; j++) {
+      AnsiCell *cell = &screen->cells[i][j];
+      if (cell->color != color || cell->attr != attr) {
+        color = cell->color;
+        attr = cell->attr;
+        len += sprintf(screen->out + len, "\033[0%s", attr ? ";5" : "");
+        if (color)
+          len += sprintf(screen->out + len, ";38;5;%d", ansi_color(color));
+        screen->out[len++] = 'm';
+      }
+      for (const char *g = cell->glyph; *g; g++) screen->out[len++] = *g;
+    }
+  }
+  memcpy(screen->shown, screen->cells, sizeof(screen->shown));
+  screen->full_redraw = 0;
+  if (len > 0) ansi_write(screen->out, len);
+}
+
+/**
+ * Write the whole buffer to the terminal.
+ * @param buf Bytes to write.
+ * @param len Number of bytes.
+ */
+void ansi_write(const char *buf, int len) {
+  for (int sent = 0; sent < len;) {
+    ssize_t n = write(STDOUT_FILENO, buf + sent, len - sent);
+    if (n <= 0) break;
+    sent += (int)n;
+  }
+}
+
+/**
+ * Return how long the input poll may wait before the next frame is due.
+ * @param game Main game structure.
+ * @return Timeout in milliseconds for ansi_getch().
+ */
+int ansi_frame_timeout(GameInfo_t *game) {
+  long long due = game_due(game);
+  return due > 0 ? (int)(due / 1000) : (int)due;
+}
+
+/**
+ * Compose the game screen for the current game state and send it to the
+ * terminal.
+ */
+void ansi_print_game_screen(GameInfo_t game) {
+  ansi_clear();
+  ansi_print_box(0, F_Y_START + HEIGHT + 1, 0, ANSI_COLS - 1);
+  if (game.state == START) {
+    ansi_print_start_screen();
+  } else {
+    ansi_print_box(1, F_Y_START + HEIGHT, 2, F_X_START + WIDTH * CELL_SIZE);
+    ansi_print_field(game);
+    if (game.state == GAMEOVER) {
+      ansi_print_game_over(game);
+    } else {
+      ansi_print_stats(game);
+    }
+    if (game.state == PAUSE) ansi_print_pause(game);
+  }
+  ansi_flush();
+}
+
+/**
+ * Write the pause label and the rewind position of the game.
+ */
+void ansi_print_pause(GameInfo_t game) {
+  char line[32];
+  int x = F_X_START + WIDTH * CELL_SIZE + 3;
+  ansi_put(F_Y_START + 12, x, "PAUSE", 0, ANSI_BLINK);
+  if (game.rewind != NULL) {
+    ansi_put(F_Y_START + 13, x, "<   >  -  rewind", 0, 0);
+    sprintf(line, "STEP: %d/%d", game.rewind->pos + 1, game.rewind->count);
+    ansi_put(F_Y_START + 14, x, line, 0, 0);
+  }
+}
+
+void ansi_print_box(int top_y, int bottom_y, int left_x, int right_x) {
+  for (int i = top_y + 1; i < bottom_y; i++) {
+    ansi_put(i, left_x, "│", 0, 0);
+    ansi_put(i, right_x, "│", 0, 0);
+  }
+  for (int i = left_x + 1; i < right_x; i++) {
+    ansi_put(top_y, i, "─", 0, 0);
+    ansi_put(bottom_y, i, "─", 0, 0);
+  }
+  ansi_put(top_y, left_x, "┌", 0, 0);
+  ansi_put(top_y, right_x, "┐", 0, 0);
+  ansi_put(bottom_y, left_x, "└", 0, 0);
+  ansi_put(bottom_y, right_x, "┘", 0, 0);
+}
+
+/**
+ * Write the game field and the current figure to the back buffer.
+ */
+void ansi_print_field(GameInfo_t game) {
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      if (game.field[i][j] != 0)
+        ansi_put(F_Y_START + i, F_X_START + j * CELL_SIZE, CELL,
+                 game.field[i][j], 0);
+    }
+  }
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      if (game.current.view[i][j] != 0 && game.current.y + i >= 0)
+        ansi_put(F_Y_START + game.current.y + i,
+                 F_X_START + (game.current.x + j) * CELL_SIZE, CELL,
+                 game.current.view[i][j], 0);
+    }
+  }
+}
+
+void ansi_print_figure(Tetramino figure, int y, int x) {
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      if (figure.view[i][j] != 0)
+        ansi_put(y + i, x + j * CELL_SIZE, CELL, figure.view[i][j], 0);
+    }
+  }
+}
+
+void ansi_print_stats(GameInfo_t game) {
+  char line[32];
+  int x = F_X_START + WIDTH * CELL_SIZE + 3;
+  sprintf(line, "SCORE: %d", game.score);
+  ansi_put(F_Y_START, x, line, 0, 0);
+  sprintf(line, "HIGH SCORE: %d", game.high_score);
+  ansi_put(F_Y_START + 2, x, line, 0, 0);
+  sprintf(line, "LEVEL: %d", game.level);
+  ansi_put(F_Y_START + 4, x, line, 0, 0);
+  ansi_put(F_Y_START + 6, x, "NEXT:", 0, 0);
+  ansi_print_figure(game.next, F_Y_START + 8, x);
+  ansi_put(F_Y_START + 15, x, "<   >  -  move", 0, 0);
+  ansi_put(F_Y_START + 16, x, "  V    -  drop", 0, 0);
+  ansi_put(F_Y_START + 17, x, "SPACE  -  rotate", 0, 0);
+  ansi_put(F_Y_START + 18, x, "  p    -  pause", 0, 0);
+  ansi_put(F_Y_START + 19, x, "  q    -  exit", 0, 0);
+}
+
+void ansi_print_start_screen() {
+  Start_screen_figures *figures = get_screen_figures();
+  int w = ANSI_COLS - 1;
+  int x = (w - 45) / 2 + 1;
+  ansi_put(8, x, " _______ ______ _______ _____  _____  _____ ", 0, 0);
+  ansi_put(9, x, "|__   __|  ____|__   __|  __ \\|_   _|/ ____|", 0, 0);
+  ansi_put(10, x, "   | |  | |__     | |  | |__) | | | | (___  ", 0, 0);
+  ansi_put(11, x, "   | |  |  __|    | |  |  _  /  | |  \\___ \\ ", 0, 0);
+  ansi_put(12, x, "   | |  | |____   | |  | | \\ \\ _| |_ ____) |", 0, 0);
+  ansi_put(13, x, "   |_|  |______|  |_|  |_|  \\_\\_____|_____/ ", 0, 0);
+
+  ansi_print_figure(figures->fig1, 3, w / 6 - 4);
+  ansi_print_figure(figures->fig2, 5, w / 6 * 2 - 3);
+  ansi_print_figure(figures->fig3, 2, w / 6 * 3 - 3);
+  ansi_print_figure(figures->fig4, 6, w / 6 * 4 - 3);
+  ansi_print_figure(figures->fig5, 2, w / 6 * 5 - 3);
+  ansi_print_figure(figures->fig6, 15, w / 4 - 5);
+  ansi_print_figure(figures->fig7, 17, w / 4 * 2 - 3);
+  ansi_print_figure(figures->fig8, 16, w / 4 * 3 - 2);
+
+  ansi_put(HEIGHT, w / 2 - 9, "ENTER - start game", 0, ANSI_BLINK);
+  ansi_put(HEIGHT + 1, w / 2 - 9, "    q - exit", 0, ANSI_BLINK);
+}
+
+void ansi_print_game_over(GameInfo_t game) {
+  char line[32];
+  int x = F_X_START + WIDTH * CELL_SIZE + 3;
+  sprintf(line, "SCORE: %d", game.score);
+  ansi_put(F_Y_START, x, line, 0, 0);
+  sprintf(line, "HIGH SCORE: %d", game.high_score);
+  ansi_put(F_Y_START + 2, x, line, 0, 0);
+  ansi_put(6, x, "[GAME OVER]", COLOR_BLUE, 0);
+  ansi_put(8, x, "            ____  ", COLOR_ORANGE, 0);
+  ansi_put(9, x, "         / >     >", COLOR_ORANGE, 0);
+  ansi_put(10, x, "        |   _   _|", COLOR_ORANGE, 0);
+  ansi_put(11, x, "        / == _x ==", COLOR_ORANGE, 0);
+  ansi_put(12, x, "       /         |", COLOR_ORANGE, 0);
+  ansi_put(13, x, "      /  \\      / ", COLOR_ORANGE, 0);
+  ansi_put(14, x, "   / ￣|  |  |  | ", COLOR_ORANGE, 0);
+  ansi_put(15, x, "  | (_￣\\__\\_)_) ", COLOR_ORANGE, 0);
+  ansi_put(16, x, "   \\__)", COLOR_ORANGE, 0);
+  if (game.finesse != NULL) {
+    sprintf(line, "WASTED KEYS: %d", game.finesse->summary.wasted);
+    ansi_put(17, x, line, 0, 0);
+  }
+  ansi_put(18, x, "TRY AGAIN?", 0, ANSI_BLINK);
+  ansi_put(20, x, "ENTER  -  YES", 0, 0);
+  ansi_put(21, x, "  q    -  NO", 0, 0);
+}
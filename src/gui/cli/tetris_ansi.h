@@ -0,0 +1,61 @@
+#ifndef TETRIS_ANSI_H
+#define TETRIS_ANSI_H
+
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "tetris_frontend.h"
+
+// screen size in terminal cells
+#define ANSI_ROWS (F_Y_START + HEIGHT + 2)
+#define ANSI_COLS ((int)(F_X_START + WIDTH * (sizeof(CELL) - 1) * 2 + 7))
+#define ANSI_OUT_SIZE (ANSI_ROWS * ANSI_COLS * 24)
+#define ANSI_IN_SIZE 64
+
+// cell attributes
+#define ANSI_BLINK 1
+
+// escape key code
+#define ANSI_ESC 27
+
+typedef struct {
+  char glyph[4];
+  unsigned char color;
+  unsigned char attr;
+} AnsiCell;
+
+typedef struct {
+  AnsiCell cells[ANSI_ROWS][ANSI_COLS];
+  AnsiCell shown[ANSI_ROWS][ANSI_COLS];
+  char out[ANSI_OUT_SIZE];
+  unsigned char in[ANSI_IN_SIZE];
+  int in_len;
+  int full_redraw;
+  struct termios saved;
+} AnsiScreen;
+
+AnsiScreen *get_ansi_screen();
+void ansi_init();
+void ansi_end();
+int ansi_getch(int timeout_ms);
+int ansi_take_key(unsigned char *in, int *len, int *key);
+int ansi_decode_key(const unsigned char *in, int len, int *used);
+int ansi_color(int color);
+int ansi_frame_timeout(GameInfo_t *game);
+
+void ansi_clear();
+void ansi_put(int y, int x, const char *text, int color, int attr);
+void ansi_flush();
+void ansi_write(const char *buf, int len);
+
+void ansi_print_game_screen(GameInfo_t game);
+void ansi_print_pause(GameInfo_t game);
+void ansi_print_box(int top_y, int bottom_y, int left_x, int right_x);
+void ansi_print_field(GameInfo_t game);
+void ansi_print_figure(Tetramino figure, int y, int x);
+void ansi_print_stats(GameInfo_t game);
+void ansi_print_start_screen();
+void ansi_print_game_over(GameInfo_t game);
+
+#endif
@@ -1,3 +1,5 @@
+#define _DEFAULT_SOURCE
+
 #include "tetris_frontend.h"
 
 /**
@@ -13,190 +15,451 @@ void ncurses_init() {
   nodelay(stdscr, TRUE);
   init_colors();
   init_start_screen_figures();
+  layers_init();
+  signal(SIGWINCH, on_resize);
 }
 
 /**
- * Print game screen based on the current game state in console.
+ * Draw the game screen and send it to the terminal.
  */
 void print_game_screen(GameInfo_t game) {
-  print_main_frame();
-  switch (game.state) {
+  compose_game_screen(&game);
+  doupdate();
+}
+
+/**
+ * Composite the game screen into the virtual screen without writing to the
+ * terminal: the static layer is redrawn only when the screen kind changes,
+ * the field and stats layers every frame.
+ * @param game Game to draw.
+ */
+void compose_game_screen(const GameInfo_t *game) {
+  Layers_t *layers = get_layers();
+  int kind = screen_kind(game->state);
+  if (layers->frame == NULL) {
+    erase();
+    mvprintw(0, 0, "Terminal is too small: %dx%d needed", SCREEN_COLS,
+             SCREEN_ROWS);
+    wnoutrefresh(stdscr);
+  } else {
+    if (kind != layers->kind) {
+      werase(layers->frame);
+      print_static_layer(layers->frame, kind, game);
+      wnoutrefresh(layers->frame);
+      layers->kind = kind;
+    }
+    if (kind != LAYER_START) {
+      werase(layers->field);
+      print_field(layers->field, game);
+      print_tetramino(layers->field, game->current);
+      wnoutrefresh(layers->field);
+    }
+    if (kind == LAYER_PLAY) {
+      werase(layers->panel);
+      print_stats(layers->panel, game);
+      wnoutrefresh(layers->panel);
+    }
+  }
+}
+
+/**
+ * Return the static layer a game state is shown with.
+ * @param state Game state.
+ */
+int screen_kind(GameState_t state) {
+  int kind = LAYER_PLAY;
+  switch (state) {
     case START:
-      print_start_screen();
-      break;
-    case PAUSE:
-      print_playing_field_frame();
-      print_pause();
-      print_field(game);
-      print_stats(game);
-      print_tetramino(game.current);
+      kind = LAYER_START;
       break;
     case GAMEOVER:
-      print_playing_field_frame();
-      print_field(game);
-      print_tetramino(game.current);
-      print_game_over(game);
+      kind = LAYER_GAMEOVER;
       break;
     default:
-      print_playing_field_frame();
-      print_field(game);
-      print_stats(game);
-      print_tetramino(game.current);
       break;
   }
+  return kind;
+}
+
+/**
+ * Return a pointer to the screen layers.
+ */
+Layers_t *get_layers() {
+  static Layers_t layers = {0};
+  return &layers;
+}
+
+/**
+ * Compute the layout for the terminal size and create the layer windows. The
+ * game is centered in the terminal, the windows are not created if it does
+ * not fit.
+ */
+void layers_init() {
+  Layers_t *layers = get_layers();
+  Layout_t *layout = &layers->layout;
+  layers_free();
+  layout->top = LINES > SCREEN_ROWS ? (LINES - SCREEN_ROWS) / 2 : 0;
+  layout->left = COLS > SCREEN_COLS ? (COLS - SCREEN_COLS) / 2 : 0;
+  layout->panel_x = F_X_START + WIDTH * CELL_SIZE + 3;
+  layout->logo_x = (SCREEN_COLS - 1 - 45) / 2 + 1;
+  layout->hint_x = (SCREEN_COLS - 1) / 2 - 9;
+  for (int i = 0; i < 8; i++) {
+    static const int shift[] = {-4, -3, -3, -3, -3, -5, -3, -2};
+    int column = i < 5 ? (SCREEN_COLS - 1) / 6 * (i + 1)
+                       : (SCREEN_COLS - 1) / 4 * (i - 4);
+    layout->figure_x[i] = column + shift[i];
+  }
+  if (LINES >= SCREEN_ROWS && COLS >= SCREEN_COLS) {
+    layers->frame = newwin(SCREEN_ROWS, SCREEN_COLS, layout->top, layout->left);
+    layers->field = newwin(HEIGHT, WIDTH * CELL_SIZE, layout->top + F_Y_START,
+                           layout->left + F_X_START);
+    layers->panel = newwin(PANEL_ROWS, SCREEN_COLS - 1 - layout->panel_x,
+                           layout->top + F_Y_START,
+                           layout->left + layout->panel_x);
+  }
+  layers->kind = LAYER_NONE;
+  clear();
+  refresh();
+}
+
+/**
+ * Delete the layer windows.
+ */
+void layers_free() {
+  Layers_t *layers = get_layers();
+  if (layers->panel != NULL) delwin(layers->panel);
+  if (layers->field != NULL) delwin(layers->field);
+  if (layers->frame != NULL) delwin(layers->frame);
+  layers->panel = NULL;
+  layers->field = NULL;
+  layers->frame = NULL;
 }
 
-void print_playing_field_frame() {
-  print_box(1, F_Y_START + HEIGHT, 2, F_X_START + WIDTH * CELL_SIZE);
+/**
+ * Return a pointer to the flag set by the SIGWINCH handler.
+ */
+volatile sig_atomic_t *get_resize_flag() {
+  static volatile sig_atomic_t resized = 0;
+  return &resized;
 }
 
-void print_main_frame() {
-  print_box(0, F_Y_START + HEIGHT + 1, 0,
-            F_X_START + (WIDTH * CELL_SIZE) * 2 + 6);
+/**
+ * SIGWINCH handler, the layout is rebuilt by the main loop.
+ */
+void on_resize(int sig) {
+  *get_resize_flag() = 1;
+  (void)sig;
 }
 
-void print_start_screen() {
+/**
+ * Rebuild the layers if the terminal was resized since the last call.
+ * @return 1 - layers rebuilt, 0 - no resize.
+ */
+int layers_update() {
+  volatile sig_atomic_t *resized = get_resize_flag();
+  int res = *resized != 0;
+  if (res) {
+    struct winsize size;
+    *resized = 0;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0)
+      resizeterm(size.ws_row, size.ws_col);
+    layers_init();
+  }
+  return res;
+}
+
+/**
+ * Draw the static layer of a screen kind.
+ * @param win Static layer window.
+ * @param kind Screen kind.
+ * @param game Game shown, the game over screen keeps its final score.
+ */
+void print_static_layer(WINDOW *win, int kind, const GameInfo_t *game) {
+  print_box(win, 0, SCREEN_ROWS - 1, 0, SCREEN_COLS - 1);
+  if (kind == LAYER_START) {
+    print_start_screen(win);
+  } else {
+    print_box(win, 1, F_Y_START + HEIGHT, 2, F_X_START + WIDTH * CELL_SIZE);
+    if (kind == LAYER_GAMEOVER)
+      print_game_over(win, game);
+    else
+      print_help(win);
+  }
+}
+
+void print_start_screen(WINDOW *win) {
   Start_screen_figures *figures = get_screen_figures();
-  mvprintw(8, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           " _______ ______ _______ _____  _____  _____ ");
-  mvprintw(9, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           "|__   __|  ____|__   __|  __ \\|_   _|/ ____|");
-  mvprintw(10, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           "   | |  | |__     | |  | |__) | | | | (___  ");
-  mvprintw(11, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           "   | |  |  __|    | |  |  _  /  | |  \\___ \\ ");
-  mvprintw(12, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           "   | |  | |____   | |  | | \\ \\ _| |_ ____) |");
-  mvprintw(13, ((F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) - 45) / 2 + 1,
-           "   |_|  |______|  |_|  |_|  \\_\\_____|_____/ ");
-
-  print_next(figures->fig1, 3,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 6 - 4);
-  print_next(figures->fig2, 5,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 6 * 2 - 3);
-  print_next(figures->fig3, 2,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 6 * 3 - 3);
-  print_next(figures->fig4, 6,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 6 * 4 - 3);
-  print_next(figures->fig5, 2,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 6 * 5 - 3);
-
-  print_next(figures->fig6, 15,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 4 - 5);
-  print_next(figures->fig7, 17,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 4 * 2 - 3);
-  print_next(figures->fig8, 16,
-             (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 4 * 3 - 2);
-
-  attron(A_BLINK);
-  mvprintw(HEIGHT, (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 2 - 9,
-           "ENTER - start game");
-  mvprintw(HEIGHT + 1, (F_X_START + (WIDTH * CELL_SIZE) * 2 + 6) / 2 - 9,
-           "    q - exit");
-  attroff(A_BLINK);
-}
-
-void print_pause() {
-  attron(A_BLINK);
-  mvprintw(F_Y_START + 12, F_X_START + WIDTH * CELL_SIZE + 3, "PAUSE");
-  attroff(A_BLINK);
-}
-
-void print_box(int top_y, int bottom_y, int left_x, int right_x) {
-  for (int i = top_y + 1; i < bottom_y; i++) {
-    mvaddch(i, left_x, ACS_VLINE);
-    mvaddch(i, right_x, ACS_VLINE);
+  Layout_t *layout = &get_layers()->layout;
+  const Tetramino *figs[] = {&figures->fig1, &figures->fig2, &figures->fig3,
+                             &figures->fig4, &figures->fig5, &figures->fig6,
+                             &figures->fig7, &figures->fig8};
+  const int figure_y[] = {3, 5, 2, 6, 2, 15, 17, 16};
+  mvwprintw(win, 8, layout->logo_x,
+            " _______ ______ _______ _____  _____  _____ ");
+  mvwprintw(win, 9, layout->logo_x,
+            "|__   __|  ____|__   __|  __ \\|_   _|/ ____|");
+  mvwprintw(win, 10, layout->logo_x,
+            "   | |  | |__     | |  | |__) | | | | (___  ");
+  mvwprintw(win, 11, layout->logo_x,
+            "   | |  |  __|    | |  |  _  /  | |  \\___ \\ ");
+  mvwprintw(win, 12, layout->logo_x,
+            "   | |  | |____   | |  | | \\ \\ _| |_ ____) |");
+  mvwprintw(win, 13, layout->logo_x,
+            "   |_|  |______|  |_|  |_|  \\_\\_____|_____/ ");
+  for (int i = 0; i < 8; i++)
+    print_next(win, *figs[i], figure_y[i], layout->figure_x[i]);
+
+  wattron(win, A_BLINK);
+  mvwprintw(win, HEIGHT, layout->hint_x, "ENTER - start game");
+  mvwprintw(win, HEIGHT + 1, layout->hint_x, "    q - exit");
+  wattroff(win, A_BLINK);
+}
+
+/**
+ * Print the pause label and the rewind position of the game.
+ * @param win Panel window.
+ * @param game Paused game.
+ */
+void print_pause(WINDOW *win, const GameInfo_t *game) {
+  wattron(win, A_BLINK);
+  mvwprintw(win, 12, 0, "PAUSE");
+  wattroff(win, A_BLINK);
+  if (game->rewind != NULL) {
+    mvwprintw(win, 13, 0, "<   >  -  rewind");
+    mvwprintw(win, 14, 0, "STEP: %d/%d", game->rewind->pos + 1,
+              game->rewind->count);
   }
-  for (int i = left_x + 1; i < right_x; i++) {
-    mvaddch(top_y, i, ACS_HLINE);
-    mvaddch(bottom_y, i, ACS_HLINE);
+}
+
+void print_box(WINDOW *win, int top_y, int bottom_y, int left_x, int right_x) {
+  mvwhline(win, top_y, left_x + 1, ACS_HLINE, right_x - left_x - 1);
+  mvwhline(win, bottom_y, left_x + 1, ACS_HLINE, right_x - left_x - 1);
+  mvwvline(win, top_y + 1, left_x, ACS_VLINE, bottom_y - top_y - 1);
+  mvwvline(win, top_y + 1, right_x, ACS_VLINE, bottom_y - top_y - 1);
+  mvwaddch(win, top_y, left_x, ACS_ULCORNER);
+  mvwaddch(win, top_y, right_x, ACS_URCORNER);
+  mvwaddch(win, bottom_y, left_x, ACS_LLCORNER);
+  mvwaddch(win, bottom_y, right_x, ACS_LRCORNER);
+}
+
+/**
+ * Print the game field with its top left cell at the window origin.
+ * @param win Window to print to.
+ * @param game Game to print.
+ */
+void print_field(WINDOW *win, const GameInfo_t *game) {
+  for (int i = 0; i < HEIGHT; i++)
+    print_cells(win, game->field[i], WIDTH, i, 0);
+}
+
+/**
+ * Print a figure in field coordinates, the field starts at the window origin.
+ * @param win Window to print to.
+ * @param figure Figure to print.
+ */
+void print_tetramino(WINDOW *win, Tetramino figure) {
+  for (int i = 0; i < FIGURE_SIZE; i++) {
+    if (figure.y + i >= 0)
+      print_cells(win, figure.view[i], FIGURE_SIZE, figure.y + i,
+                  figure.x * CELL_SIZE);
   }
-  mvaddch(top_y, left_x, ACS_ULCORNER);
-  mvaddch(top_y, right_x, ACS_URCORNER);
-  mvaddch(bottom_y, left_x, ACS_LLCORNER);
-  mvaddch(bottom_y, right_x, ACS_LRCORNER);
-}
-
-void print_field(GameInfo_t game) {
-  for (int i = 0; i < HEIGHT; i++) {
-    for (int j = 0; j < WIDTH; j++) {
-      if (game.field[i][j] != 0) {
-        attron(COLOR_PAIR(game.field[i][j]));
-        mvprintw(F_Y_START + i, F_X_START + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(game.field[i][j]));
-      }
+}
+
+/**
+ * Print a row of cells, every run of cells of one color is written with one
+ * color change and one prebuilt string.
+ * @param win Window to print to.
+ * @param cells Cell colors, 0 - empty cell.
+ * @param count Number of cells, at most WIDTH.
+ * @param y Window row.
+ * @param x Window column of the first cell.
+ */
+void print_cells(WINDOW *win, const int *cells, int count, int y, int x) {
+  for (int j = 0; j < count;) {
+    int start = j;
+    while (++j < count && cells[j] == cells[start])
+      ;
+    if (cells[start] != 0) {
+      wcolor_set(win, cells[start], NULL);
+      mvwaddstr(win, y, x + start * CELL_SIZE, cell_run(j - start));
     }
   }
+  wcolor_set(win, 0, NULL);
 }
 
-void print_tetramino(Tetramino figure) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      if (figure.view[i][j] != 0 && figure.y + i >= 0) {
-        attron(COLOR_PAIR(figure.view[i][j]));
-        mvprintw(F_Y_START + figure.y + i,
-                 F_X_START + figure.x * CELL_SIZE + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(figure.view[i][j]));
-      }
+/**
+ * Return a string of the given number of cells.
+ * @param length Number of cells, 1 to WIDTH.
+ */
+const char *cell_run(int length) {
+  static char runs[WIDTH + 1][WIDTH * sizeof(CELL)] = {{0}};
+  if (runs[1][0] == '\0') {
+    for (int n = 1; n <= WIDTH; n++) {
+      for (int j = 0; j < n; j++) strcpy(runs[n] + j * CELL_SIZE, CELL);
     }
   }
+  return runs[length];
 }
 
-void print_stats(GameInfo_t game) {
-  mvprintw(F_Y_START, F_X_START + WIDTH * CELL_SIZE + 3, "SCORE: %d",
-           game.score);
-  mvprintw(F_Y_START + 2, F_X_START + WIDTH * CELL_SIZE + 3, "HIGH SCORE: %d",
-           game.high_score);
-  mvprintw(F_Y_START + 4, F_X_START + WIDTH * CELL_SIZE + 3, "LEVEL: %d",
-           game.level);
-  mvprintw(F_Y_START + 6, F_X_START + WIDTH * CELL_SIZE + 3, "NEXT:");
-  print_next(game.next, F_Y_START + 8, F_X_START + WIDTH * CELL_SIZE + 3);
-  mvprintw(F_Y_START + 15, F_X_START + WIDTH * CELL_SIZE + 3, "<   >  -  move");
-  mvprintw(F_Y_START + 16, F_X_START + WIDTH * CELL_SIZE + 3, "  V    -  drop");
-  mvprintw(F_Y_START + 17, F_X_START + WIDTH * CELL_SIZE + 3,
-           "SPACE  -  rotate");
-  mvprintw(F_Y_START + 18, F_X_START + WIDTH * CELL_SIZE + 3,
-           "  p    -  pause");
-  mvprintw(F_Y_START + 19, F_X_START + WIDTH * CELL_SIZE + 3, "  q    -  exit");
-}
-
-void print_next(Tetramino figure, int y, int x) {
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      if (figure.view[i][j] != 0) {
-        attron(COLOR_PAIR(figure.view[i][j]));
-        mvprintw(y + i, x + j * CELL_SIZE, CELL);
-        attroff(COLOR_PAIR(figure.view[i][j]));
-      }
+/**
+ * Print the changing stats at the panel window origin.
+ * @param win Panel window.
+ * @param game Game to print.
+ */
+void print_stats(WINDOW *win, const GameInfo_t *game) {
+  mvwprintw(win, 0, 0, "SCORE: %d", game->score);
+  mvwprintw(win, 2, 0, "HIGH SCORE: %d", game->high_score);
+  mvwprintw(win, 4, 0, "LEVEL: %d", game->level);
+  mvwprintw(win, 6, 0, "NEXT:");
+  print_next(win, game->next, 7, 0);
+  if (game->state == PAUSE) print_pause(win, game);
+}
+
+/**
+ * Print the control keys below the panel.
+ * @param win Static layer window.
+ */
+void print_help(WINDOW *win) {
+  int x = get_layers()->layout.panel_x;
+  mvwprintw(win, F_Y_START + 15, x, "<   >  -  move");
+  mvwprintw(win, F_Y_START + 16, x, "  V    -  drop");
+  mvwprintw(win, F_Y_START + 17, x, "SPACE  -  rotate");
+  mvwprintw(win, F_Y_START + 18, x, "  p    -  pause");
+  mvwprintw(win, F_Y_START + 19, x, "  q    -  exit");
+}
+
+/**
+ * Print a figure box without its empty top rows, up to FIGURE_SIZE rows.
+ * @param win Window to print to.
+ * @param figure Figure to print.
+ * @param y Row of the top filled row.
+ * @param x Left column of the box.
+ */
+void print_next(WINDOW *win, Tetramino figure, int y, int x) {
+  int top = FIGURE_SIZE - 1;
+  for (int i = FIGURE_SIZE - 1; i >= 0; i--) {
+    for (int j = 0; j < FIGURE_SIZE; j++) {
+      if (figure.view[i][j] != 0) top = i;
+    }
+  }
+  for (int i = top; i < FIGURE_SIZE; i++)
+    print_cells(win, figure.view[i], FIGURE_SIZE, y + i - top, x);
+}
+
+void print_game_over(WINDOW *win, const GameInfo_t *game) {
+  int x = get_layers()->layout.panel_x;
+  mvwprintw(win, F_Y_START, x, "SCORE: %d", game->score);
+  mvwprintw(win, F_Y_START + 2, x, "HIGH SCORE: %d", game->high_score);
+  wattron(win, COLOR_PAIR(BLUE_P));
+  mvwprintw(win, 6, x, "[GAME OVER]");
+  wattroff(win, COLOR_PAIR(BLUE_P));
+  wattron(win, COLOR_PAIR(ORANGE_P));
+  mvwprintw(win, 8, x, "            ____  ");
+  mvwprintw(win, 9, x, "         / >     >");
+  mvwprintw(win, 10, x, "        |   _   _|");
+  mvwprintw(win, 11, x, "        / == _x ==");
+  mvwprintw(win, 12, x, "       /         |");
+  mvwprintw(win, 13, x, "      /  \\      / ");
+  mvwprintw(win, 14, x, "   / ￣|  |  |  | ");
+  mvwprintw(win, 15, x, "  | (_￣\\__\\_)_) ");
+  mvwprintw(win, 16, x, "   \\__)");
+  wattroff(win, COLOR_PAIR(ORANGE_P));
+  if (game->finesse != NULL)
+    mvwprintw(win, 17, x, "WASTED KEYS: %d", game->finesse->summary.wasted);
+
+  wattron(win, A_BLINK);
+  mvwprintw(win, 18, x, "TRY AGAIN?");
+  wattroff(win, A_BLINK);
+  mvwprintw(win, 20, x, "ENTER  -  YES");
+  mvwprintw(win, 21, x, "  q    -  NO");
+}
+
+/**
+ * Print a framed game field with its current figure.
+ * @param game Game to print.
+ * @param y Top row of the frame.
+ * @param x Left column of the frame.
+ */
+void print_board(GameInfo_t *game, int y, int x) {
+  print_box(stdscr, y, y + HEIGHT + 1, x, x + VS_BOARD_W - 1);
+  for (int i = 0; i < HEIGHT; i++)
+    print_cells(stdscr, game->field[i], WIDTH, y + 1 + i, x + 1);
+  if (game->state != GAMEOVER) {
+    Tetramino *figure = &game->current;
+    for (int i = 0; i < FIGURE_SIZE; i++) {
+      if (figure->y + i >= 0)
+        print_cells(stdscr, figure->view[i], FIGURE_SIZE, y + 1 + figure->y + i,
+                    x + 1 + figure->x * CELL_SIZE);
     }
   }
 }
 
-void print_game_over(GameInfo_t game) {
-  mvprintw(F_Y_START, F_X_START + WIDTH * CELL_SIZE + 3, "SCORE: %d",
-           game.score);
-  mvprintw(F_Y_START + 2, F_X_START + WIDTH * CELL_SIZE + 3, "HIGH SCORE: %d",
-           game.high_score);
-  attron(COLOR_PAIR(BLUE_P));
-  mvprintw(6, F_X_START + WIDTH * CELL_SIZE + 3, "[GAME OVER]");
-  attroff(COLOR_PAIR(BLUE_P));
-  attron(COLOR_PAIR(ORANGE_P));
-  mvprintw(8, F_X_START + WIDTH * CELL_SIZE + 3, "            ____  ");
-  mvprintw(9, F_X_START + WIDTH * CELL_SIZE + 3, "         / >     >");
-  mvprintw(10, F_X_START + WIDTH * CELL_SIZE + 3, "        |   _   _|");
-  mvprintw(11, F_X_START + WIDTH * CELL_SIZE + 3, "        / == _x ==");
-  mvprintw(12, F_X_START + WIDTH * CELL_SIZE + 3, "       /         |");
-  mvprintw(13, F_X_START + WIDTH * CELL_SIZE + 3, "      /  \\      / ");
-  mvprintw(14, F_X_START + WIDTH * CELL_SIZE + 3, "   / ￣|  |  |  | ");
-  mvprintw(15, F_X_START + WIDTH * CELL_SIZE + 3, "  | (_￣\\__\\_)_) ");
-  mvprintw(16, F_X_START + WIDTH * CELL_SIZE + 3, "   \\__)");
-  attroff(COLOR_PAIR(ORANGE_P));
-
-  attron(A_BLINK);
-  mvprintw(18, F_X_START + WIDTH * CELL_SIZE + 3, "TRY AGAIN?");
-  attroff(A_BLINK);
-  mvprintw(20, F_X_START + WIDTH * CELL_SIZE + 3, "ENTER  -  YES");
-  mvprintw(21, F_X_START + WIDTH * CELL_SIZE + 3, "  q    -  NO");
+/**
+ * Print the split-screen versus mode: both boards and the stats between them.
+ * @param match Running match.
+ * @param paused 1 - match is paused.
+ */
+void print_versus_screen(Match_t *match, int paused) {
+  int stats_x = VS_BOARD_W + 3;
+  print_box(stdscr, 0, HEIGHT + 3, 0, VS_BOARD_W * 2 + VS_STATS_W + 3);
+  print_board(&match->players[0], 1, 1);
+  print_board(&match->players[1], 1, VS_BOARD_W + VS_STATS_W + 3);
+  for (int i = 0; i < PLAYERS; i++) {
+    GameInfo_t *game = &match->players[i];
+    int y = 2 + i * 10;
+    mvprintw(y, stats_x, "P%d", i + 1);
+    mvprintw(y + 1, stats_x, "SCORE: %d", game->score);
+    mvprintw(y + 2, stats_x, "LINES: %d", game->lines);
+    mvprintw(y + 3, stats_x, "GARBAGE: %d", game->garbage);
+    print_next(stdscr, game->next, y + 5, stats_x);
+  }
+  if (match->winner != MATCH_RUNNING) {
+    attron(A_BLINK);
+    if (match->winner == MATCH_DRAW)
+      mvprintw(HEIGHT - 1, stats_x, "DRAW");
+    else
+      mvprintw(HEIGHT - 1, stats_x, "P%d WINS", match->winner + 1);
+    attroff(A_BLINK);
+    mvprintw(HEIGHT, stats_x, "ENTER - again");
+  } else if (paused) {
+    attron(A_BLINK);
+    mvprintw(HEIGHT - 1, stats_x, "PAUSE");
+    attroff(A_BLINK);
+  }
+  mvprintw(HEIGHT + 1, stats_x, "p-pause q-exit");
+}
+
+/**
+ * Print the puzzle mode: the field after the given number of solution steps
+ * with the next placement shown in place, the goal, the search result and
+ * the figures left.
+ * @param board Field after the steps, its current figure is the next
+ * placement unless the game is over.
+ * @param puzzle Puzzle.
+ * @param solution Solver result.
+ * @param step Number of placements made.
+ */
+void print_puzzle_screen(GameInfo_t *board, const Puzzle_t *puzzle,
+                         const Solution_t *solution, int step) {
+  int stats_x = VS_BOARD_W + 3;
+  print_box(stdscr, 0, HEIGHT + 3, 0, VS_BOARD_W + PUZZLE_STATS_W + 3);
+  print_board(board, 1, 1);
+  mvprintw(2, stats_x, "PUZZLE");
+  if (puzzle->lines > 0)
+    mvprintw(3, stats_x, "GOAL: %d LINES", puzzle->lines);
+  else
+    mvprintw(3, stats_x, "GOAL: CLEAR ALL");
+  if (solution->found) {
+    mvprintw(5, stats_x, "SOLVED IN %d", solution->length);
+    mvprintw(6, stats_x, "STEP: %d/%d", step, solution->length);
+  } else {
+    mvprintw(5, stats_x, "NO SOLUTION");
+    mvprintw(6, stats_x, "WITHIN %d PIECES", puzzle->count);
+  }
+  mvprintw(8, stats_x, "QUEUE:");
+  mvprintw(9, stats_x, "%.*s", PUZZLE_STATS_W - 2, puzzle->pieces + step);
+  mvprintw(11, stats_x, "NODES: %lld", solution->nodes);
+  mvprintw(HEIGHT + 1, stats_x, "<- -> step q-exit");
 }
 
 /**
@@ -214,6 +477,7 @@ void init_colors() {
   init_pair(CYAN_P, COLOR_CYAN, COLOR_BLACK);
   init_pair(BLUE_P, COLOR_BLUE, COLOR_BLACK);
   init_pair(VIOLET_P, COLOR_VIOLET, COLOR_BLACK);
+  init_pair(GARBAGE_P, COLOR_GARBAGE, COLOR_BLACK);
 }
 
 /**
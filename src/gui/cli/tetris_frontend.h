@@ -1,13 +1,32 @@
 #ifndef TETRIS_FRONTEND_H
 #define TETRIS_FRONTEND_H
 
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
 #include "../../brick_game/tetris/backend/tetris_backend.h"
+#include "../../brick_game/tetris/backend/tetris_finesse.h"
+#include "../../brick_game/tetris/backend/tetris_rewind.h"
+#include "../../brick_game/tetris/backend/tetris_solver.h"
+#include "../../brick_game/tetris/backend/tetris_versus.h"
 #include "../../brick_game/tetris/tetris.h"
 
 // start points for the playing field
 #define F_Y_START 2
 #define F_X_START 3
 
+// screen size and the stats panel height
+#define SCREEN_ROWS (F_Y_START + HEIGHT + 2)
+#define SCREEN_COLS ((int)(F_X_START + WIDTH * CELL_SIZE * 2 + 7))
+#define PANEL_ROWS 15
+
+// static layers
+#define LAYER_NONE -1
+#define LAYER_START 0
+#define LAYER_PLAY 1
+#define LAYER_GAMEOVER 2
+
 // tetramino cells
 #define CELL "[]"
 #define CELL_SIZE strlen(CELL)
@@ -25,6 +44,14 @@
 #define CYAN_P 6
 #define BLUE_P 4
 #define VIOLET_P 10
+#define GARBAGE_P 7
+
+// split-screen layout
+#define VS_BOARD_W (WIDTH * CELL_SIZE + 2)
+#define VS_STATS_W 14
+
+// puzzle mode layout
+#define PUZZLE_STATS_W 20
 
 typedef struct {
   Tetramino fig1;
@@ -37,20 +64,53 @@ typedef struct {
   Tetramino fig8;
 } Start_screen_figures;
 
+// screen positions, computed once and on terminal resize
+typedef struct {
+  int top;
+  int left;
+  int panel_x;
+  int logo_x;
+  int hint_x;
+  int figure_x[8];
+} Layout_t;
+
+// static layer drawn once per screen kind, field and stats drawn every frame
+typedef struct {
+  Layout_t layout;
+  WINDOW *frame;
+  WINDOW *field;
+  WINDOW *panel;
+  int kind;
+} Layers_t;
+
 void ncurses_init();
 void init_colors();
 Start_screen_figures* get_screen_figures();
 void init_start_screen_figures();
-void print_playing_field_frame();
-void print_main_frame();
-void print_field(GameInfo_t game);
-void print_box(int top_y, int bottom_y, int left_x, int right_x);
-void print_stats(GameInfo_t game);
-void print_tetramino(Tetramino figure);
-void print_next(Tetramino figure, int y, int x);
-void print_start_screen();
-void print_pause();
+int screen_kind(GameState_t state);
+Layers_t* get_layers();
+void layers_init();
+void layers_free();
+int layers_update();
+volatile sig_atomic_t* get_resize_flag();
+void on_resize(int sig);
+void print_static_layer(WINDOW* win, int kind, const GameInfo_t* game);
+void print_field(WINDOW* win, const GameInfo_t* game);
+void print_box(WINDOW* win, int top_y, int bottom_y, int left_x, int right_x);
+void print_stats(WINDOW* win, const GameInfo_t* game);
+void print_help(WINDOW* win);
+void print_tetramino(WINDOW* win, Tetramino figure);
+void print_cells(WINDOW* win, const int* cells, int count, int y, int x);
+const char* cell_run(int length);
+void print_next(WINDOW* win, Tetramino figure, int y, int x);
+void print_start_screen(WINDOW* win);
+void print_pause(WINDOW* win, const GameInfo_t* game);
 void print_game_screen(GameInfo_t game);
-void print_game_over(GameInfo_t game);
+void compose_game_screen(const GameInfo_t* game);
+void print_game_over(WINDOW* win, const GameInfo_t* game);
+void print_board(GameInfo_t *game, int y, int x);
+void print_versus_screen(Match_t *match, int paused);
+void print_puzzle_screen(GameInfo_t *board, const Puzzle_t *puzzle,
+                         const Solution_t *solution, int step);
 
 #endif
\ No newline at end of file
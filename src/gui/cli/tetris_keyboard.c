@@ -0,0 +1,54 @@
+#include "tetris_keyboard.h"
+
+/**
+ * Start the input thread: it blocks on the terminal and pushes every key as a
+ * timestamped user action to the queue.
+ * @param keyboard Input thread state.
+ * @param queue Queue the thread produces to.
+ * @return 1 - thread started, 0 - error.
+ */
+int keyboard_start(Keyboard_t *keyboard, InputQueue *queue) {
+  keyboard->queue = queue;
+  atomic_init(&keyboard->stop, 0);
+  keyboard->running =
+      pthread_create(&keyboard->thread, NULL, keyboard_thread, keyboard) == 0;
+  return keyboard->running;
+}
+
+/**
+ * Stop the input thread and wait for it.
+ * @param keyboard Input thread state.
+ */
+void keyboard_stop(Keyboard_t *keyboard) {
+  if (keyboard->running) {
+    atomic_store(&keyboard->stop, 1);
+    pthread_join(keyboard->thread, NULL);
+    keyboard->running = 0;
+  }
+}
+
+/**
+ * Input thread of keyboard_start(). Keys are decoded as soon as the bytes
+ * arrive, so their timestamps do not depend on the main loop. A key split
+ * across reads is stamped with the read that completes it.
+ * @param arg Keyboard_t of the thread.
+ */
+void *keyboard_thread(void *arg) {
+  Keyboard_t *keyboard = arg;
+  unsigned char in[ANSI_IN_SIZE];
+  int len = 0;
+  while (!atomic_load(&keyboard->stop)) {
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    if (poll(&pfd, 1, KEYBOARD_POLL_MS) > 0 && (pfd.revents & POLLIN)) {
+      ssize_t n = read(STDIN_FILENO, in + len, sizeof(in) - len);
+      long long time = get_time_us();
+      int key = ERR;
+      if (n > 0) len += (int)n;
+      while (ansi_take_key(in, &len, &key)) {
+        UserAction_t action = get_action(key);
+        if ((int)action != -1) input_push(keyboard->queue, action, time);
+      }
+    }
+  }
+  return NULL;
+}
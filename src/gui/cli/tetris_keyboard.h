@@ -0,0 +1,29 @@
+#ifndef TETRIS_KEYBOARD_H
+#define TETRIS_KEYBOARD_H
+
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "../../brick_game/tetris/backend/tetris_input.h"
+#include "tetris_ansi.h"
+
+// how often the input thread checks for a stop request, milliseconds
+#define KEYBOARD_POLL_MS 50
+// longest main loop wait for input when no tick is due, milliseconds, keeps
+// resizes and high scores of other processes showing up
+#define FRAME_IDLE_MS 50
+
+// terminal reader thread feeding an input queue
+typedef struct {
+  pthread_t thread;
+  InputQueue *queue;
+  atomic_int stop;
+  int running;
+} Keyboard_t;
+
+int keyboard_start(Keyboard_t *keyboard, InputQueue *queue);
+void keyboard_stop(Keyboard_t *keyboard);
+void *keyboard_thread(void *arg);
+
+#endif
@@ -1,3 +1,8 @@
+#define _XOPEN_SOURCE 700
+
+#include <ftw.h>
+#include <stdlib.h>
+
 #include "test_tetris.h"
 
 START_TEST(nothing) { ck_assert_int_eq(1, 1); }
@@ -36,6 +41,7 @@ START_TEST(stats_test) {
       game->field[i][j] = 1;
     }
   }
+  board_rebuild(&game->board, game->field);
   calculate_score();
   ck_assert_int_eq(game->score, 1500);
   set_level();
@@ -247,10 +253,1639 @@ Suite *fsm_test_suite(void) {
   return s;
 }
 
+START_TEST(gravity_test) {
+  GameInfo_t *game = updateCurrentState();
+  ck_assert_int_eq(GRAVITY_SPEED(level_gravity(LEVEL_MIN)) / 1000, 820);
+  ck_assert_int_eq(GRAVITY_SPEED(level_gravity(LEVEL_MAX)), TICK_US / 20);
+  ck_assert_int_eq(level_gravity(LEVEL_MAX), 20 * G_UNIT);
+  ck_assert_int_eq(level_gravity(LEVEL_MAX + 5), 20 * G_UNIT);
+  ck_assert_int_eq(level_gravity(0), level_gravity(LEVEL_MIN));
+
+  game->timer = 0;
+  game->lag = 0;
+  advance_timer(game, TICK_US / 2);
+  advance_timer(game, TICK_US);
+  ck_assert_int_eq(game->lag, TICK_US);
+  advance_timer(game, TICK_US / 4);
+  ck_assert_int_eq(game->timer, TICK_US);
+  ck_assert_int_eq(game->lag, TICK_US);
+  advance_timer(game, TICK_US * 100);
+  ck_assert_int_eq(game->lag, LAG_MAX);
+
+  reset_field();
+  spawn_state_actions(game);
+  game->gravity = G_UNIT / 4;
+  game->ticks = 0;
+  for (int i = 0; i < 3; i++) {
+    gravity_tick(game);
+    ck_assert_int_eq(game->state, MOVING);
+  }
+  gravity_tick(game);
+  ck_assert_int_eq(game->state, SHIFTING);
+  ck_assert_int_eq(game->ticks, 4);
+  int y = game->current.y;
+  userInput(-1, 0);
+  ck_assert_int_eq(game->current.y, y + 1);
+  ck_assert_int_eq(game->state, MOVING);
+
+  game->gravity = level_gravity(LEVEL_MAX);
+  gravity_tick(game);
+  ck_assert_int_eq(game->state, SHIFTING);
+  userInput(-1, 0);
+  ck_assert_int_eq(collision() & 0b100, 4);
+  ck_assert_int_eq(game->state, MOVING);
+  for (int i = 0; i < LOCK_DELAY - 1; i++) gravity_tick(game);
+  ck_assert_int_eq(game->state, MOVING);
+  gravity_tick(game);
+  ck_assert_int_eq(game->state, SHIFTING);
+  userInput(-1, 0);
+  ck_assert_int_eq(game->state, ATTACHING);
+}
+END_TEST
+
+Suite *gravity_test_suite(void) {
+  Suite *s = suite_create("gravity_test");
+  TCase *tc_gravity_test = tcase_create("gravity_test");
+  tcase_add_test(tc_gravity_test, gravity_test);
+  suite_add_tcase(s, tc_gravity_test);
+  return s;
+}
+
+START_TEST(session_test) {
+  SessionPool pool;
+  pool_init(&pool);
+  ck_assert_int_eq(sizeof(Session_t) % SESSION_ALIGN, 0);
+  ck_assert_int_le(sizeof(Session_t), 192);
+
+  Session_t *sessions[SLAB_SESSIONS + 10];
+  for (int i = 0; i < SLAB_SESSIONS + 10; i++) {
+    sessions[i] = session_create(&pool, i + 1);
+    ck_assert_ptr_nonnull(sessions[i]);
+    ck_assert_int_eq((unsigned long)sessions[i] % SESSION_ALIGN, 0);
+    ck_assert_int_eq(sessions[i]->state, START);
+  }
+  ck_assert_int_eq(pool.live, SLAB_SESSIONS + 10);
+  ck_assert_int_eq(pool.slab_count, 2);
+  Session_t *released = sessions[5];
+  session_destroy(&pool, released);
+  ck_assert(session_create(&pool, 7) == released);
+
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, 42);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  Session_t *session = sessions[0];
+  session_reset(&pool, session, 42);
+  ck_assert_int_eq(session->next.type, game.next.type);
+
+  UserAction_t actions[] = {Left, -1, Action, -1, Right, -1, -1, Down};
+  game_input(&game, Start);
+  game_tick(&game);
+  session_step(session, Start);
+  for (int i = 0; i < 20000 && game.state != GAMEOVER; i++) {
+    UserAction_t action = actions[(i * 7 + i / 13) % 8];
+    game_input(&game, action);
+    game_tick(&game);
+    session_step(session, action);
+  }
+  GameInfo_t loaded;
+  session_load(session, &loaded);
+  ck_assert_int_eq(loaded.score, game.score);
+  ck_assert_int_eq(loaded.ticks, game.ticks);
+  ck_assert_int_eq(loaded.state, game.state);
+  ck_assert_int_eq(loaded.current.x, game.current.x);
+  ck_assert_int_eq(loaded.current.y, game.current.y);
+  ck_assert_int_eq(memcmp(loaded.field, game.field, sizeof(game.field)), 0);
+  ck_assert_int_eq(loaded.board_stale, 1);
+  ck_assert_mem_eq(game_board(&loaded), &game.board, sizeof(game.board));
+  ck_assert_int_eq(loaded.board_stale, 0);
+  ck_assert_int_gt(game.ticks, 100);
+
+  seed_game(&game, 43);
+  prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  game_input(&game, Start);
+  game.sent = COUNTER_MAX + 10;
+  game_input(&game, Down);
+  for (int i = 0; i <= LOCK_DELAY; i++) game_tick(&game);
+  ck_assert_int_eq(game.pieces, 2);
+  ck_assert_int_eq(game.sent, COUNTER_MAX);
+  session_store(&game, session);
+  session_load(session, &loaded);
+  ck_assert_int_eq(loaded.sent, COUNTER_MAX);
+  pool_free(&pool);
+}
+END_TEST
+
+Suite *session_test_suite(void) {
+  Suite *s = suite_create("session_test");
+  TCase *tc_session_test = tcase_create("session_test");
+  tcase_add_test(tc_session_test, session_test);
+  suite_add_tcase(s, tc_session_test);
+  return s;
+}
+
+START_TEST(versus_test) {
+  ck_assert_int_eq(garbage_rows(1), 0);
+  ck_assert_int_eq(garbage_rows(2), 1);
+  ck_assert_int_eq(garbage_rows(3), 2);
+  ck_assert_int_eq(garbage_rows(4), 4);
+
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, 3);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  game.field[HEIGHT - 1][0] = RED_P;
+  game.garbage = 2;
+  raise_garbage();
+  bind_game(prev);
+  ck_assert_int_eq(game.garbage, 0);
+  ck_assert_int_eq(game.field[HEIGHT - 3][0], RED_P);
+  for (int i = HEIGHT - 2; i < HEIGHT; i++) {
+    int holes = 0;
+    for (int j = 0; j < WIDTH; j++) holes += game.field[i][j] == 0;
+    ck_assert_int_eq(holes, 1);
+  }
+
+  Match_t match;
+  match_init(&match, 5);
+  ck_assert_int_ne(match.players[0].rng, match.players[1].rng);
+  for (int i = 0; i < PLAYERS; i++) {
+    GameInfo_t *player = &match.players[i];
+    prev = bind_game(player);
+    reset_field();
+    for (int row = HEIGHT - 3; row < HEIGHT; row++) {
+      for (int j = 0; j < WIDTH; j++)
+        player->field[row][j] = j == 4 || j == 5 ? 0 : RED_P;
+    }
+    board_rebuild(&player->board, player->field);
+    reset_figure(&player->current);
+    make_figure(&player->current, 1);
+    player->current.x = 3;
+    player->current.y = 0;
+    bind_game(prev);
+  }
+  match.players[0].garbage = 2;
+  for (int i = 0; i < PLAYERS; i++) {
+    game_input(&match.players[i], Down);
+    for (int j = 0; j <= LOCK_DELAY; j++) game_tick(&match.players[i]);
+  }
+  ck_assert_int_eq(match.players[0].cleared, 2);
+  ck_assert_int_eq(match.players[0].garbage, 0);
+  ck_assert_int_eq(match.players[0].sent, 0);
+  ck_assert_int_eq(match.players[1].sent, 1);
+  int raised = 0;
+  for (int j = 0; j < WIDTH; j++)
+    raised += match.players[0].field[HEIGHT - 1][j] == COLOR_GARBAGE;
+  ck_assert_int_eq(raised, WIDTH - 1);
+  ck_assert_int_eq(match.players[0].field[HEIGHT - 2][0], RED_P);
+  match_exchange(&match);
+  ck_assert_int_eq(match.players[0].garbage, 1);
+  ck_assert_int_eq(match.players[1].garbage, 0);
+  ck_assert_int_eq(match.sent[0], 0);
+  ck_assert_int_eq(match.sent[1], 1);
+  ck_assert_int_eq(match.players[1].sent, 0);
+
+  Match_t matches[4];
+  for (int i = 0; i < 4; i++) match_init(&matches[i], i + 1);
+  versus_run(matches, 4, 2, 3000);
+  for (int i = 0; i < 4; i++) {
+    ck_assert_int_ne(matches[i].winner, MATCH_RUNNING);
+    ck_assert(matches[i].ticks <= 3000);
+    ck_assert(matches[i].players[0].pieces > 1);
+  }
+}
+END_TEST
+
+Suite *versus_test_suite(void) {
+  Suite *s = suite_create("versus_test");
+  TCase *tc_versus_test = tcase_create("versus_test");
+  tcase_add_test(tc_versus_test, versus_test);
+  suite_add_tcase(s, tc_versus_test);
+  return s;
+}
+
+START_TEST(replay_test) {
+  UserAction_t actions[] = {Left, Right, Action, Down, -1, -1, -1, -1};
+  GameInfo_t game = {0};
+  Recording_t rec;
+  Recording_t loaded;
+  ReplayResult result;
+  char path[512];
+  recording_init(&rec);
+  recording_init(&loaded);
+  srand(7);
+  game.headless = 1;
+  GameInfo_t *prev = bind_game(&game);
+  recording_begin(&rec, &game);
+  stats_init(&game);
+  record_action(&rec, &game, Start);
+  userInput(Start, 0);
+  while (game.state != GAMEOVER) {
+    UserAction_t action = actions[rand() % 8];
+    if (game.state == MOVING) advance_timer(&game, game.timer + rand() % 40000);
+    record_action(&rec, &game, action);
+    userInput(action, 0);
+  }
+  bind_game(prev);
+  recording_finish(&rec, &game);
+  ck_assert(rec.count > 1);
+  ck_assert_int_eq(replay_run(&rec, &result), 1);
+  ck_assert_int_eq(result.score, game.score);
+  ck_assert_int_eq(result.lines, game.lines);
+
+  data_path(path, sizeof(path), "test_replay.replay");
+  ck_assert_int_eq(recording_save(&rec, path), 1);
+  ck_assert_int_eq(recording_load(&loaded, path), 1);
+  remove(path);
+  ck_assert_int_eq(loaded.count, rec.count);
+  ck_assert_int_eq(replay_run(&loaded, &result), 1);
+  loaded.score += 100;
+  ck_assert_int_eq(replay_run(&loaded, &result), 0);
+  data_path(path, sizeof(path), "missing.replay");
+  ck_assert_int_eq(recording_load(&loaded, path), 0);
+  recording_free(&rec);
+  recording_free(&loaded);
+}
+END_TEST
+
+Suite *replay_test_suite(void) {
+  Suite *s = suite_create("replay_test");
+  TCase *tc_replay_test = tcase_create("replay_test");
+  tcase_add_test(tc_replay_test, replay_test);
+  suite_add_tcase(s, tc_replay_test);
+  return s;
+}
+
+static int score_desc(const void *a, const void *b) {
+  return *(const int *)b - *(const int *)a;
+}
+
+START_TEST(leaderboard_test) {
+  const char *dir = "test_leaderboard";
+  int scores[2000];
+  Leaderboard_t board;
+  LeaderRecord record = {0};
+  LeaderRecord top[LEADER_TOP];
+  ck_assert_int_eq(leaderboard_open(&board, dir), 1);
+  ck_assert_int_eq(leaderboard_best(&board), 0);
+  srand(11);
+  for (int i = 0; i < 2000; i++) {
+    scores[i] = rand() % 5000;
+    record.score = scores[i];
+    record.lines = i;
+    int rank = leaderboard_add(&board, &record);
+    ck_assert_int_eq(rank, leaderboard_rank(&board, scores[i]) - 1);
+  }
+  leaderboard_close(&board);
+  qsort(scores, 2000, sizeof(int), score_desc);
+
+  ck_assert_int_eq(leaderboard_open(&board, dir), 1);
+  ck_assert_int_eq(leaderboard_count(&board), 2000);
+  ck_assert_int_eq(leaderboard_best(&board), scores[0]);
+  ck_assert_int_eq(leaderboard_top(&board, top, LEADER_TOP), LEADER_TOP);
+  for (int i = 0; i < LEADER_TOP; i++) ck_assert_int_eq(top[i].score, scores[i]);
+  ck_assert_int_eq(leaderboard_get(&board, 1000, &record), 1);
+  ck_assert_int_eq(record.score, scores[999]);
+  ck_assert_int_eq(leaderboard_get(&board, 2001, &record), 0);
+  ck_assert_int_eq(leaderboard_rank(&board, scores[0] + 1), 1);
+  ck_assert_int_eq(leaderboard_rank(&board, -1), 2001);
+  leaderboard_close(&board);
+
+  remove("test_leaderboard/leaderboard.idx");
+  ck_assert_int_eq(leaderboard_open(&board, dir), 1);
+  ck_assert_int_eq(leaderboard_count(&board), 2000);
+  ck_assert_int_eq(leaderboard_get(&board, 2000, &record), 1);
+  ck_assert_int_eq(record.score, scores[1999]);
+
+  Leaderboard_t other;
+  ck_assert_int_eq(leaderboard_open(&other, dir), 1);
+  for (int i = 0; i < 200; i++) {
+    record.score = 10000 + i;
+    record.lines = i;
+    leaderboard_add(i % 2 ? &other : &board, &record);
+  }
+  ck_assert_int_eq(leaderboard_count(&board), 2200);
+  ck_assert_int_eq(leaderboard_count(&other), 2200);
+  for (int i = 1; i <= 200; i++) {
+    ck_assert_int_eq(leaderboard_get(&other, i, &record), 1);
+    ck_assert_int_eq(record.score, 10200 - i);
+    ck_assert_int_eq(record.lines, 200 - i);
+  }
+  leaderboard_close(&other);
+  leaderboard_close(&board);
+  remove("test_leaderboard/leaderboard.idx");
+  remove("test_leaderboard/leaderboard.log");
+  rmdir(dir);
+}
+END_TEST
+
+Suite *leaderboard_test_suite(void) {
+  Suite *s = suite_create("leaderboard_test");
+  TCase *tc_leaderboard_test = tcase_create("leaderboard_test");
+  tcase_add_test(tc_leaderboard_test, leaderboard_test);
+  suite_add_tcase(s, tc_leaderboard_test);
+  return s;
+}
+
+START_TEST(movegen_test) {
+  static MoveGen_t gen;
+  static Placement placements[PLACEMENTS_MAX];
+  int expected[] = {17, 9, 34, 34, 17, 34, 17};
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, 1);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  for (int i = 0; i < 7; i++) {
+    reset_figure(&game.next);
+    make_figure(&game.next, i);
+    spawn_figure();
+    ck_assert_int_eq(generate_placements(&gen, &game, placements), expected[i]);
+  }
+
+  for (int j = 3; j < WIDTH; j++) game.field[HEIGHT - 3][j] = BLUE_P;
+  board_rebuild(&game.board, game.field);
+  reset_figure(&game.next);
+  make_figure(&game.next, 1);
+  spawn_figure();
+  int count = generate_placements(&gen, &game, placements);
+  int tucked = 0;
+  for (int i = 0; i < count; i++) {
+    Tetramino figure = {0};
+    unpack_figure(&placements[i].figure, &figure);
+    if (figure.x + 2 == WIDTH - 1 && figure.y + 1 == HEIGHT - 1) {
+      int down = 0;
+      tucked = 1;
+      for (int k = 0; k < placements[i].length; k++) {
+        if (placements[i].moves[k] == MOVE_DOWN) down = 1;
+        if (placements[i].moves[k] == MOVE_RIGHT && down) tucked = 2;
+      }
+    }
+  }
+  ck_assert_int_eq(tucked, 2);
+  ck_assert_int_eq(game.current.type, 'O');
+  ck_assert_int_eq(game.current.y, 0);
+
+  reset_field();
+  spawn_figure();
+  bind_game(prev);
+  ck_assert_int_eq(perft(&game, 0), 1);
+  ck_assert_int_eq(perft(&game, 1),
+                   generate_placements(&gen, &game, placements));
+  ck_assert_int_eq(perft(&game, 2), 1182);
+}
+END_TEST
+
+Suite *movegen_test_suite(void) {
+  Suite *s = suite_create("movegen_test");
+  TCase *tc_movegen_test = tcase_create("movegen_test");
+  tcase_add_test(tc_movegen_test, movegen_test);
+  suite_add_tcase(s, tc_movegen_test);
+  return s;
+}
+
+static void *input_producer(void *arg) {
+  InputQueue *queue = arg;
+  for (int i = 0; i < 100000; i++) {
+    while (!input_push(queue, i % (Action + 1), i))
+      ;
+  }
+  return NULL;
+}
+
+START_TEST(input_test) {
+  static InputQueue queue;
+  InputEvent event;
+  pthread_t producer;
+  input_init(&queue);
+  ck_assert_int_eq(input_pop(&queue, &event), 0);
+  for (int i = 0; i < INPUT_QUEUE_SIZE; i++)
+    ck_assert_int_eq(input_push(&queue, Left, i), 1);
+  ck_assert_int_eq(input_push(&queue, Left, 0), 0);
+  for (int i = 0; i < INPUT_QUEUE_SIZE; i++) {
+    ck_assert_int_eq(input_pop(&queue, &event), 1);
+    ck_assert_int_eq(event.time, i);
+  }
+  long long start = get_time_us();
+  ck_assert_int_eq(input_wait(&queue, 20000), 0);
+  ck_assert_int_ge(get_time_us() - start, 20000);
+  pthread_create(&producer, NULL, input_producer, &queue);
+  for (int i = 0; i < 100000;) {
+    if (input_wait(&queue, 10000000) && input_pop(&queue, &event)) {
+      ck_assert_int_eq(event.time, i);
+      ck_assert_int_eq(event.action, i % (Action + 1));
+      i++;
+    }
+  }
+  pthread_join(producer, NULL);
+  ck_assert_int_eq(input_pop(&queue, &event), 0);
+  input_free(&queue);
+
+  GameInfo_t game = {0};
+  seed_game(&game, 9);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  game.input_time = 1000000;
+  game_input(&game, Start);
+  ck_assert_int_eq(game.state, MOVING);
+  ck_assert_int_eq(game.timer, 1000000);
+  game_advance(&game, 1000000 + 5 * TICK_US + 10);
+  ck_assert_int_eq(game.ticks, 5);
+  ck_assert_int_eq(game.lag, 10);
+  game_advance(&game, 1000000 + 5 * TICK_US + 20);
+  ck_assert_int_eq(game.ticks, 5);
+  game.input_time = 0;
+}
+END_TEST
+
+Suite *input_test_suite(void) {
+  Suite *s = suite_create("input_test");
+  TCase *tc_input_test = tcase_create("input_test");
+  tcase_add_test(tc_input_test, input_test);
+  suite_add_tcase(s, tc_input_test);
+  return s;
+}
+
+START_TEST(server_test) {
+  Server_t *server = malloc(sizeof(*server));
+  char reply[SERVER_REPLY_MAX];
+  server_init(server);
+  ck_assert_int_eq(server->game.state, MOVING);
+  ck_assert_int_eq(server_request(server, "start 7", 7, reply), 3);
+  ck_assert_int_eq(memcmp(reply, "ok\n", 3), 0);
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, 7);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  game_input(&game, Start);
+  game_input(&game, Left);
+  game_tick(&game);
+  game_input(&game, Action);
+  for (int i = 0; i < 20; i++) game_tick(&game);
+  int len = server_request(server, "act l.a", 7, reply);
+  reply[len] = 0;
+  ck_assert_str_eq(reply, "ok moving 1 0 0\n");
+  len = server_request(server, "tick 20\r", 8, reply);
+  reply[len] = 0;
+  ck_assert_str_eq(reply, "ok moving 21 0 0\n");
+  ck_assert_int_eq(memcmp(server->game.field, game.field, sizeof(game.field)),
+                   0);
+  ck_assert_int_eq(server->game.current.x, game.current.x);
+  ck_assert_int_eq(server->game.current.y, game.current.y);
+  len = server_request(server, "state", 5, reply);
+  reply[len] = 0;
+  ck_assert_int_eq(strncmp(reply, "state moving 21 0 0 1 ", 22), 0);
+  ck_assert_int_eq(strlen(strrchr(reply, ' ')), 1 + HEIGHT * 3 + 1);
+  len = server_request(server, "act lx", 6, reply);
+  reply[len] = 0;
+  ck_assert_str_eq(reply, "err unknown action\n");
+  len = server_request(server, "tick -1", 7, reply);
+  reply[len] = 0;
+  ck_assert_str_eq(reply, "err bad tick count\n");
+  len = server_request(server, "reset", 5, reply);
+  len = server_request(server, "act", 3, reply);
+  reply[len] = 0;
+  ck_assert_str_eq(reply, "ok moving 0 0 0\n");
+
+  int in[2];
+  int out[2];
+  char output[256] = {0};
+  const char *requests = "start 7\nact l.a\nfly\ntick 20\nquit\nstate\n";
+  ck_assert_int_eq(pipe(in), 0);
+  ck_assert_int_eq(pipe(out), 0);
+  ck_assert_int_eq(write(in[1], requests, strlen(requests)),
+                   (int)strlen(requests));
+  close(in[1]);
+  server_init(server);
+  ck_assert_int_eq(server_run(server, in[0], out[1]), 1);
+  close(out[1]);
+  ck_assert_int_gt(read(out[0], output, sizeof(output) - 1), 0);
+  ck_assert_str_eq(output,
+                   "ok\nok moving 1 0 0\nerr unknown request\n"
+                   "ok moving 21 0 0\nbye\n");
+  close(in[0]);
+  close(out[0]);
+  free(server);
+}
+END_TEST
+
+Suite *server_test_suite(void) {
+  Suite *s = suite_create("server_test");
+  TCase *tc_server_test = tcase_create("server_test");
+  tcase_add_test(tc_server_test, server_test);
+  suite_add_tcase(s, tc_server_test);
+  return s;
+}
+
+START_TEST(dataset_test) {
+  unsigned char raw[1000];
+  unsigned char packed[1000 + 1000 / 128 + 1];
+  unsigned char unpacked[1000];
+  for (int i = 0; i < 1000; i++) raw[i] = i < 500 ? 0 : (i * 7) % 5;
+  int size = rle_encode(raw, 1000, packed);
+  ck_assert_int_lt(size, 600);
+  ck_assert_int_eq(rle_decode(packed, size, unpacked, 1000), 1000);
+  ck_assert_int_eq(memcmp(raw, unpacked, 1000), 0);
+  ck_assert_int_eq(rle_decode(packed, size, unpacked, 999), -1);
+
+  Dataset_t *set = malloc(sizeof(*set));
+  Dataset_t *raw_set = malloc(sizeof(*raw_set));
+  ck_assert_int_eq(dataset_create(set, "dataset_test.ttds", 1), 1);
+  ck_assert_int_eq(dataset_create(raw_set, "dataset_raw.ttds", 0), 1);
+  for (int seed = 1; seed <= 3; seed++) {
+    ck_assert_int_eq(dataset_bot_game(set, seed, 3000), 1);
+    ck_assert_int_eq(dataset_bot_game(raw_set, seed, 3000), 1);
+  }
+  long long records = set->records;
+  ck_assert_int_gt(records, 20);
+  ck_assert_int_eq(dataset_close(set), 1);
+  ck_assert_int_eq(dataset_close(raw_set), 1);
+
+  ck_assert_int_eq(dataset_open(set, "dataset_test.ttds"), 1);
+  ck_assert_int_eq(dataset_open(raw_set, "dataset_raw.ttds"), 1);
+  ck_assert_int_eq(dataset_read_block(set), 1);
+  ck_assert_int_eq(dataset_read_block(raw_set), 1);
+  ck_assert_int_eq(set->block.count, records);
+  for (int i = 0; i < set->block.count; i++) {
+    DatasetRecord record;
+    DatasetRecord raw_record;
+    dataset_get(&set->block, i, &record);
+    dataset_get(&raw_set->block, i, &raw_record);
+    ck_assert_int_eq(
+        memcmp(record.board, raw_record.board, sizeof(record.board)), 0);
+    ck_assert_int_eq(record.current, raw_record.current);
+    ck_assert_int_eq(record.next, raw_record.next);
+    ck_assert_int_eq(record.x, raw_record.x);
+    ck_assert_int_eq(record.y, raw_record.y);
+    ck_assert_int_eq(record.mask, raw_record.mask);
+    ck_assert_int_eq(record.reward, raw_record.reward);
+    ck_assert_int_eq(record.done, raw_record.done);
+    ck_assert_int_lt(record.current, 7);
+    int resting = 0;
+    for (int bit = 0; bit < FIGURE_CELLS; bit++) {
+      int row = record.y + bit / FIGURE_SIZE;
+      int col = record.x + bit % FIGURE_SIZE;
+      if (record.mask >> bit & 1) {
+        ck_assert(col >= 0 && col < WIDTH && row < HEIGHT);
+        if (row >= 0) ck_assert_int_eq(record.board[row] >> col & 1, 0);
+        resting |= row == HEIGHT - 1 ||
+                   (row + 1 >= 0 && record.board[row + 1] >> col & 1);
+      }
+    }
+    ck_assert_int_eq(resting, 1);
+  }
+  ck_assert_int_eq(dataset_read_block(set), 0);
+  ck_assert_int_eq(dataset_close(set), 1);
+  ck_assert_int_eq(dataset_close(raw_set), 1);
+  remove("dataset_test.ttds");
+  remove("dataset_raw.ttds");
+  free(set);
+  free(raw_set);
+}
+END_TEST
+
+Suite *dataset_test_suite(void) {
+  Suite *s = suite_create("dataset_test");
+  TCase *tc_dataset_test = tcase_create("dataset_test");
+  tcase_add_test(tc_dataset_test, dataset_test);
+  suite_add_tcase(s, tc_dataset_test);
+  return s;
+}
+
+static void *metrics_player(void *arg) {
+  GameInfo_t *game = arg;
+  GameInfo_t *prev = bind_game(game);
+  stats_init(game);
+  bind_game(prev);
+  game_input(game, Start);
+  while (game->state == MOVING) {
+    game_input(game, game->pieces % 3 ? Left : Right);
+    game_input(game, Down);
+    game_tick(game);
+  }
+  return NULL;
+}
+
+static void *metrics_counter(void *arg) {
+  int *owned = arg;
+  metrics_game_started();
+  *owned = metrics_owned();
+  return NULL;
+}
+
+START_TEST(metrics_test) {
+  Metrics_t before;
+  Metrics_t after;
+  GameInfo_t games[5] = {0};
+  pthread_t threads[5];
+  long long pieces = 0;
+  long long lines = 0;
+  metrics_snapshot(&before);
+  for (int i = 0; i < 5; i++) {
+    games[i].headless = 1;
+    games[i].metrics = i < 4;
+    seed_game(&games[i], 100 + i);
+    pthread_create(&threads[i], NULL, metrics_player, &games[i]);
+  }
+  for (int i = 0; i < 5; i++) {
+    pthread_join(threads[i], NULL);
+    ck_assert_int_eq(games[i].state, GAMEOVER);
+    if (games[i].metrics) {
+      pieces += games[i].pieces - 1;
+      lines += games[i].lines;
+    }
+  }
+  metrics_snapshot(&after);
+  ck_assert_int_eq(after.started - before.started, 4);
+  ck_assert_int_eq(after.ended - before.ended, 4);
+  ck_assert_int_eq(after.levels[LEVEL_MIN] - before.levels[LEVEL_MIN], 4);
+  for (int i = 0; i < FIGURE_KINDS; i++)
+    pieces -= after.pieces[i] - before.pieces[i];
+  for (int i = 0; i < CLEAR_KINDS; i++)
+    lines -= (i + 1) * (after.clears[i] - before.clears[i]);
+  ck_assert_int_eq(pieces, 0);
+  ck_assert_int_eq(lines, 0);
+
+  for (int i = 0; i < METRICS_SHARDS + 44; i++) {
+    pthread_t thread;
+    int owned = 0;
+    pthread_create(&thread, NULL, metrics_counter, &owned);
+    pthread_join(thread, NULL);
+    ck_assert_int_eq(owned, 1);
+  }
+  metrics_snapshot(&before);
+  ck_assert_int_eq(before.started - after.started, METRICS_SHARDS + 44);
+  metrics_snapshot(&after);
+
+  FILE *file = NULL;
+  char line[128];
+  long long started = -1;
+  ck_assert_int_eq(metrics_dump("metrics_test.txt"), 1);
+  file = fopen("metrics_test.txt", "r");
+  ck_assert_ptr_nonnull(file);
+  ck_assert_ptr_nonnull(fgets(line, sizeof(line), file));
+  ck_assert_int_eq(sscanf(line, "tetris_games_started %lld", &started), 1);
+  ck_assert_int_eq(started, after.started);
+  fclose(file);
+  remove("metrics_test.txt");
+}
+END_TEST
+
+Suite *metrics_test_suite(void) {
+  Suite *s = suite_create("metrics_test");
+  TCase *tc_metrics_test = tcase_create("metrics_test");
+  tcase_add_test(tc_metrics_test, metrics_test);
+  suite_add_tcase(s, tc_metrics_test);
+  return s;
+}
+
+START_TEST(solver_test) {
+  Puzzle_t puzzle;
+  Solution_t solution;
+  FILE *file = fopen("solver_test.txt", "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(PUZZLE_MAGIC "\npieces OIIII\n", file);
+  fclose(file);
+  ck_assert_int_eq(puzzle_load(&puzzle, "solver_test.txt"), 1);
+  ck_assert_int_eq(puzzle.count, 5);
+  ck_assert_int_eq(solve_puzzle(&puzzle, 2, &solution), 1);
+  ck_assert_int_eq(solution.length, 5);
+  unsigned short rows[HEIGHT];
+  memcpy(rows, puzzle.rows, sizeof(rows));
+  int cleared = 0;
+  for (int i = 0; i < solution.length; i++) {
+    ck_assert_int_eq(solution.placements[i].figure.type, puzzle.pieces[i]);
+    cleared += puzzle_place(rows, &solution.placements[i].figure);
+  }
+  ck_assert_int_eq(cleared, 2);
+  for (int i = 0; i < HEIGHT; i++) ck_assert_int_eq(rows[i], 0);
+
+  file = fopen("solver_test.txt", "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(PUZZLE_MAGIC "\npieces SSSSS\n", file);
+  fclose(file);
+  ck_assert_int_eq(puzzle_load(&puzzle, "solver_test.txt"), 1);
+  ck_assert_int_eq(solve_puzzle(&puzzle, 1, &solution), 0);
+  ck_assert_int_eq(solution.found, 0);
+
+  file = fopen("solver_test.txt", "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(PUZZLE_MAGIC "\npieces LI\nlines 2\n", file);
+  fputs(".#########\n.#########\n.#########\n", file);
+  fclose(file);
+  ck_assert_int_eq(puzzle_load(&puzzle, "solver_test.txt"), 1);
+  ck_assert_int_eq(puzzle.lines, 2);
+  ck_assert_int_eq(puzzle.rows[HEIGHT - 1], FULL_ROW & ~1u);
+  ck_assert_int_eq(solve_puzzle(&puzzle, 1, &solution), 1);
+  ck_assert_int_eq(solution.length, 2);
+
+  file = fopen("solver_test.txt", "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(PUZZLE_MAGIC "\npieces O\n", file);
+  for (int i = 0; i <= HEIGHT; i++) fputs("#.........\n", file);
+  fclose(file);
+  ck_assert_int_eq(puzzle_load(&puzzle, "solver_test.txt"), 0);
+  remove("solver_test.txt");
+
+  GameInfo_t game = {0};
+  GameInfo_t *prev = NULL;
+  game.headless = 1;
+  seed_game(&game, 7);
+  prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  game_input(&game, Start);
+  puzzle_capture(&puzzle, &game, 6, 0);
+  for (int i = 0; i < 6; i++) {
+    int pieces = game.pieces;
+    ck_assert_int_eq(game.state, MOVING);
+    ck_assert_int_eq(puzzle.pieces[i], game.current.type);
+    while (game.state == MOVING && game.pieces == pieces) {
+      game_input(&game, i % 2 ? Left : Right);
+      game_input(&game, Down);
+      game_tick(&game);
+    }
+  }
+}
+END_TEST
+
+Suite *solver_test_suite(void) {
+  Suite *s = suite_create("solver_test");
+  TCase *tc_solver_test = tcase_create("solver_test");
+  tcase_add_test(tc_solver_test, solver_test);
+  suite_add_tcase(s, tc_solver_test);
+  return s;
+}
+
+static void *highscore_offerer(void *arg) {
+  HighScore_t *store = arg;
+  for (int i = 1; i <= 1000; i++) highscore_offer(store, i);
+  return NULL;
+}
+
+START_TEST(highscore_test) {
+  const char *dir = "highscore_test";
+  char path[512];
+  HighScore_t first;
+  HighScore_t second;
+  pthread_t threads[2];
+  mkdir(dir, 0755);
+  snprintf(path, sizeof(path), "%s/%s", dir, HIGH_SCORE_MAP);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/%s", dir, HIGH_SCORE_FILE);
+  FILE *file = fopen(path, "w");
+  ck_assert_ptr_nonnull(file);
+  fputs("700", file);
+  fclose(file);
+
+  ck_assert_int_eq(highscore_open(&first, dir), 1);
+  ck_assert_int_eq(highscore_open(&second, dir), 1);
+  ck_assert_int_eq(highscore_get(&first), 700);
+  ck_assert_int_eq(highscore_offer(&first, 500), 700);
+  ck_assert_int_eq(highscore_offer(&second, 900), 900);
+  ck_assert_int_eq(highscore_get(&first), 900);
+  ck_assert_int_eq(read_high_score(path), 700);
+  ck_assert_int_eq(highscore_flush(&first), 1);
+  ck_assert_int_eq(read_high_score(path), 700);
+  ck_assert_int_eq(highscore_flush(&second), 1);
+  ck_assert_int_eq(read_high_score(path), 900);
+
+  pthread_create(&threads[0], NULL, highscore_offerer, &first);
+  pthread_create(&threads[1], NULL, highscore_offerer, &second);
+  highscore_offer(&second, 1200);
+  pthread_join(threads[0], NULL);
+  pthread_join(threads[1], NULL);
+  ck_assert_int_eq(highscore_get(&first), 1200);
+  highscore_close(&first);
+  highscore_close(&second);
+  ck_assert_int_eq(read_high_score(path), 1200);
+
+  ck_assert_int_eq(highscore_open(&first, dir), 1);
+  ck_assert_int_eq(highscore_get(&first), 1200);
+  highscore_close(&first);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/%s", dir, HIGH_SCORE_MAP);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/%s", dir, LEADER_LOG);
+  remove(path);
+  snprintf(path, sizeof(path), "%s/%s", dir, LEADER_INDEX);
+  remove(path);
+  rmdir(dir);
+}
+END_TEST
+
+Suite *highscore_test_suite(void) {
+  Suite *s = suite_create("highscore_test");
+  TCase *tc_highscore_test = tcase_create("highscore_test");
+  tcase_add_test(tc_highscore_test, highscore_test);
+  suite_add_tcase(s, tc_highscore_test);
+  return s;
+}
+
+typedef struct {
+  unsigned short rows[HEIGHT];
+  int score;
+  char current;
+  char next;
+  unsigned int rng;
+} RewindCheck;
+
+static void rewind_check(const GameInfo_t *game, RewindCheck *check) {
+  memset(check, 0, sizeof(*check));
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++)
+      check->rows[i] |= (game->field[i][j] != 0) << j;
+  }
+  check->score = game->score;
+  check->current = game->current.type;
+  check->next = game->next.type;
+  check->rng = game->rng;
+}
+
+START_TEST(rewind_test) {
+  static Rewind_t rewind;
+  GameInfo_t game = {0};
+  RewindCheck spawned[32];
+  RewindCheck check;
+  ck_assert_int_le(sizeof(Snapshot), 48);
+  game.headless = 1;
+  game.rewind = &rewind;
+  seed_game(&game, 11);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  game_input(&game, Start);
+  for (int i = 0; i < 20 && game.state == MOVING; i++) {
+    int pieces = game.pieces;
+    rewind_check(&game, &spawned[pieces]);
+    while (game.state == MOVING && game.pieces == pieces) {
+      game_input(&game, pieces % 3 ? Left : Right);
+      game_input(&game, Down);
+      game_tick(&game);
+    }
+  }
+  ck_assert_int_eq(game.state, MOVING);
+  ck_assert_int_eq(rewind.count, game.pieces);
+  ck_assert_int_eq(rewind_used(&game), 0);
+
+  int latest = game.pieces;
+  game_input(&game, Pause);
+  for (int i = 0; i < 5; i++) game_input(&game, Left);
+  ck_assert_int_eq(game.state, PAUSE);
+  ck_assert_int_eq(rewind_used(&game), 1);
+  ck_assert_int_eq(game.pieces, latest - 5);
+  rewind_check(&game, &check);
+  ck_assert_mem_eq(&check, &spawned[latest - 5], sizeof(check));
+  game_input(&game, Right);
+  rewind_check(&game, &check);
+  ck_assert_mem_eq(&check, &spawned[latest - 4], sizeof(check));
+  for (int i = 0; i < latest; i++) game_input(&game, Left);
+  ck_assert_int_eq(game.pieces, 1);
+  ck_assert_int_eq(game.score, 0);
+
+  game_input(&game, Pause);
+  for (int i = 1; i < 8; i++) {
+    rewind_check(&game, &check);
+    ck_assert_mem_eq(&check, &spawned[i], sizeof(check));
+    while (game.state == MOVING && game.pieces == i) {
+      game_input(&game, i % 3 ? Left : Right);
+      game_input(&game, Down);
+      game_tick(&game);
+    }
+  }
+  ck_assert_int_eq(rewind.count, game.pieces);
+
+  Rewind_t *created = rewind_create();
+  ck_assert_ptr_nonnull(created);
+  ck_assert_int_eq(created->count, 0);
+  ck_assert_int_eq(created->pos, -1);
+  ck_assert_int_eq(created->used, 0);
+  free(created);
+  game.rewind = NULL;
+  latest = game.pieces;
+  game_input(&game, Pause);
+  game_input(&game, Left);
+  ck_assert_int_eq(game.state, PAUSE);
+  ck_assert_int_eq(game.pieces, latest);
+  ck_assert_int_eq(rewind_used(&game), 0);
+}
+END_TEST
+
+Suite *rewind_test_suite(void) {
+  Suite *s = suite_create("rewind_test");
+  TCase *tc_rewind_test = tcase_create("rewind_test");
+  tcase_add_test(tc_rewind_test, rewind_test);
+  suite_add_tcase(s, tc_rewind_test);
+  return s;
+}
+
+/**
+ * Compare a lane of a batch with the scalar game it mirrors.
+ */
+static void batch_check(const Batch_t *batch, int lane, GameInfo_t *game) {
+  GameInfo_t copy = {0};
+  PackedFigure current, expected;
+  batch_get(batch, lane, &copy);
+  ck_assert_int_eq(copy.state, game->state);
+  ck_assert_int_eq(copy.score, game->score);
+  ck_assert_int_eq(copy.level, game->level);
+  ck_assert_int_eq(copy.lines, game->lines);
+  ck_assert_int_eq(copy.cleared, game->cleared);
+  ck_assert_int_eq(copy.pieces, game->pieces);
+  ck_assert_int_eq(copy.ticks, game->ticks);
+  ck_assert_int_eq(copy.fall, game->fall);
+  ck_assert_int_eq(copy.lock, game->lock);
+  ck_assert_int_eq(copy.next.type, game->next.type);
+  ck_assert_int_eq(copy.spun, game->spun);
+  ck_assert_int_eq(copy.combo, game->combo);
+  ck_assert_int_eq(copy.b2b, game->b2b);
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++)
+      ck_assert_int_eq(copy.field[i][j] != 0, game->field[i][j] != 0);
+  }
+  if (game->state == MOVING || game->state == PAUSE) {
+    pack_figure(&copy.current, &current);
+    pack_figure(&game->current, &expected);
+    ck_assert_int_eq(current.type, expected.type);
+    ck_assert_int_eq(current.mask, expected.mask);
+    ck_assert_int_eq(current.x, expected.x);
+    ck_assert_int_eq(current.y, expected.y);
+  }
+}
+
+START_TEST(batch_test) {
+  enum { LANES = 64, STEPS = 4000 };
+  static GameInfo_t games[LANES];
+  static Bot_t bots[LANES];
+  static const signed char moves[] = {-1,     -1,     Left, Left,
+                                      Right,  Right,  Action, Action,
+                                      Down,   Up,     Start,  Pause};
+  Batch_t batch;
+  unsigned int seeds[LANES];
+  signed char actions[LANES];
+  unsigned int rng = 5;
+  for (int lane = 0; lane < LANES; lane++) {
+    seeds[lane] = lane * 7919u;
+    bot_init(&bots[lane]);
+    games[lane] = (GameInfo_t){0};
+    games[lane].headless = 1;
+    seed_game(&games[lane], seeds[lane]);
+    GameInfo_t *prev = bind_game(&games[lane]);
+    stats_init(&games[lane]);
+    bind_game(prev);
+  }
+  ck_assert_int_eq(batch_init(&batch, LANES, seeds), 1);
+  for (int lane = 0; lane < LANES; lane++)
+    batch_check(&batch, lane, &games[lane]);
+
+  int gameovers = 0;
+  int lines = 0;
+  for (int step = 0; step < STEPS; step++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      int pick = next_random(&rng) % 64;
+      actions[lane] = pick < (int)sizeof(moves) ? moves[pick] : -1;
+      if (lane % 2 && pick > 1)
+        actions[lane] = bot_action(&bots[lane], &games[lane]);
+      if (step == 0 || games[lane].state == GAMEOVER) actions[lane] = Start;
+      if (actions[lane] != -1) game_input(&games[lane], actions[lane]);
+      game_tick(&games[lane]);
+    }
+    batch_step(&batch, actions);
+    for (int lane = 0; lane < LANES; lane++) {
+      batch_check(&batch, lane, &games[lane]);
+      gameovers += games[lane].state == GAMEOVER;
+      if (games[lane].lines > lines) lines = games[lane].lines;
+    }
+  }
+  ck_assert_int_gt(gameovers, 0);
+  ck_assert_int_gt(lines, 0);
+  batch_free(&batch);
+}
+END_TEST
+
+Suite *batch_test_suite(void) {
+  Suite *s = suite_create("batch_test");
+  TCase *tc_batch_test = tcase_create("batch_test");
+  tcase_add_test(tc_batch_test, batch_test);
+  suite_add_tcase(s, tc_batch_test);
+  return s;
+}
+
+START_TEST(wheel_test) {
+  static WheelTimer timers[256];
+  static long long fired[256];
+  long long deadlines[256];
+  TimerWheel_t wheel;
+  unsigned int rng = 9;
+  wheel_init(&wheel, 5);
+  for (int i = 0; i < 256; i++) {
+    int level = next_random(&rng) % (WHEEL_LEVELS + 1);
+    deadlines[i] = 5 + 1 + next_random(&rng) % (1LL << (WHEEL_BITS * level));
+    if (i == 0) deadlines[i] = WHEEL_SPAN + 100;
+    wheel_add(&wheel, &timers[i], deadlines[i]);
+    fired[i] = -1;
+  }
+  for (int i = 1; i < 256; i += 17) wheel_cancel(&wheel, &timers[i]);
+  wheel_add(&wheel, &timers[2], 1);
+  deadlines[2] = 6;
+  ck_assert_int_eq(wheel.pending, 256 - 15);
+  while (wheel.pending > 0) {
+    for (WheelTimer *t = wheel_advance(&wheel); t != NULL; t = t->next)
+      fired[t - timers] = wheel.now;
+  }
+  for (int i = 0; i < 256; i++) {
+    ck_assert_int_eq(fired[i], i % 17 == 1 ? -1 : deadlines[i]);
+    ck_assert_int_eq(wheel_pending(&timers[i]), 0);
+  }
+}
+END_TEST
+
+/**
+ * Compare a hosted session with its reference, the virtual clock of a
+ * headless game starts at the wall time of its start and is not compared.
+ */
+static void host_check(const Session_t *hosted, const Session_t *expected) {
+  Session_t copy = *hosted;
+  copy.timer = expected->timer;
+  ck_assert_mem_eq(&copy, expected, sizeof(copy));
+}
+
+START_TEST(host_test) {
+  enum { SESSIONS = 48, TICKS = 6000 };
+  static const signed char moves[] = {Start, Pause, Left, Right, Action, Down};
+  SessionPool pool;
+  SessionHost_t host;
+  Session_t *expected[SESSIONS];
+  Session_t *hosted[SESSIONS];
+  unsigned int rng = 17;
+  pool_init(&pool);
+  ck_assert_int_eq(host_init(&host, SESSIONS), 1);
+  for (int i = 0; i < SESSIONS; i++) {
+    expected[i] = session_create(&pool, i + 1);
+    hosted[i] = session_create(&pool, i + 1);
+    ck_assert_int_eq(host_attach(&host, hosted[i]), i);
+  }
+  ck_assert_int_eq(host.wheel.pending, 0);
+  for (int tick = 1; tick <= TICKS; tick++) {
+    for (int i = 0; i < SESSIONS; i++) {
+      int pick = next_random(&rng) % (i % 4 ? 48 : 400);
+      int action = pick < (int)sizeof(moves) ? moves[pick] : -1;
+      if (tick == 1) action = Start;
+      if (expected[i]->state == GAMEOVER && pick < 24) action = Start;
+      if (action != -1) host_input(&host, i, action);
+      session_step(expected[i], action);
+    }
+    host_advance(&host);
+    for (int i = 0; tick % 97 == 0 && i < SESSIONS; i++) {
+      host_sync(&host, i);
+      host_check(hosted[i], expected[i]);
+    }
+  }
+  ck_assert_int_eq(host_attach(&host, hosted[0]), -1);
+  ck_assert_int_eq(host_detach(&host, 5), 1);
+  ck_assert_int_eq(host_detach(&host, 5), 0);
+  ck_assert_int_eq(host_input(&host, 5, Start), 0);
+  ck_assert_int_eq(host_sync(&host, 5), 0);
+  ck_assert_int_eq(host_sync(&host, -1), 0);
+  ck_assert_int_eq(host_input(&host, SESSIONS, Start), 0);
+  host_check(hosted[5], expected[5]);
+  ck_assert_int_eq(host_attach(&host, hosted[5]), 5);
+  for (int i = 0; i < SESSIONS; i++) {
+    ck_assert_int_eq(host_detach(&host, i), 1);
+    host_check(hosted[i], expected[i]);
+  }
+  ck_assert_int_eq(host.wheel.pending, 0);
+  ck_assert_int_lt(host.woken, (long long)SESSIONS * TICKS / 4);
+  host_free(&host);
+  pool_free(&pool);
+}
+END_TEST
+
+Suite *wheel_test_suite(void) {
+  Suite *s = suite_create("wheel_test");
+  TCase *tc_wheel_test = tcase_create("wheel_test");
+  tcase_add_test(tc_wheel_test, wheel_test);
+  tcase_add_test(tc_wheel_test, host_test);
+  suite_add_tcase(s, tc_wheel_test);
+  return s;
+}
+
+START_TEST(score_lock_test) {
+  int combo = 0;
+  int b2b = 0;
+  ck_assert_int_eq(score_lock(0, SPIN_NONE, &combo, &b2b), 0);
+  ck_assert_int_eq(score_lock(1, SPIN_NONE, &combo, &b2b), 100);
+  ck_assert_int_eq(score_lock(4, SPIN_NONE, &combo, &b2b), 1500 + 50);
+  ck_assert_int_eq(b2b, 1);
+  ck_assert_int_eq(score_lock(2, SPIN_FULL, &combo, &b2b), 1800 + 100);
+  ck_assert_int_eq(score_lock(0, SPIN_MINI, &combo, &b2b), 100);
+  ck_assert_int_eq(combo, 0);
+  ck_assert_int_eq(b2b, 1);
+  ck_assert_int_eq(score_lock(1, SPIN_MINI, &combo, &b2b), 300);
+  ck_assert_int_eq(score_lock(3, SPIN_NONE, &combo, &b2b), 700 + 50);
+  ck_assert_int_eq(b2b, 0);
+  ck_assert_int_eq(score_lock(4, SPIN_NONE, &combo, &b2b), 1500 + 100);
+
+  ck_assert_int_eq(spin_kind(0x00E2, CORNER_BOTTOM_LEFT), SPIN_NONE);
+  ck_assert_int_eq(spin_kind(0x00E2, CORNER_TOP_LEFT | CORNER_TOP_RIGHT |
+                                         CORNER_BOTTOM_LEFT),
+                   SPIN_FULL);
+  ck_assert_int_eq(spin_kind(0x00E2, CORNER_TOP_LEFT | CORNER_BOTTOM_LEFT |
+                                         CORNER_BOTTOM_RIGHT),
+                   SPIN_MINI);
+  ck_assert_int_eq(spin_kind(0x08E0, CORNER_TOP_LEFT | CORNER_BOTTOM_LEFT |
+                                         CORNER_BOTTOM_RIGHT),
+                   SPIN_FULL);
+  ck_assert_int_eq(spin_kind(0x0862, 0xF), SPIN_FULL);
+}
+END_TEST
+
+/**
+ * Play a T into a T-spin double slot: a pointing down T rotated into a
+ * two-row slot, under an overhang or not, and locked there.
+ */
+static void tspin_play(GameInfo_t *game, int overhang) {
+  game->headless = 1;
+  seed_game(game, 4);
+  GameInfo_t *prev = bind_game(game);
+  stats_init(game);
+  bind_game(prev);
+  game_input(game, Start);
+  for (int j = 0; j < WIDTH; j++) {
+    game->field[HEIGHT - 1][j] = j == 4 ? 0 : COLOR_GARBAGE;
+    game->field[HEIGHT - 2][j] = j >= 3 && j <= 5 ? 0 : COLOR_GARBAGE;
+  }
+  game->field[HEIGHT - 3][3] = overhang ? COLOR_GARBAGE : 0;
+  board_rebuild(&game->board, game->field);
+  reset_figure(&game->current);
+  make_figure(&game->current, figure_kind('T'));
+  game->current.x = 3;
+  game->current.y = 0;
+  game_input(game, Action);
+  game->current.y = HEIGHT - 3;
+  game_input(game, Action);
+  game_input(game, Down);
+  for (int pieces = game->pieces; game->pieces == pieces;) game_tick(game);
+}
+
+START_TEST(tspin_test) {
+  GameInfo_t game = {0};
+  tspin_play(&game, 1);
+  ck_assert_int_eq(game.lines, 2);
+  ck_assert_int_eq(game.score, 1200);
+  ck_assert_int_eq(game.b2b, 1);
+  ck_assert_int_eq(game.combo, 1);
+
+  game = (GameInfo_t){0};
+  tspin_play(&game, 0);
+  ck_assert_int_eq(game.lines, 2);
+  ck_assert_int_eq(game.score, 300);
+  ck_assert_int_eq(game.b2b, 0);
+
+  reset_figure(&game.current);
+  make_figure(&game.current, figure_kind('T'));
+  game.current.x = 3;
+  game.current.y = 0;
+  game_input(&game, Action);
+  ck_assert_int_eq(game.spun, 1);
+  game_input(&game, Left);
+  ck_assert_int_eq(game.spun, 0);
+}
+END_TEST
+
+Suite *score_test_suite(void) {
+  Suite *s = suite_create("score_test");
+  TCase *tc_score_test = tcase_create("score_test");
+  tcase_add_test(tc_score_test, score_lock_test);
+  tcase_add_test(tc_score_test, tspin_test);
+  suite_add_tcase(s, tc_score_test);
+  return s;
+}
+
+START_TEST(board_test) {
+  GameInfo_t game = {0};
+  Board_t fresh;
+  game.headless = 1;
+  seed_game(&game, 8);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  bind_game(prev);
+  for (int j = 0; j < WIDTH - 1; j++) game.field[HEIGHT - 1][j] = BLUE_P;
+  game.field[HEIGHT - 3][0] = BLUE_P;
+  board_rebuild(&game.board, game.field);
+  const BoardFeatures *features = &game_board(&game)->totals;
+  ck_assert_int_eq(features->aggregate_height, 11);
+  ck_assert_int_eq(features->max_height, 3);
+  ck_assert_int_eq(features->holes, 1);
+  ck_assert_int_eq(features->bumpiness, 3);
+  ck_assert_int_eq(features->wells, 1);
+  ck_assert_int_eq(features->row_transitions, 4);
+  ck_assert_int_eq(features->col_transitions, 11);
+  ck_assert_int_eq(game.board.rows[HEIGHT - 1], (1 << (WIDTH - 1)) - 1);
+  ck_assert_int_eq(game.board.heights[0], 3);
+
+  UserAction_t actions[] = {Left, Right, Action, -1, -1, Down};
+  unsigned int rng = 3;
+  int lines = 0;
+  game_input(&game, Start);
+  for (int step = 0; step < 20000; step++) {
+    int pieces = game.pieces;
+    if (game.state == GAMEOVER) game_input(&game, Start);
+    game_input(&game, actions[next_random(&rng) % 6]);
+    game_tick(&game);
+    if (game.pieces != pieces) {
+      ck_assert_int_eq(board_verify(&game.board, game.field), 1);
+      board_rebuild(&fresh, game.field);
+      ck_assert_mem_eq(&fresh, &game.board, sizeof(fresh));
+    }
+    lines += game.cleared > 0 && game.pieces != pieces;
+  }
+  ck_assert_int_gt(lines, 0);
+}
+END_TEST
+
+Suite *board_test_suite(void) {
+  Suite *s = suite_create("board_test");
+  TCase *tc_board_test = tcase_create("board_test");
+  tcase_add_test(tc_board_test, board_test);
+  suite_add_tcase(s, tc_board_test);
+  return s;
+}
+
+START_TEST(finesse_table_test) {
+  const FinesseTable *table = finesse_table();
+  const int views[FIGURE_KINDS] = {2, 1, 4, 4, 2, 4, 2};
+  UserAction_t actions[FINESSE_PATH];
+  Tetramino figure = {0};
+  for (int kind = 0; kind < FIGURE_KINDS; kind++) {
+    ck_assert_int_eq(table->view_count[kind], views[kind]);
+    for (int view = 0; view < views[kind]; view++) {
+      int right = 0;
+      for (int bit = 0; bit < FIGURE_CELLS; bit++) {
+        if (table->views[kind][view] >> bit & 1 && bit % FIGURE_SIZE > right)
+          right = bit % FIGURE_SIZE;
+      }
+      for (int column = 0; column < WIDTH; column++) {
+        int presses = table->presses[kind][view][column];
+        if (column + right < WIDTH)
+          ck_assert_int_lt(presses, FINESSE_NONE);
+        else
+          ck_assert_int_eq(presses, FINESSE_NONE);
+      }
+    }
+  }
+
+  make_figure(&figure, figure_kind('O'));
+  figure.x = -1;
+  figure.y = HEIGHT - 2;
+  ck_assert_int_eq(finesse_optimal(&figure, actions), 5);
+  for (int i = 0; i < 4; i++) ck_assert_int_eq(actions[i], Left);
+  ck_assert_int_eq(actions[4], Down);
+
+  reset_figure(&figure);
+  make_figure(&figure, figure_kind('I'));
+  for (int i = 0; i < 4; i++) {
+    figure.view[1][i] = 0;
+    figure.view[i][1] = COLOR_RED;
+  }
+  figure.x = 3;
+  ck_assert_int_eq(finesse_optimal(&figure, actions), 2);
+  ck_assert_int_eq(actions[0], Action);
+  figure.x = 10;
+  ck_assert_int_eq(finesse_optimal(&figure, actions), -1);
+}
+END_TEST
+
+START_TEST(finesse_analyzer_test) {
+  UserAction_t actions[] = {Left, Right, Action, Down, -1, -1, -1, -1};
+  Finesse_t finesse;
+  Finesse_t replayed;
+  GameInfo_t game = {0};
+  Recording_t rec;
+  finesse_reset(&finesse);
+  make_figure(&game.current, figure_kind('O'));
+  game.current.x = 2;
+  game.current.y = HEIGHT - 2;
+  finesse_input(&finesse, &game, Left);
+  finesse_input(&finesse, &game, Right);
+  finesse_input(&finesse, &game, Left);
+  finesse_input(&finesse, &game, Down);
+  finesse_input(&finesse, &game, Down);
+  finesse_lock(&finesse, &game);
+  ck_assert_int_eq(finesse.last, 3);
+  ck_assert_int_eq(finesse.summary.pieces, 1);
+  ck_assert_int_eq(finesse.summary.faults, 1);
+  ck_assert_int_eq(finesse.summary.presses, 5);
+  ck_assert_int_eq(finesse.summary.optimal, 2);
+  ck_assert_int_eq(finesse.summary.wasted, 3);
+  game.pieces++;
+  finesse_input(&finesse, &game, Left);
+  game.current.x = 1;
+  finesse_lock(&finesse, &game);
+  ck_assert_int_eq(finesse.last, 0);
+  ck_assert_int_eq(finesse.summary.faults, 1);
+
+  recording_init(&rec);
+  srand(11);
+  game = (GameInfo_t){0};
+  game.headless = 1;
+  game.finesse = &finesse;
+  GameInfo_t *prev = bind_game(&game);
+  recording_begin(&rec, &game);
+  stats_init(&game);
+  ck_assert_int_eq(finesse.summary.pieces, 0);
+  record_action(&rec, &game, Start);
+  userInput(Start, 0);
+  while (game.state != GAMEOVER) {
+    UserAction_t action = actions[rand() % 8];
+    if (game.state == MOVING) advance_timer(&game, game.timer + rand() % 40000);
+    record_action(&rec, &game, action);
+    userInput(action, 0);
+  }
+  bind_game(prev);
+  recording_finish(&rec, &game);
+  ck_assert_int_gt(finesse.summary.pieces, 0);
+  ck_assert_int_gt(finesse.summary.wasted, 0);
+  ck_assert_int_eq(finesse.summary.pieces + finesse.summary.skipped,
+                   game.pieces - 1);
+  finesse_reset(&replayed);
+  ck_assert_int_eq(finesse_replay(&replayed, &rec), 1);
+  ck_assert_mem_eq(&replayed.summary, &finesse.summary,
+                   sizeof(replayed.summary));
+  recording_free(&rec);
+}
+END_TEST
+
+Suite *finesse_test_suite(void) {
+  Suite *s = suite_create("finesse_test");
+  TCase *tc_finesse_test = tcase_create("finesse_test");
+  tcase_add_test(tc_finesse_test, finesse_table_test);
+  tcase_add_test(tc_finesse_test, finesse_analyzer_test);
+  suite_add_tcase(s, tc_finesse_test);
+  return s;
+}
+
+START_TEST(rollout_test) {
+  GameInfo_t game = {0};
+  RolloutResult *result = malloc(sizeof(*result));
+  RolloutResult *threaded = malloc(sizeof(*threaded));
+  game.headless = 1;
+  seed_game(&game, 5);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  for (int i = 4; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH - 1; j++) game.field[i][j] = BLUE_P;
+  }
+  board_rebuild(&game.board, game.field);
+  reset_figure(&game.next);
+  make_figure(&game.next, figure_kind('I'));
+  spawn_figure();
+  bind_game(prev);
+
+  int best = rollout_evaluate(&game, 9, 1, 10000000, 8, result);
+  ck_assert_int_ge(best, 0);
+  ck_assert_int_eq(result->best, best);
+  ck_assert_int_eq(result->playouts, result->count * 8);
+  const RolloutCandidate *winner = &result->candidates[best];
+  ck_assert_int_eq(winner->placement.figure.x + 1, WIDTH - 1);
+  ck_assert_int_gt(winner->survived, 0);
+  ck_assert_int_ge(winner->lines, 8 * 4);
+  for (int i = 0; i < result->count; i++) {
+    if (i != best)
+      ck_assert_int_lt(result->candidates[i].survived, winner->survived);
+  }
+
+  ck_assert_int_eq(rollout_evaluate(&game, 9, 4, 10000000, 8, threaded), best);
+  for (int i = 0; i < result->count; i++) {
+    ck_assert_int_eq(threaded->candidates[i].survived,
+                     result->candidates[i].survived);
+    ck_assert_int_eq(threaded->candidates[i].lines,
+                     result->candidates[i].lines);
+  }
+  ck_assert_int_ge(rollout_evaluate(&game, 9, 4, 0, 8, threaded), 0);
+  ck_assert_int_ge(threaded->playouts, threaded->count);
+  ck_assert_int_eq(rollout_budget(&game), game.speed);
+  free(threaded);
+  free(result);
+}
+END_TEST
+
+Suite *rollout_test_suite(void) {
+  Suite *s = suite_create("rollout_test");
+  TCase *tc_rollout_test = tcase_create("rollout_test");
+  tcase_add_test(tc_rollout_test, rollout_test);
+  suite_add_tcase(s, tc_rollout_test);
+  return s;
+}
+
+START_TEST(pieces_test) {
+  const PieceSet_t *builtin = pieces_builtin();
+  ck_assert_int_eq(builtin->count, FIGURE_KINDS);
+  for (int i = 0; i < FIGURE_KINDS; i++) {
+    ck_assert_int_eq(builtin->pieces[i].type, FIGURE_TYPES[i]);
+    ck_assert_int_eq(pieces_kind(builtin, FIGURE_TYPES[i]), i);
+  }
+  const Piece_t *piece = pieces_find(builtin, 'I');
+  ck_assert_int_eq(piece->view_count, 2);
+  ck_assert_int_eq(piece->spawn.y, -1);
+  ck_assert_int_eq(piece->kick_left, 1);
+  ck_assert_int_eq(piece->kick_right, 2);
+  ck_assert_int_eq(pieces_find(builtin, 'O')->view_count, 1);
+  ck_assert_int_eq(pieces_find(builtin, 'O')->spawn.cols, 2);
+  ck_assert_int_eq(pieces_find(builtin, 'T')->view_count, 4);
+  ck_assert_int_eq(pieces_find(builtin, 'T')->spawn.view[0][1], COLOR_ORANGE);
+  ck_assert_ptr_null(pieces_find(builtin, 'X'));
+
+  FILE *file = fopen("pieces_test.txt", "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(PIECES_MAGIC "\npiece V cyan\n#.\n##\n\npiece i red\n...\n###\n...\n",
+        file);
+  fputs("piece P orange\n##.\n##.\n#..\n", file);
+  fclose(file);
+  PieceSet_t set;
+  ck_assert_int_eq(pieces_load(&set, "pieces_test.txt"), 1);
+  remove("pieces_test.txt");
+  ck_assert_int_eq(set.count, 3);
+  ck_assert_int_eq(pieces_find(&set, 'V')->view_count, 4);
+  ck_assert_int_eq(pieces_find(&set, 'i')->view_count, 2);
+  ck_assert_int_eq(pieces_find(&set, 'i')->spawn.y, -1);
+  ck_assert_int_eq(pieces_find(&set, 'P')->view_count, 4);
+
+  GameInfo_t game = {0};
+  game.headless = 1;
+  seed_game(&game, 5);
+  pieces_use(&set);
+  GameInfo_t *prev = bind_game(&game);
+  stats_init(&game);
+  reset_figure(&game.next);
+  make_figure(&game.next, pieces_kind(&set, 'i'));
+  spawn_figure();
+  rotate_figure();
+  ck_assert_int_eq(game.current.view[1][1], COLOR_RED);
+  ck_assert_int_eq(game.current.view[0][1], 0);
+  game.current.y = 0;
+  rotate_figure();
+  for (int i = 0; i < 3; i++)
+    ck_assert_int_eq(game.current.view[i][1], COLOR_RED);
+  ck_assert_int_eq(game.spun, 1);
+  userInput(Start, 0);
+  for (int i = 0; i < 200 && game.state != GAMEOVER; i++) {
+    game_input(&game, i % 2 ? Action : Left);
+    game_input(&game, Down);
+    for (int j = 0; j <= LOCK_DELAY; j++) game_tick(&game);
+  }
+  ck_assert_int_eq(game.state, GAMEOVER);
+  ck_assert_int_gt(game.pieces, 3);
+  ck_assert_ptr_nonnull(strchr("ViP", game.current.type));
+  for (int i = 0; i < HEIGHT; i++) {
+    for (int j = 0; j < WIDTH; j++) {
+      int color = game.field[i][j];
+      ck_assert(color == 0 || color == COLOR_CYAN || color == COLOR_RED ||
+                color == COLOR_ORANGE);
+    }
+  }
+  bind_game(prev);
+  ck_assert_int_eq(figure_kind('P'), 2);
+  ck_assert_int_eq(figure_kind('T'), 0);
+
+  SessionPool pool;
+  pool_init(&pool);
+  int drawn = 0;
+  for (unsigned int seed = 1; seed <= 64; seed++) {
+    Session_t *session = session_create(&pool, seed);
+    ck_assert_ptr_nonnull(strchr("ViP", session->next.type));
+    drawn |= 1 << figure_kind(session->next.type);
+    session_destroy(&pool, session);
+  }
+  ck_assert_int_eq(drawn, 7);
+  pool_free(&pool);
+
+  enum { LANES = 8 };
+  static const signed char moves[] = {Left, Right, Action, Down, -1, -1};
+  GameInfo_t games[LANES];
+  unsigned int seeds[LANES];
+  signed char actions[LANES];
+  unsigned int rng = 3;
+  Batch_t batch;
+  for (int lane = 0; lane < LANES; lane++) {
+    seeds[lane] = lane * 31u + 1;
+    games[lane] = (GameInfo_t){0};
+    games[lane].headless = 1;
+    seed_game(&games[lane], seeds[lane]);
+    prev = bind_game(&games[lane]);
+    stats_init(&games[lane]);
+    bind_game(prev);
+  }
+  ck_assert_int_eq(batch_init(&batch, LANES, seeds), 1);
+  for (int step = 0; step < 2000; step++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      actions[lane] = moves[next_random(&rng) % sizeof(moves)];
+      if (step == 0 || games[lane].state == GAMEOVER) actions[lane] = Start;
+      if (actions[lane] != -1) game_input(&games[lane], actions[lane]);
+      game_tick(&games[lane]);
+    }
+    batch_step(&batch, actions);
+    for (int lane = 0; lane < LANES; lane++)
+      batch_check(&batch, lane, &games[lane]);
+  }
+  batch_free(&batch);
+  pieces_use(NULL);
+  ck_assert_ptr_eq(pieces_active(), builtin);
+
+  static MoveGen_t gen;
+  static Placement placements[PLACEMENTS_MAX];
+  ck_assert_int_eq(pieces_compile(&set, PIECES_MAGIC
+                                  "\npiece I red\n.....\n.....\n#####\n"
+                                  ".....\n.....\npiece X green fixed\n"
+                                  ".#.\n###\n.#.\n"),
+                   1);
+  ck_assert_int_eq(pieces_find(&set, 'I')->view_count, 2);
+  ck_assert_int_eq(pieces_find(&set, 'I')->spawn.y, -2);
+  ck_assert_int_eq(pieces_find(&set, 'I')->kick_right, 2);
+  pieces_use(&set);
+  game = (GameInfo_t){0};
+  game.headless = 1;
+  seed_game(&game, 5);
+  prev = bind_game(&game);
+  stats_init(&game);
+  reset_figure(&game.next);
+  make_figure(&game.next, pieces_kind(&set, 'I'));
+  spawn_figure();
+  for (int j = 0; j < FIGURE_SIZE; j++)
+    ck_assert_int_eq(game.current.view[2][j], COLOR_RED);
+  ck_assert_int_eq(generate_placements(&gen, &game, placements), 16);
+  game.current.y = 0;
+  rotate_figure();
+  for (int i = 0; i < FIGURE_SIZE; i++)
+    ck_assert_int_eq(game.current.view[i][2], COLOR_RED);
+  game.state = MOVING;
+  game_input(&game, Down);
+  for (int j = 0; j <= LOCK_DELAY; j++) game_tick(&game);
+  for (int i = HEIGHT - FIGURE_SIZE; i < HEIGHT; i++)
+    ck_assert_int_eq(game.field[i][WIDTH / 2], COLOR_RED);
+  ck_assert_int_eq(game.field[HEIGHT - FIGURE_SIZE - 1][WIDTH / 2], 0);
+  int saved = load_high_score();
+  game.headless = 0;
+  game.score = saved + 1000;
+  calculate_score();
+  ck_assert_int_eq(game.high_score, saved + 1000);
+  ck_assert_int_eq(load_high_score(), saved);
+  ck_assert_int_eq(leaderboard_submit(&game), 0);
+  bind_game(prev);
+  pieces_use(NULL);
+
+  const char *invalid[] = {
+      "tetris-pieces 2\npiece T orange\n.#.\n###\n...\n",
+      PIECES_MAGIC "\n",
+      PIECES_MAGIC "\npiece T pink\n.#.\n###\n...\n",
+      PIECES_MAGIC "\npiece T orange\n.#.\n###\npiece T red\n##\n##\n",
+      PIECES_MAGIC "\npiece L blue\n#####\n",
+      PIECES_MAGIC "\npiece L blue\n######\n",
+      PIECES_MAGIC "\npiece L blue\n#\n#\n#\n#\n#\n#\n",
+      PIECES_MAGIC "\npiece L blue\n###\n",
+      PIECES_MAGIC "\npiece L blue\n...\n...\n...\n",
+      PIECES_MAGIC "\npiece O yellow fixed\n##\n##\nturn\n##\n##\n",
+      PIECES_MAGIC "\npiece L blue\n#.\n###\n"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    ck_assert_int_eq(pieces_compile(&set, invalid[i]), 0);
+  ck_assert_int_eq(pieces_load(&set, "pieces_missing.txt"), 0);
+}
+END_TEST
+
+Suite *pieces_test_suite(void) {
+  Suite *s = suite_create("pieces_test");
+  TCase *tc_pieces_test = tcase_create("pieces_test");
+  tcase_add_test(tc_pieces_test, pieces_test);
+  suite_add_tcase(s, tc_pieces_test);
+  return s;
+}
+
+/**
+ * Remove a file or an empty directory met by nftw().
+ */
+static int remove_entry(const char *path, const struct stat *st, int flag,
+                        struct FTW *ftw) {
+  (void)st;
+  (void)flag;
+  (void)ftw;
+  return remove(path);
+}
+
 int main() {
   int n_failed = 0;
   Suite *suite = NULL;
   SRunner *sr = srunner_create(suite);
+  char data[] = "/tmp/tetris_test_XXXXXX";
+  int temp = mkdtemp(data) != NULL;
+  if (temp) setenv("TETRIS_DATA_DIR", data, 1);
 
   Suite *suites[] = {test_suite(),
                      stats_test_suite(),
@@ -259,6 +1894,26 @@ int main() {
                      moving_figure_test_suite(),
                      rotate_figure_test_suite(),
                      fsm_test_suite(),
+                     gravity_test_suite(),
+                     session_test_suite(),
+                     versus_test_suite(),
+                     replay_test_suite(),
+                     leaderboard_test_suite(),
+                     movegen_test_suite(),
+                     input_test_suite(),
+                     server_test_suite(),
+                     dataset_test_suite(),
+                     metrics_test_suite(),
+                     solver_test_suite(),
+                     highscore_test_suite(),
+                     rewind_test_suite(),
+                     batch_test_suite(),
+                     wheel_test_suite(),
+                     score_test_suite(),
+                     board_test_suite(),
+                     finesse_test_suite(),
+                     rollout_test_suite(),
+                     pieces_test_suite(),
                      NULL};
 
   for (Suite **st = suites; *st != NULL; st++) srunner_add_suite(sr, *st);
@@ -267,6 +1922,7 @@ int main() {
   srunner_run_all(sr, CK_NORMAL);
   n_failed = srunner_ntests_failed(sr);
   srunner_free(sr);
+  if (temp) nftw(data, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
   (void)n_failed;
   return 0;
 }
@@ -5,6 +5,9 @@
 #include <ncurses.h>
 #include <stdio.h>
 
+#include "../brick_game/tetris/backend/tetris_input.h"
+#include "../brick_game/tetris/backend/tetris_movegen.h"
+#include "../brick_game/tetris/backend/tetris_session.h"
 #include "../brick_game/tetris/tetris.h"
 
 Suite *test_suite();